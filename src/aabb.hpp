@@ -0,0 +1,85 @@
+#ifndef AABB_HPP
+#define AABB_HPP
+
+#include "rtweekend.hpp"
+
+#include <utility>
+
+// axis-aligned bounding box, stored as one interval per axis
+class AABB {
+public:
+  Interval x, y, z;
+
+  AABB() {} // empty, since intervals default to empty
+
+  AABB(const Interval &x, const Interval &y, const Interval &z)
+      : x{x}, y{y}, z{z} {}
+
+  // treat a and b as opposite corners of the box (in any order)
+  AABB(const Point3 &a, const Point3 &b) {
+    x = (a[0] <= b[0]) ? Interval(a[0], b[0]) : Interval(b[0], a[0]);
+    y = (a[1] <= b[1]) ? Interval(a[1], b[1]) : Interval(b[1], a[1]);
+    z = (a[2] <= b[2]) ? Interval(a[2], b[2]) : Interval(b[2], a[2]);
+  }
+
+  // tightest box enclosing both boxes
+  AABB(const AABB &box0, const AABB &box1)
+      : x{box0.x, box1.x}, y{box0.y, box1.y}, z{box0.z, box1.z} {}
+
+  const Interval &axisInterval(int n) const {
+    if (n == 1) return y;
+    if (n == 2) return z;
+    return x;
+  }
+
+  Point3 centroid() const {
+    return Point3(0.5 * (x.min + x.max), 0.5 * (y.min + y.max),
+                  0.5 * (z.min + z.max));
+  }
+
+  int longestAxis() const {
+    if (x.size() > y.size())
+      return x.size() > z.size() ? 0 : 2;
+    return y.size() > z.size() ? 1 : 2;
+  }
+
+  // an empty box has zero area, which keeps it from skewing SAH costs
+  double surfaceArea() const {
+    if (x.size() < 0 || y.size() < 0 || z.size() < 0)
+      return 0;
+    return 2 * (x.size() * y.size() + y.size() * z.size() +
+                z.size() * x.size());
+  }
+
+  // slab test: the ray hits the box if the t-intervals where it is inside each
+  // pair of axis planes all overlap
+  bool hit(const Ray &r, Interval rayT) const {
+    const Point3 &rayOrig = r.origin();
+    const Vec3 &rayDir = r.direction();
+
+    for (int axis = 0; axis < 3; ++axis) {
+      const Interval &ax = axisInterval(axis);
+      const Real adinv = Real(1.0) / rayDir[axis];
+
+      auto t0 = (ax.min - rayOrig[axis]) * adinv;
+      auto t1 = (ax.max - rayOrig[axis]) * adinv;
+
+      if (t0 > t1) std::swap(t0, t1);
+      if (t0 > rayT.min) rayT.min = t0;
+      if (t1 < rayT.max) rayT.max = t1;
+
+      if (rayT.max <= rayT.min)
+        return false;
+    }
+    return true;
+  }
+
+  static const AABB empty, universe;
+};
+
+const AABB AABB::empty =
+    AABB(Interval::empty, Interval::empty, Interval::empty);
+const AABB AABB::universe =
+    AABB(Interval::universe, Interval::universe, Interval::universe);
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef ANIMATION_HPP
+#define ANIMATION_HPP
+
+#include "rtweekend.hpp"
+
+#include "camera.hpp"
+#include "scene.hpp"
+#include "sceneFile.hpp"
+#include "transform.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// a sequence of frames rendered in one process from the keys in a scene
+// file: the camera keys set lookfrom, lookat and vfov for each frame, and
+// instances with motion keys move. the scene is built once, and between
+// frames only the moving instances are placed again and the BVHs refitted,
+// so a frame costs a pass over the nodes instead of a rebuild. with a
+// shutter each instance sweeps from where it is at frame f to where it is at
+// f + shutter, and every camera ray picks a time in between (motion blur).
+// the camera holds still while the shutter is open
+
+// Catmull-Rom spline through p1 (u = 0) and p2 (u = 1), with p0 and p3
+// setting the tangents, so a path through several keys has no kinks at them
+inline Vec3 catmullRom(const Vec3 &p0, const Vec3 &p1, const Vec3 &p2,
+                       const Vec3 &p3, double u) {
+  Real t = Real(u), t2 = t * t, t3 = t2 * t;
+  return Real(0.5) * (Real(2) * p1 + (p2 - p0) * t +
+                      (Real(2) * p0 - Real(5) * p1 + Real(4) * p2 - p3) * t2 +
+                      (Real(3) * (p1 - p2) + p3 - p0) * t3);
+}
+
+// the keys either side of frame in keys[0, count), sorted by frame: frame
+// lies u of the way from keys[i] to keys[i + 1]. outside the keys the
+// nearest one holds
+template <typename Key>
+void bracketKeys(const Key *keys, size_t count, double frame, size_t &i,
+                 double &u) {
+  i = 0;
+  while (i + 1 < count && keys[i + 1].frame <= frame)
+    ++i;
+  u = 0;
+  if (i + 1 < count && frame > keys[i].frame)
+    u = (frame - keys[i].frame) / (keys[i + 1].frame - keys[i].frame);
+}
+
+// the spline through the point that get() picks out of every key
+template <typename Key, typename Get>
+Vec3 splineAt(const Key *keys, size_t count, size_t i, double u, Get get) {
+  size_t last = count - 1;
+  return catmullRom(get(keys[i > 0 ? i - 1 : 0]), get(keys[i]),
+                    get(keys[std::min(i + 1, last)]),
+                    get(keys[std::min(i + 2, last)]), u);
+}
+
+inline Vec3 keyVec3(const float *v) { return Vec3(v[0], v[1], v[2]); }
+
+// sets the camera for frame from the file's camera keys, if it has any
+inline void cameraAt(const SceneFile &file, double frame, Camera &cam) {
+  const SceneCameraKeyRecord *keys = file.cameraKeys.data();
+  size_t count = file.cameraKeys.size();
+  if (count == 0)
+    return;
+  size_t i;
+  double u;
+  bracketKeys(keys, count, frame, i, u);
+  cam.lookfrom = splineAt(keys, count, i, u,
+                          [](const SceneCameraKeyRecord &k) {
+                            return keyVec3(k.lookfrom);
+                          });
+  cam.lookat = splineAt(keys, count, i, u, [](const SceneCameraKeyRecord &k) {
+    return keyVec3(k.lookat);
+  });
+  size_t next = std::min(i + 1, count - 1);
+  cam.VFOV = keys[i].vfov + u * (keys[next].vfov - keys[i].vfov);
+}
+
+// where an instance with transform base is at frame, from its run of motion
+// keys. the keys' rotation and scale act on the object before base, so it
+// spins and grows about its own origin, and their translation moves it in
+// world space after. the translation follows a spline; the rotation blends
+// axis and angle separately, which keeps spins of more than half a turn
+// between two keys
+inline Affine motionAt(const SceneMotionKeyRecord *keys, size_t count,
+                       double frame, const Affine &base) {
+  size_t i;
+  double u;
+  bracketKeys(keys, count, frame, i, u);
+  const SceneMotionKeyRecord &a = keys[i];
+  const SceneMotionKeyRecord &b = keys[std::min(i + 1, count - 1)];
+
+  Vec3 translate = splineAt(keys, count, i, u,
+                            [](const SceneMotionKeyRecord &k) {
+                              return keyVec3(k.translate);
+                            });
+  Vec3 axis = keyVec3(a.axis) + Real(u) * (keyVec3(b.axis) - keyVec3(a.axis));
+  if (axis.lengthSquared() == 0) // opposite axes, halfway
+    axis = keyVec3(a.axis);
+  double degrees = a.degrees + u * (b.degrees - a.degrees);
+  double scale = a.scale + u * (b.scale - a.scale);
+  return Affine::translate(translate) * base * Affine::rotate(axis, degrees) *
+         Affine::scale(Vec3(scale, scale, scale));
+}
+
+// puts every instance with motion keys where it is at frame (sweeping on to
+// frame + shutter). scene.refit() brings the BVHs up to date afterwards
+inline void placeInstances(const SceneFile &file, Scene &scene, double frame,
+                           double shutter) {
+  const auto &keys = file.motionKeys;
+  for (size_t begin = 0, end; begin < keys.size(); begin = end) {
+    uint32_t instance = keys[begin].instance;
+    for (end = begin; end < keys.size() && keys[end].instance == instance;)
+      ++end;
+    Affine base = SceneFile::transform(file.instances()[instance]);
+    Affine open = motionAt(&keys[begin], end - begin, frame, base);
+    Affine close =
+        shutter > 0 ? motionAt(&keys[begin], end - begin, frame + shutter, base)
+                    : open;
+    scene.placeInstance(instance, open, close);
+  }
+}
+
+// pattern with its run of '#' replaced by the zero-padded frame number, so
+// frame####.ppm gives frame0007.ppm. without a '#' the number goes before
+// the extension
+inline std::string framePath(const std::string &pattern, int frame) {
+  size_t first = pattern.find('#');
+  size_t width = 4;
+  std::string path = pattern;
+  if (first == std::string::npos) {
+    size_t dot = pattern.rfind('.');
+    first = (dot == std::string::npos || dot == 0) ? pattern.size() : dot;
+    path.insert(first, width, '#');
+  } else {
+    width = pattern.find_first_not_of('#', first);
+    width = (width == std::string::npos ? pattern.size() : width) - first;
+  }
+  char number[32];
+  std::snprintf(number, sizeof(number), "%0*d", int(width), frame);
+  return path.replace(first, width, number);
+}
+
+// renders frames [0, frames) of the file's animation to framePath(pattern,
+// frame). scene must have been built from file. the first frame rebuilds
+// the instance BVH for where the instances start, later ones refit it
+inline void renderSequence(const SceneFile &file, Scene &scene, Camera &cam,
+                           int frames, const std::string &pattern) {
+  for (int frame = 0; frame < frames; ++frame) {
+    auto start = std::chrono::steady_clock::now();
+    bool rebuilt = false;
+    if (!file.motionKeys.empty()) {
+      placeInstances(file, scene, frame, cam.SHUTTER);
+      rebuilt = scene.refit(frame == 0);
+    }
+    double updateSeconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+
+    cameraAt(file, frame, cam);
+    cam.OUTPUT_PATH = framePath(pattern, frame);
+    cam.render(scene.world);
+
+    if (!cam.LOG_PROGRESS)
+      continue;
+    std::clog << "\rFrame " << frame + 1 << '/' << frames << " -> "
+              << cam.OUTPUT_PATH << ": render " << cam.lastStats().renderSeconds
+              << " s";
+    if (!file.motionKeys.empty())
+      std::clog << ", BVH " << (rebuilt ? "rebuilt" : "refit") << " in "
+                << updateSeconds * 1e3 << " ms";
+    std::clog << '\n';
+  }
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// bump allocator for objects that live as long as the scene. objects are
+// packed into large blocks, never freed one at a time, and destroyed (in
+// reverse order) when the arena goes away. handing out raw pointers into the
+// arena means nothing on the render path has to touch a reference count
+class Arena {
+public:
+  explicit Arena(size_t blockSize = 64 * 1024) : blockSize{blockSize} {}
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena() {
+    for (auto it = destructors.rbegin(); it != destructors.rend(); ++it)
+      it->destroy(it->object);
+  }
+
+  template <typename T, typename... Args> T *make(Args &&...args) {
+    void *memory = allocate(sizeof(T), alignof(T));
+    T *object = new (memory) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value)
+      destructors.push_back(Destructor{object, &destroyObject<T>});
+    return object;
+  }
+
+  // raw, uninitialized storage for count Ts
+  template <typename T> T *allocateArray(size_t count) {
+    return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  size_t bytesAllocated() const { return totalBytes; }
+
+private:
+  struct Destructor {
+    void *object;
+    void (*destroy)(void *);
+  };
+
+  template <typename T> static void destroyObject(void *object) {
+    static_cast<T *>(object)->~T();
+  }
+
+  void *allocate(size_t size, size_t alignment) {
+    size_t offset = (used + alignment - 1) & ~(alignment - 1);
+    if (blocks.empty() || offset + size > currentSize) {
+      // oversized requests get a block of their own
+      currentSize = size + alignment > blockSize ? size + alignment : blockSize;
+      blocks.emplace_back(new unsigned char[currentSize]);
+      used = 0;
+      // operator new[] memory is aligned for any fundamental type, so offsets
+      // within the block only need rounding relative to its start
+      offset = 0;
+    }
+    used = offset + size;
+    totalBytes += size;
+    return blocks.back().get() + offset;
+  }
+
+  size_t blockSize;
+  size_t currentSize = 0;
+  size_t used = 0;
+  size_t totalBytes = 0;
+  std::vector<std::unique_ptr<unsigned char[]>> blocks;
+  std::vector<Destructor> destructors;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef BENCH_COMMON_HPP
+#define BENCH_COMMON_HPP
+
+#include "rtweekend.hpp"
+
+#include "camera.hpp"
+#include "hittableList.hpp"
+#include "material.hpp"
+#include "materialTable.hpp"
+#include "scene.hpp"
+#include "sceneFile.hpp"
+#include "sphere.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class Stopwatch {
+public:
+  Stopwatch() : start{std::chrono::steady_clock::now()} {}
+
+  double seconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point start;
+};
+
+// n small spheres scattered through a cube that grows with n, so the density
+// (and therefore the expected distance to the first hit) stays the same at
+// every scene size
+inline HittableList sphereCloud(size_t n, const Material *mat) {
+  HittableList cloud;
+  double halfSide = std::cbrt(double(n));
+  for (size_t i = 0; i < n; ++i) {
+    auto centre = Vec3::random(-halfSide, halfSide);
+    cloud.add(make_shared<Sphere>(centre, 0.25, mat));
+  }
+  return cloud;
+}
+
+// a ray starting somewhere inside box, heading in a uniformly random direction
+inline Ray randomRayIn(const AABB &box) {
+  Point3 origin(randomDouble(box.x.min, box.x.max),
+                randomDouble(box.y.min, box.y.max),
+                randomDouble(box.z.min, box.z.max));
+  return Ray(origin, randomUnitVector());
+}
+
+// the pixel bytes of a binary PPM as written by the camera, or nothing
+inline std::vector<unsigned char> readPpmBytes(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  std::string magic;
+  int width = 0, height = 0, maxValue = 0;
+  in >> magic >> width >> height >> maxValue;
+  in.get();
+  std::vector<unsigned char> bytes(size_t(width) * height * 3);
+  if (magic != "P6" || !in.read((char *)bytes.data(), bytes.size()))
+    bytes.clear();
+  return bytes;
+}
+
+// added to the scene's seed for a reference image. a reference on the same
+// seed would start with the very samples of the render it's compared with,
+// and hide some of that render's error
+const unsigned long long REFERENCE_SEED_OFFSET = 1;
+
+// renders scene 160 px wide with the scene file's camera, changed by
+// configure(cam), to a binary PPM at path and returns its pixel bytes.
+// stats, if given, gets the render's
+template <typename Configure>
+std::vector<unsigned char> renderImage(const Scene &scene,
+                                       const SceneFile &file,
+                                       const std::string &path,
+                                       Configure configure,
+                                       RenderStats *stats = nullptr) {
+  Camera cam;
+  file.applyCamera(cam);
+  cam.IMAGE_WIDTH = 160;
+  cam.IMAGE_FORMAT = ImageFormat::PpmBinary;
+  cam.OUTPUT_PATH = path;
+  cam.LOG_PROGRESS = false;
+  configure(cam);
+  cam.render(scene.world);
+  if (stats)
+    *stats = cam.lastStats();
+  return readPpmBytes(path);
+}
+
+// root mean square difference of two 8-bit images, in 8-bit steps
+inline double rmse(const std::vector<unsigned char> &a,
+                   const std::vector<unsigned char> &b) {
+  if (a.empty() || a.size() != b.size())
+    return -1;
+  double sum = 0;
+  for (size_t i = 0; i < a.size(); ++i)
+    sum += (double(a[i]) - b[i]) * (double(a[i]) - b[i]);
+  return std::sqrt(sum / a.size());
+}
+
+// the average of every channel of a binary PPM, 0 to 255
+inline double meanPixel(const std::string &path) {
+  auto bytes = readPpmBytes(path);
+  double sum = 0;
+  for (unsigned char b : bytes)
+    sum += b;
+  return bytes.empty() ? 0 : sum / bytes.size();
+}
+
+#endif
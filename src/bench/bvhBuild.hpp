@@ -0,0 +1,83 @@
+#ifndef BVH_BUILD_HPP
+#define BVH_BUILD_HPP
+
+#include "benchCommon.hpp"
+
+#include "linearBvh.hpp"
+#include "parallel.hpp"
+#include "sphere.hpp"
+#include "sphereSet.hpp"
+
+#include <cstdio>
+#include <vector>
+
+// build time of the acceleration structures over big sphere clouds on one
+// thread and on more: a LinearBvh with one Sphere per primitive, and a
+// SphereSet (grouping into packets, then the BVH over them). "s/M" is
+// seconds per million spheres, the number to watch for time to first pixel.
+// the trees have to come out the same on any number of threads, which
+// "same" checks by node count and SAH cost against the one-thread build
+inline void benchBvhBuild() {
+  MaterialTable materials;
+  auto mat = materials.add<Lambertian>(Colour(0.5, 0.5, 0.5));
+
+  std::vector<int> threadCounts = {1, 2, 4};
+  if (resolveThreadCount(0) > 4)
+    threadCounts.push_back(resolveThreadCount(0));
+
+  std::printf("%d hardware threads\n", resolveThreadCount(0));
+  std::printf("%-10s %10s %8s %9s %9s %9s %6s\n", "structure", "spheres",
+              "threads", "build s", "s/M", "speedup", "same");
+  for (size_t n = 100000; n <= 1000000; n *= 10) {
+    double halfSide = std::cbrt(double(n));
+    seedRandom(0, n);
+    std::vector<Sphere> spheres;
+    spheres.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+      spheres.emplace_back(Vec3::random(-halfSide, halfSide), 0.25, mat);
+    std::vector<const Sphere *> pointers(n);
+    for (size_t i = 0; i < n; ++i)
+      pointers[i] = &spheres[i];
+
+    auto report = [&](const char *name, int threads, double seconds,
+                      double oneThread, bool same) {
+      std::printf("%-10s %10zu %8d %9.3f %9.3f %8.2fx %6s\n", name, n,
+                  threads, seconds, seconds * 1e6 / double(n),
+                  oneThread / seconds, same ? "yes" : "no");
+    };
+
+    double oneThread = 0;
+    size_t nodes = 0;
+    double cost = 0;
+    for (int threads : threadCounts) {
+      Stopwatch timer;
+      LinearBvhT<Sphere> bvh(pointers, 4, threads);
+      double seconds = timer.seconds();
+      if (threads == 1) {
+        oneThread = seconds;
+        nodes = bvh.nodeCount();
+        cost = bvh.sahCost();
+      }
+      report("bvh", threads, seconds, oneThread,
+             bvh.nodeCount() == nodes && bvh.sahCost() == cost);
+    }
+
+    for (int threads : threadCounts) {
+      SphereSet set;
+      for (const auto &s : spheres)
+        set.add(s.boundingBox().centroid(), 0.25, mat);
+      Stopwatch timer;
+      set.build(threads);
+      double seconds = timer.seconds();
+      if (threads == 1) {
+        oneThread = seconds;
+        nodes = set.nodeCount();
+        cost = set.sahCost();
+      }
+      report("sphere set", threads, seconds, oneThread,
+             set.nodeCount() == nodes && set.sahCost() == cost);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef BVH_SCALING_HPP
+#define BVH_SCALING_HPP
+
+#include "benchCommon.hpp"
+
+#include "bvh.hpp"
+#include "linearBvh.hpp"
+
+#include <cstdio>
+#include <vector>
+
+// traces the same rays through a flat HittableList, a pointer-based BvhNode and
+// a flattened LinearBvh, for scenes from 10 to 1M spheres. the linear scan gets
+// fewer rays at large sizes so it finishes in reasonable time; throughput is
+// what's compared. speedups are relative to the list
+inline void benchBvhScaling() {
+  std::printf("%10s %10s %10s %12s %12s %12s %9s %9s %9s\n", "spheres",
+              "build ms", "flat ms", "list Kray/s", "bvh Kray/s",
+              "flat Kray/s", "bvh x", "flat x", "mismatch");
+
+  MaterialTable materials;
+  auto mat = materials.add<Lambertian>(Colour(0.5, 0.5, 0.5));
+
+  for (size_t n = 10; n <= 1000000; n *= 10) {
+    seedRandom(0, n);
+    HittableList list = sphereCloud(n, mat);
+
+    Stopwatch buildTimer;
+    BvhNode bvh(list);
+    double buildMs = 1000 * buildTimer.seconds();
+
+    Stopwatch flatBuildTimer;
+    LinearBvh flat(list);
+    double flatBuildMs = 1000 * flatBuildTimer.seconds();
+
+    const size_t bvhRays = 200000;
+    const size_t listRays = std::min(bvhRays, size_t(200000000 / n));
+
+    std::vector<Ray> rays(bvhRays);
+    for (auto &r : rays)
+      r = randomRayIn(list.boundingBox());
+
+    HitRecord rec;
+    std::vector<double> listT(listRays);
+    Stopwatch listTimer;
+    for (size_t i = 0; i < listRays; ++i)
+      listT[i] = list.hit(rays[i], Interval(0.001, infinity), rec) ? rec.t : -1;
+    double listRate = listRays / listTimer.seconds();
+
+    size_t mismatches = 0;
+    Stopwatch bvhTimer;
+    for (size_t i = 0; i < bvhRays; ++i) {
+      double t = bvh.hit(rays[i], Interval(0.001, infinity), rec) ? rec.t : -1;
+      if (i < listRays && t != listT[i])
+        ++mismatches;
+    }
+    double bvhRate = bvhRays / bvhTimer.seconds();
+
+    Stopwatch flatTimer;
+    for (size_t i = 0; i < bvhRays; ++i) {
+      double t = flat.hit(rays[i], Interval(0.001, infinity), rec) ? rec.t : -1;
+      if (i < listRays && t != listT[i])
+        ++mismatches;
+    }
+    double flatRate = bvhRays / flatTimer.seconds();
+
+    std::printf("%10zu %10.2f %10.2f %12.1f %12.1f %12.1f %8.1fx %8.1fx %9zu\n",
+                n, buildMs, flatBuildMs, listRate / 1e3, bvhRate / 1e3,
+                flatRate / 1e3, bvhRate / listRate, flatRate / listRate,
+                mismatches);
+  }
+}
+
+#endif
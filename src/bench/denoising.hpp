@@ -0,0 +1,59 @@
+#ifndef DENOISING_HPP
+#define DENOISING_HPP
+
+#include "benchCommon.hpp"
+
+#include "builtinScenes.hpp"
+#include "denoise.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// error against a high sample count reference with and without the denoiser
+// at a few sample counts, on the cover scene (whose glass and metal spheres
+// are the hard case for a filter guided by albedo and normals). a denoised
+// row matching a raw row further down is the samples the denoiser saves
+inline void benchDenoise() {
+  const std::string outputPath = "benchDenoise.ppm";
+  const int referenceSamples = 256;
+
+  SceneFile file;
+  seedRandom(0, 0);
+  int count;
+  builtinScenes(count)[0].generate(file);
+  Scene scene;
+  scene.build(file);
+
+  // the raw and denoised renders at one sample count
+  auto render = [&](int samples, bool denoise, RenderStats *stats) {
+    return renderImage(
+        scene, file, outputPath,
+        [&](Camera &cam) {
+          cam.SAMPLES_PER_PIXEL = samples;
+          cam.MAX_DEPTH = 50;
+          cam.DENOISE = denoise;
+        },
+        stats);
+  };
+
+  auto reference = renderImage(scene, file, outputPath, [&](Camera &cam) {
+    cam.SAMPLES_PER_PIXEL = referenceSamples;
+    cam.MAX_DEPTH = 50;
+    cam.SEED += REFERENCE_SEED_OFFSET;
+  });
+  std::printf("kernel %s, reference %d spp\n", denoise::kernelName(),
+              referenceSamples);
+  std::printf("%6s %10s %14s %12s %12s\n", "spp", "raw rmse", "denoised rmse",
+              "render s", "denoise ms");
+  for (int samples = 4; samples <= 64; samples *= 2) {
+    RenderStats stats;
+    double raw = rmse(render(samples, false, nullptr), reference);
+    double denoised = rmse(render(samples, true, &stats), reference);
+    std::printf("%6d %10.2f %14.2f %12.3f %12.2f\n", samples, raw, denoised,
+                stats.renderSeconds, stats.denoiseSeconds * 1e3);
+  }
+  std::remove(outputPath.c_str());
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef DISPATCH_HPP
+#define DISPATCH_HPP
+
+#include "benchCommon.hpp"
+
+#include "linearBvh.hpp"
+#include "material.hpp"
+#include "materialTable.hpp"
+#include "sphere.hpp"
+#include "sphereSet.hpp"
+
+#include <cstdio>
+#include <vector>
+
+// the built-in materials and primitives called through their virtual
+// functions vs directly (DEVIRTUALIZE): BVH throughput with Spheres and with
+// SphereSet packets in the leaves, then the cost of one Material::scatter
+// over records that all share a material and over records that mix the four.
+// for the whole renderer, build inOneWeekend with and without
+// -DRT_VIRTUAL_DISPATCH=ON and time the same scene
+inline void benchDispatch() {
+  MaterialTable materials;
+  auto grey = materials.add<Lambertian>(Colour(0.5, 0.5, 0.5));
+
+  const size_t sphereCount = 100000;
+  const size_t rayCount = 200000;
+  double halfSide = std::cbrt(double(sphereCount));
+  seedRandom(0, 0);
+  std::vector<Sphere> spheres;
+  spheres.reserve(sphereCount);
+  for (size_t i = 0; i < sphereCount; ++i)
+    spheres.emplace_back(Vec3::random(-halfSide, halfSide), 0.25, grey);
+  std::vector<const Hittable *> asHittables;
+  std::vector<const Sphere *> asSpheres;
+  for (const auto &s : spheres) {
+    asHittables.push_back(&s);
+    asSpheres.push_back(&s);
+  }
+  LinearBvh virtualSpheres(asHittables);
+  LinearBvhT<Sphere> directSpheres(asSpheres);
+
+  seedRandom(0, 0);
+  SphereSetT<Real, false> virtualSet;
+  SphereSetT<Real, true> directSet;
+  for (size_t i = 0; i < sphereCount; ++i) {
+    Point3 centre = Vec3::random(-halfSide, halfSide);
+    virtualSet.add(centre, 0.25, grey);
+    directSet.add(centre, 0.25, grey);
+  }
+  virtualSet.build();
+  directSet.build();
+
+  std::vector<Ray> rays(rayCount);
+  for (auto &r : rays)
+    r = randomRayIn(virtualSpheres.boundingBox());
+
+  // Mray/s through bvh, and the sum of the hit distances to check against.
+  // an untimed pass first, so neither side pays for bringing the nodes
+  // into cache
+  auto trace = [&](const Hittable &bvh, double &checksum) {
+    HitRecord rec;
+    for (const auto &r : rays)
+      bvh.hit(r, Interval(0.001, infinity), rec);
+    checksum = 0;
+    Stopwatch timer;
+    for (const auto &r : rays)
+      if (bvh.hit(r, Interval(0.001, infinity), rec))
+        checksum += double(rec.t);
+    return rayCount / timer.seconds() / 1e6;
+  };
+
+  std::printf("%zu spheres, %zu rays\n", sphereCount, rayCount);
+  std::printf("%-10s %14s %14s %9s %6s\n", "leaves", "virtual Mray/s",
+              "direct Mray/s", "speedup", "same");
+  double a, b;
+  double virtualRate = trace(virtualSpheres, a);
+  double directRate = trace(directSpheres, b);
+  std::printf("%-10s %14.2f %14.2f %8.2fx %6s\n", "spheres", virtualRate,
+              directRate, directRate / virtualRate, a == b ? "yes" : "no");
+  virtualRate = trace(virtualSet, a);
+  directRate = trace(directSet, b);
+  std::printf("%-10s %14.2f %14.2f %8.2fx %6s\n", "packets", virtualRate,
+              directRate, directRate / virtualRate, a == b ? "yes" : "no");
+
+  // hit records on random spheres, the materials either all grey or
+  // picked at random from the four built-in kinds
+  const Material *mixed[] = {
+      grey, materials.add<Metal>(Colour(0.7, 0.6, 0.5), 0.1),
+      materials.add<Dielectric>(1.5),
+      materials.add<DiffuseLight>(Colour(4, 4, 4))};
+  const size_t recordCount = 1 << 16;
+  const int rounds = 30;
+  std::vector<HitRecord> records(recordCount);
+  std::vector<Ray> incoming(recordCount);
+  for (size_t i = 0; i < recordCount; ++i) {
+    incoming[i] = Ray(Point3(0, 0, 0), randomUnitVector());
+    records[i].p = incoming[i].at(1);
+    records[i].setFaceNormal(incoming[i], -incoming[i].direction());
+    records[i].t = 1;
+  }
+
+  // ns per scatter(), and the number that scattered to check against
+  auto scatterAll = [&](bool devirt, size_t &scattered) {
+    Colour attenuation;
+    Ray out;
+    scattered = 0;
+    seedRandom(1, 0);
+    Stopwatch timer;
+    for (int round = 0; round < rounds; ++round)
+      for (size_t i = 0; i < recordCount; ++i)
+        scattered +=
+            devirt ? dispatch::scatter<true>(*records[i].mat, incoming[i],
+                                             records[i], attenuation, out)
+                   : dispatch::scatter<false>(*records[i].mat, incoming[i],
+                                              records[i], attenuation, out);
+    return timer.seconds() * 1e9 / (double(rounds) * recordCount);
+  };
+
+  std::printf("%-10s %14s %14s %9s %6s\n", "materials", "virtual ns",
+              "direct ns", "speedup", "same");
+  for (int mix = 0; mix < 2; ++mix) {
+    seedRandom(2, 0);
+    for (auto &rec : records)
+      rec.mat = mix ? mixed[std::min(int(randomDouble() * 4), 3)] : grey;
+    size_t virtualCount, directCount;
+    double virtualNs = scatterAll(false, virtualCount);
+    double directNs = scatterAll(true, directCount);
+    std::printf("%-10s %14.2f %14.2f %8.2fx %6s\n", mix ? "mixed" : "one",
+                virtualNs, directNs, virtualNs / directNs,
+                virtualCount == directCount ? "yes" : "no");
+  }
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef ENVIRONMENT_MAPS_HPP
+#define ENVIRONMENT_MAPS_HPP
+
+#include "benchCommon.hpp"
+
+#include "builtinScenes.hpp"
+#include "environment.hpp"
+#include "image.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+// a latitude-longitude sky the way a photographed one is hard to sample: a
+// soft blue gradient over a grey ground, and a sun a degree across that
+// gives about three times as much light as the rest of the sky
+inline Image sunnySky(int width, int height) {
+  Image sky(width, height);
+  Vec3 sun = unitVector(Vec3(1, 0.7, 0.6));
+  double sunCos = std::cos(degreesToRadians(1.0));
+  for (int m = 0; m < height; ++m) {
+    double theta = pi * (m + 0.5) / height;
+    for (int n = 0; n < width; ++n) {
+      double phi = 2 * pi * (n + 0.5) / width;
+      Vec3 d(std::sin(theta) * std::cos(phi), std::cos(theta),
+             std::sin(theta) * std::sin(phi));
+      Colour c = d.y() > 0 ? (1 - d.y()) * Colour(0.9, 0.9, 1.0) +
+                                 d.y() * Colour(0.3, 0.5, 1.0)
+                           : Colour(0.25, 0.25, 0.25);
+      if (dot(d, sun) > sunCos)
+        c = Colour(3000, 2800, 2400);
+      sky.at(m, n) = c;
+    }
+  }
+  return sky;
+}
+
+// what an HDR environment costs to load (reading the file and building the
+// sampling tables) and keep in memory, in both formats, and the error
+// against a high sample count reference on the cover scene lit by it with
+// no shadow rays towards it, shadow rays in uniform directions, and shadow
+// rays importance sampled from the tables, at the same samples per pixel
+inline void benchEnvironment() {
+  const std::string outputPath = "benchEnvironment.ppm";
+  const std::string hdrPath = "benchEnvironment.hdr";
+  const std::string pfmPath = "benchEnvironment.pfm";
+  const int referenceSamples = 1024;
+
+  Image sky = sunnySky(2048, 1024);
+  writeImage(sky, ImageFormat::Rgbe, hdrPath);
+  writeImage(sky, ImageFormat::Pfm, pfmPath);
+
+  std::printf("%-6s %10s %9s %9s %11s %10s\n", "file", "map", "load ms",
+              "table ms", "texels MB", "tables MB");
+  EnvironmentMap environment;
+  for (const std::string &path : {hdrPath, pfmPath}) {
+    for (int maxWidth : {4096, 1024}) {
+      Stopwatch loadTimer;
+      environment.load(path, maxWidth);
+      double loadSeconds = loadTimer.seconds();
+      Image image;
+      readHdrImage(path, image);
+      Stopwatch tableTimer;
+      environment.build(image, maxWidth);
+      double tableSeconds = tableTimer.seconds();
+      std::printf("%-6s %5dx%-4d %9.1f %9.1f %11.2f %10.2f\n",
+                  path.substr(path.size() - 3).c_str(),
+                  environment.mapWidth(), environment.mapHeight(),
+                  loadSeconds * 1e3, tableSeconds * 1e3,
+                  environment.textureBytes() / 1e6,
+                  environment.tableBytes() / 1e6);
+    }
+  }
+  std::remove(hdrPath.c_str());
+  std::remove(pfmPath.c_str());
+
+  SceneFile file;
+  seedRandom(0, 0);
+  coverScene(file);
+  Scene scene;
+  scene.build(file);
+
+  environment.build(sky);
+  auto reference = renderImage(scene, file, outputPath, [&](Camera &cam) {
+    cam.SAMPLES_PER_PIXEL = referenceSamples;
+    cam.ENVIRONMENT = &environment;
+    cam.ENVIRONMENT_SAMPLING = EnvironmentSampling::Importance;
+    cam.SEED += REFERENCE_SEED_OFFSET;
+  });
+  std::printf("\ncover scene, reference %d spp importance sampled\n",
+              referenceSamples);
+  std::printf("%6s %11s %8s %9s %8s %8s\n", "spp", "sampling", "rmse",
+              "render s", "Mray/s", "mean");
+  const char *names[] = {"off", "uniform", "importance"};
+  for (int samples = 4; samples <= 64; samples *= 4) {
+    for (int how = 0; how < 3; ++how) {
+      RenderStats s;
+      auto image = renderImage(
+          scene, file, outputPath,
+          [&](Camera &cam) {
+            cam.SAMPLES_PER_PIXEL = samples;
+            cam.ENVIRONMENT = &environment;
+            cam.ENVIRONMENT_SAMPLING = EnvironmentSampling(how);
+          },
+          &s);
+      double error = rmse(image, reference);
+      std::printf("%6d %11s %8.2f %9.3f %8.2f %8.2f\n", samples, names[how],
+                  error, s.renderSeconds, s.rays() / s.renderSeconds / 1e6,
+                  meanPixel(outputPath));
+    }
+  }
+  std::remove(outputPath.c_str());
+}
+
+#endif
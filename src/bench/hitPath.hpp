@@ -0,0 +1,82 @@
+#ifndef HIT_PATH_HPP
+#define HIT_PATH_HPP
+
+#include "benchCommon.hpp"
+
+#include "linearBvh.hpp"
+#include "parallel.hpp"
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// what the hit path used to do to the material pointer on every hit: the
+// sphere assigned its shared_ptr into the record, then HittableList copied the
+// whole record again. two atomic increments and two decrements, all on the
+// one control block every thread shares
+struct RefCountedHitRecord {
+  Point3 p;
+  Vec3 normal;
+  shared_ptr<Material> mat;
+  double t;
+  bool frontFace;
+};
+
+// hit throughput through a LinearBvh whose every sphere shares one material
+// (the worst case for shared counts), next to the cost the old shared_ptr
+// copies would add per hit on the same number of threads
+inline void benchHitPath() {
+  MaterialTable materials;
+  auto mat = materials.add<Lambertian>(Colour(0.5, 0.5, 0.5));
+  // a stand-in for the old owning pointer, with the same shared control block
+  shared_ptr<Material> sharedMat =
+      make_shared<Lambertian>(Colour(0.5, 0.5, 0.5));
+
+  seedRandom(0, 0);
+  HittableList list = sphereCloud(100000, mat);
+  LinearBvh bvh(list);
+
+  const size_t raysPerThread = 300000;
+  std::vector<Ray> rays(raysPerThread);
+  for (auto &r : rays)
+    r = randomRayIn(list.boundingBox());
+
+  std::printf("%8s %14s %14s %18s\n", "threads", "hits/thread", "Mray/s",
+              "refcount ns/hit");
+
+  std::vector<int> threadCounts = {1};
+  if (resolveThreadCount(0) > 1)
+    threadCounts.push_back(resolveThreadCount(0));
+
+  for (int threads : threadCounts) {
+    std::vector<size_t> hitCounts(threads);
+
+    Stopwatch traceTimer;
+    parallelFor(threads, threads, [&](int task, int) {
+      HitRecord rec;
+      size_t hits = 0;
+      for (const auto &r : rays)
+        hits += bvh.hit(r, Interval(0.001, infinity), rec);
+      hitCounts[task] = hits;
+    });
+    double traceSeconds = traceTimer.seconds();
+
+    // replay the same number of hits as pure shared_ptr traffic
+    Stopwatch refTimer;
+    parallelFor(threads, threads, [&](int task, int) {
+      RefCountedHitRecord tmpRec, rec;
+      for (size_t i = 0; i < hitCounts[task]; ++i) {
+        tmpRec.mat = sharedMat; // rec.mat = mat in Sphere::hit
+        tmpRec.t = double(i);
+        rec = tmpRec;           // rec = tmpRec in HittableList::hit
+      }
+    });
+    double refSeconds = refTimer.seconds();
+
+    std::printf("%8d %14zu %14.3f %18.2f\n", threads, hitCounts[0],
+                threads * raysPerThread / traceSeconds / 1e6,
+                1e9 * refSeconds / double(hitCounts[0]));
+  }
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef INSTANCING_HPP
+#define INSTANCING_HPP
+
+#include "benchCommon.hpp"
+
+#include "scene.hpp"
+#include "sceneFile.hpp"
+
+#include <cstdio>
+
+// a 64-sphere object on a square grid of n instances with random turns,
+// either instanced or flattened into one SphereSet. the grid spacing is the
+// same at every n, so rays see about the same depth complexity throughout
+inline void instancingScene(SceneFile &file, size_t n, bool flatten) {
+  auto mat = file.addMaterial(SceneMaterialKind::Lambertian, 0.5, 0.5, 0.5);
+  std::vector<Point3> centres;
+  seedRandom(0, 5);
+  for (int i = 0; i < 64; ++i)
+    centres.push_back(Vec3::random(-1, 1));
+
+  uint32_t object = 0;
+  if (!flatten) {
+    object = file.beginObject();
+    for (const auto &c : centres)
+      file.addSphere(c, 0.15, mat);
+    file.endObject();
+  }
+
+  size_t side = size_t(std::ceil(std::sqrt(double(n))));
+  for (size_t i = 0; i < n; ++i) {
+    auto toWorld = Affine::translate(Vec3(3.0 * (i % side), 0,
+                                          3.0 * (i / side))) *
+                   Affine::rotate(randomUnitVector(), randomDouble(0, 360));
+    if (flatten) {
+      for (const auto &c : centres)
+        file.addSphere(toWorld.point(c), 0.15, mat);
+    } else {
+      file.addInstance(object, toWorld);
+    }
+  }
+}
+
+// rays per second through the scene, cast from above the grid down at random
+// points on it
+inline double traceRate(const Scene &scene, size_t rayCount) {
+  AABB box = scene.world.boundingBox();
+  seedRandom(0, 6);
+  HitRecord rec;
+  size_t hits = 0;
+  Stopwatch rayTimer;
+  for (size_t i = 0; i < rayCount; ++i) {
+    Point3 target(randomDouble(box.x.min, box.x.max), 0,
+                  randomDouble(box.z.min, box.z.max));
+    Point3 origin = target + Vec3(randomDouble(-5, 5), 10, randomDouble(-5, 5));
+    hits += scene.world.hit(Ray(origin, target - origin),
+                            Interval(0.001, infinity), rec);
+  }
+  double rate = rayCount / rayTimer.seconds();
+  if (hits == 0)
+    std::printf("(no hits)\n");
+  return rate;
+}
+
+// build time, memory and ray throughput of instanced scenes against the
+// same geometry flattened into individual spheres (up to where flattening
+// still fits comfortably)
+inline void benchInstancing() {
+  std::printf("%10s %11s %6s %10s %10s %12s\n", "instances", "spheres",
+              "mode", "build s", "MB", "Kray/s");
+  for (size_t n = 1000; n <= 1024000; n *= 4) {
+    for (int flatten = 0; flatten < 2; ++flatten) {
+      if (flatten && n > 64000)
+        continue;
+      SceneFile file;
+      instancingScene(file, n, flatten != 0);
+
+      Stopwatch buildTimer;
+      Scene scene;
+      scene.build(file);
+      double buildSeconds = buildTimer.seconds();
+
+      double rate = traceRate(scene, 200000);
+
+      std::printf("%10zu %11zu %6s %10.3f %10.1f %12.1f\n", n, n * 64,
+                  flatten ? "flat" : "inst", buildSeconds,
+                  scene.memoryBytes() / 1e6, rate / 1e3);
+    }
+  }
+}
+
+#endif
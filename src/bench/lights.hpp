@@ -0,0 +1,55 @@
+#ifndef LIGHTS_HPP
+#define LIGHTS_HPP
+
+#include "benchCommon.hpp"
+
+#include "builtinScenes.hpp"
+
+#include <cstdio>
+#include <string>
+
+// error against a high sample count reference on the lit scene, with the
+// lights found only by chance and with next-event estimation (Camera::LIGHTS),
+// at the same samples per pixel. the shadow rays make each sample dearer, so
+// rays/s and render time are there to compare at equal cost as well. the mean
+// pixel value should agree between the two: both converge to the same image
+inline void benchLights() {
+  const std::string outputPath = "benchLights.ppm";
+  const int referenceSamples = 1024;
+
+  SceneFile file;
+  litScene(file);
+  Scene scene;
+  scene.build(file);
+
+  auto reference = renderImage(scene, file, outputPath, [&](Camera &cam) {
+    cam.SAMPLES_PER_PIXEL = referenceSamples;
+    cam.LIGHTS = &scene.lights;
+    cam.SEED += REFERENCE_SEED_OFFSET;
+  });
+  std::printf("%zu lights, reference %d spp with next-event estimation\n",
+              scene.lights.size(), referenceSamples);
+  std::printf("%6s %5s %8s %9s %10s %8s %8s\n", "spp", "nee", "rmse",
+              "render s", "shadow/px", "Mray/s", "mean");
+  for (int samples = 4; samples <= 64; samples *= 4) {
+    for (int nee = 0; nee < 2; ++nee) {
+      RenderStats s;
+      auto image = renderImage(
+          scene, file, outputPath,
+          [&](Camera &cam) {
+            cam.SAMPLES_PER_PIXEL = samples;
+            cam.LIGHTS = nee ? &scene.lights : nullptr;
+          },
+          &s);
+      double error = rmse(image, reference);
+      double pixels = double(s.primaryRays ? s.primaryRays : 1) / samples;
+      std::printf("%6d %5s %8.2f %9.3f %10.2f %8.2f %8.2f\n", samples,
+                  nee ? "on" : "off", error, s.renderSeconds,
+                  s.shadowRays / pixels, s.rays() / s.renderSeconds / 1e6,
+                  meanPixel(outputPath));
+    }
+  }
+  std::remove(outputPath.c_str());
+}
+
+#endif
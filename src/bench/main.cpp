@@ -0,0 +1,141 @@
+#include "rtweekend.hpp"
+
+#include "bvhBuild.hpp"
+#include "bvhScaling.hpp"
+#include "denoising.hpp"
+#include "dispatch.hpp"
+#include "environmentMaps.hpp"
+#include "hitPath.hpp"
+#include "instancing.hpp"
+#include "lights.hpp"
+#include "packets.hpp"
+#include "precision.hpp"
+#include "refit.hpp"
+#include "renderScenes.hpp"
+#include "roulette.hpp"
+#include "sceneLoad.hpp"
+#include "sphereKernels.hpp"
+
+#include <cstring>
+
+// usage: bench [suite] [--csv | --json]
+// runs every suite when no name is given. --csv and --json print the render
+// suite's results in that form instead of a table, and only that suite
+int main(int argc, char **argv) {
+  const char *suite = "all";
+  ReportFormat format = ReportFormat::Table;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--csv") == 0)
+      format = ReportFormat::Csv;
+    else if (std::strcmp(argv[i], "--json") == 0)
+      format = ReportFormat::Json;
+    else
+      suite = argv[i];
+  }
+  if (format != ReportFormat::Table) {
+    if (std::strcmp(suite, "all") != 0 && std::strcmp(suite, "render") != 0) {
+      std::fprintf(stderr, "only the render suite has csv or json output\n");
+      return 1;
+    }
+    benchRenderScenes(format);
+    return 0;
+  }
+
+  bool all = std::strcmp(suite, "all") == 0;
+  bool ran = false;
+
+  if (all || std::strcmp(suite, "bvh") == 0) {
+    std::printf("== bvh: linear list vs BVH over scene size ==\n");
+    benchBvhScaling();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "build") == 0) {
+    std::printf("== build: parallel BVH builds over big scenes ==\n");
+    benchBvhBuild();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "spheres") == 0) {
+    std::printf("== spheres: individual Spheres vs SIMD SphereSet ==\n");
+    benchSphereKernels();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "hitpath") == 0) {
+    std::printf("== hitpath: raw material pointers vs shared_ptr copies ==\n");
+    benchHitPath();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "precision") == 0) {
+    std::printf("== precision: float vs double kernels and image error ==\n");
+    benchPrecision();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "scene") == 0) {
+    std::printf("== scene: scene file loading and building ==\n");
+    benchSceneLoad();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "instances") == 0) {
+    std::printf("== instances: instanced vs flattened geometry ==\n");
+    benchInstancing();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "refit") == 0) {
+    std::printf("== refit: refitting vs rebuilding an animated scene ==\n");
+    benchRefit();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "denoise") == 0) {
+    std::printf("== denoise: image error with and without the denoiser ==\n");
+    benchDenoise();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "roulette") == 0) {
+    std::printf("== roulette: path length and speed, Russian roulette ==\n");
+    benchRoulette();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "lights") == 0) {
+    std::printf("== lights: emitters by chance vs next-event estimation ==\n");
+    benchLights();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "environment") == 0) {
+    std::printf("== environment: HDR map loading and importance sampling ==\n");
+    benchEnvironment();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "packets") == 0) {
+    std::printf("== packets: camera rays one at a time vs in packets ==\n");
+    benchPackets();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "dispatch") == 0) {
+    std::printf("== dispatch: virtual calls vs switching on the kind ==\n");
+    benchDispatch();
+    ran = true;
+  }
+
+  if (all || std::strcmp(suite, "render") == 0) {
+    std::printf("== render: built-in scenes end to end, per-call costs ==\n");
+    benchRenderScenes(format);
+    ran = true;
+  }
+
+  if (!ran) {
+    std::fprintf(stderr, "unknown suite '%s'\n", suite);
+    return 1;
+  }
+}
@@ -0,0 +1,83 @@
+#ifndef PACKETS_HPP
+#define PACKETS_HPP
+
+#include "benchCommon.hpp"
+
+#include "builtinScenes.hpp"
+#include "camera.hpp"
+#include "scene.hpp"
+#include "sceneFile.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// camera rays traced one at a time vs in packets (Camera::PACKET_SIZE) of
+// 4x4 and 8x8 pixels, with both integrators. at depth 1 the render is mostly
+// the camera rays, so that column shows what the packets save on them; at
+// full depth the saving is diluted by the bounces, which go on alone. node
+// visits count each box test, frustum tests included. "same" says whether the
+// image matches the one from single rays byte for byte
+inline void benchPackets() {
+  const std::string outputPath = "benchPackets.ppm";
+  const char *sceneNames[] = {"cover", "grid", "inst"};
+
+  std::printf("640 px wide, 4 spp\n");
+  std::printf("%-6s %-10s %7s %12s %11s %9s %11s %5s\n", "scene",
+              "integrator", "packet", "nodes/ray 1", "depth 1 s", "speedup",
+              "depth 50 s", "same");
+  int count;
+  const BuiltinScene *scenes = builtinScenes(count);
+  for (int i = 0; i < count; ++i) {
+    bool wanted = false;
+    for (const char *name : sceneNames)
+      wanted = wanted || std::strcmp(scenes[i].name, name) == 0;
+    if (!wanted)
+      continue;
+    SceneFile file;
+    seedRandom(0, 0);
+    scenes[i].generate(file);
+    Scene scene;
+    scene.build(file);
+
+    for (int wavefront = 0; wavefront < 2; ++wavefront) {
+      double singleSeconds = 0;
+      std::vector<unsigned char> single;
+      for (int size = 0; size <= 8; size += 4) {
+        auto render = [&](int depth, RenderStats &stats) {
+          Camera cam;
+          file.applyCamera(cam);
+          cam.IMAGE_WIDTH = 640;
+          cam.SAMPLES_PER_PIXEL = 4;
+          cam.MAX_DEPTH = depth;
+          cam.WAVEFRONT = wavefront != 0;
+          cam.PACKET_SIZE = size;
+          cam.LIGHTS = &scene.lights;
+          cam.IMAGE_FORMAT = ImageFormat::PpmBinary;
+          cam.OUTPUT_PATH = outputPath;
+          cam.LOG_PROGRESS = false;
+          cam.render(scene.world);
+          stats = cam.lastStats();
+        };
+        RenderStats shallow, deep;
+        render(1, shallow);
+        render(50, deep);
+        auto image = readPpmBytes(outputPath);
+        if (size == 0) {
+          singleSeconds = shallow.renderSeconds;
+          single = image;
+        }
+        double rays = double(shallow.rays() ? shallow.rays() : 1);
+        std::printf("%-6s %-10s %7d %12.1f %11.3f %9.2f %11.3f %5s\n",
+                    scenes[i].name, wavefront ? "wavefront" : "recursive",
+                    size, shallow.nodeVisits / rays, shallow.renderSeconds,
+                    singleSeconds / shallow.renderSeconds, deep.renderSeconds,
+                    image == single ? "yes" : "no");
+      }
+    }
+  }
+  std::remove(outputPath.c_str());
+}
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef PRECISION_HPP
+#define PRECISION_HPP
+
+#include "benchCommon.hpp"
+
+#include "sphere.hpp"
+#include "sphereSet.hpp"
+
+#include <cstdio>
+#include <vector>
+
+// the final scene's spheres (ground, three big ones, the small-sphere grid),
+// kept in double so each precision can take its own copy
+struct PrecisionSphere {
+  Vec3T<double> centre;
+  double radius;
+};
+
+inline std::vector<PrecisionSphere> precisionScene() {
+  std::vector<PrecisionSphere> spheres;
+  spheres.push_back({Vec3T<double>(0, -1000, 0), 1000});
+  spheres.push_back({Vec3T<double>(0, 1, 0), 1});
+  spheres.push_back({Vec3T<double>(-4, 1, 0), 1});
+  spheres.push_back({Vec3T<double>(4, 1, 0), 1});
+
+  seedRandom(0, 0);
+  for (int a = -11; a < 11; ++a) {
+    for (int b = -11; b < 11; ++b) {
+      Vec3T<double> centre(a + 0.9 * randomDouble(), 0.2,
+                           b + 0.9 * randomDouble());
+      if ((centre - Vec3T<double>(4, 0.2, 0)).length() > 0.9)
+        spheres.push_back({centre, 0.2});
+    }
+  }
+  return spheres;
+}
+
+// brute-force closest hit over the scene in precision T. returns the index of
+// the sphere hit (-1 on a miss) and its outward normal, in double for
+// comparison
+template <typename T>
+inline int closestSphere(const std::vector<Vec3T<T>> &centres,
+                         const std::vector<T> &radii, const RayT<T> &r,
+                         Vec3T<double> &normal) {
+  IntervalT<T> rayT(T(0.001), std::numeric_limits<T>::infinity());
+  int closest = -1;
+  T root;
+  for (size_t i = 0; i < centres.size(); ++i) {
+    if (hitSphere(centres[i], radii[i], r, rayT, root)) {
+      rayT.max = root;
+      closest = int(i);
+    }
+  }
+  if (closest >= 0)
+    normal = Vec3T<double>((r.at(rayT.max) - centres[closest]) /
+                           radii[closest]);
+  return closest;
+}
+
+// normal-shaded primary visibility of the final scene in precision T, as
+// 8-bit values. ray directions are generated in double and rounded to T
+template <typename T>
+inline std::vector<int>
+precisionImage(const std::vector<PrecisionSphere> &scene, int width,
+               int height, std::vector<int> &objectIds, double &seconds) {
+  std::vector<Vec3T<T>> centres;
+  std::vector<T> radii;
+  for (const auto &s : scene) {
+    centres.push_back(Vec3T<T>(s.centre));
+    radii.push_back(T(s.radius));
+  }
+
+  Vec3T<double> lookfrom(13, 2, 3);
+  Vec3T<double> w = unitVector(lookfrom - Vec3T<double>(0, 0, 0));
+  Vec3T<double> u = unitVector(cross(Vec3T<double>(0, 1, 0), w));
+  Vec3T<double> v = cross(w, u);
+  double halfHeight = std::tan(degreesToRadians(20) / 2);
+  double halfWidth = halfHeight * width / height;
+
+  std::vector<int> pixels(size_t(width) * height * 3);
+  objectIds.assign(size_t(width) * height, -1);
+  Stopwatch timer;
+  for (int m = 0; m < height; ++m) {
+    for (int n = 0; n < width; ++n) {
+      double sx = (2 * (n + 0.5) / width - 1) * halfWidth;
+      double sy = (1 - 2 * (m + 0.5) / height) * halfHeight;
+      Vec3T<double> dir = sx * u + sy * v - w;
+      auto r = RayT<T>(Vec3T<T>(lookfrom), Vec3T<T>(dir));
+
+      Vec3T<double> normal;
+      size_t pixel = size_t(m) * width + n;
+      objectIds[pixel] = closestSphere(centres, radii, r, normal);
+      Vec3T<double> shade = objectIds[pixel] < 0
+                                ? Vec3T<double>(1, 1, 1)
+                                : 0.5 * (normal + Vec3T<double>(1, 1, 1));
+      for (int c = 0; c < 3; ++c)
+        pixels[pixel * 3 + c] = int(255.999 * std::min(shade[c], 1.0));
+    }
+  }
+  seconds = timer.seconds();
+  return pixels;
+}
+
+// ray throughput of the sphere kernels in each precision, and how far the
+// float results drift from double: per-ray hit distances against a SIMD
+// SphereSet, and a primary-visibility image of the final scene
+inline void benchPrecision() {
+  MaterialTable materials;
+  auto mat = materials.add<Lambertian>(Colour(0.5, 0.5, 0.5));
+
+  std::printf("kernel: %s, Vec3 %s, Real is %s\n", sphereSetKernelName(),
+#ifdef RT_VEC3_ALIGN4
+              "4-wide aligned",
+#else
+              "3-wide",
+#endif
+              sizeof(Real) == sizeof(float) ? "float" : "double");
+  std::printf("%10s %14s %14s %9s %9s %12s\n", "spheres", "double Kray/s",
+              "float Kray/s", "speedup", "hit diff", "mean rel dt");
+
+  for (size_t n = 1000; n <= 1000000; n *= 10) {
+    SphereSetT<double> setDouble;
+    SphereSetT<float> setFloat;
+    seedRandom(0, n);
+    double halfSide = std::cbrt(double(n));
+    for (size_t i = 0; i < n; ++i) {
+      auto centre = Vec3::random(-halfSide, halfSide);
+      setDouble.add(centre, 0.25, mat);
+      setFloat.add(centre, 0.25, mat);
+    }
+    setDouble.build();
+    setFloat.build();
+
+    const size_t rayCount = 500000;
+    std::vector<Ray> rays(rayCount);
+    for (auto &r : rays)
+      r = randomRayIn(setDouble.boundingBox());
+
+    HitRecord rec;
+    std::vector<double> doubleT(rayCount);
+    Stopwatch doubleTimer;
+    for (size_t i = 0; i < rayCount; ++i)
+      doubleT[i] =
+          setDouble.hit(rays[i], Interval(0.001, infinity), rec) ? rec.t : -1;
+    double doubleRate = rayCount / doubleTimer.seconds();
+
+    std::vector<double> floatT(rayCount);
+    Stopwatch floatTimer;
+    for (size_t i = 0; i < rayCount; ++i)
+      floatT[i] =
+          setFloat.hit(rays[i], Interval(0.001, infinity), rec) ? rec.t : -1;
+    double floatRate = rayCount / floatTimer.seconds();
+
+    // grazing rays can hit a different sphere (or none) in float; count
+    // those separately from the rounding error on agreeing hits
+    size_t hitDiffs = 0, agreeing = 0;
+    double totalRelative = 0;
+    for (size_t i = 0; i < rayCount; ++i) {
+      if (floatT[i] < 0 && doubleT[i] < 0)
+        continue;
+      double relative = fabs(floatT[i] - doubleT[i]) / doubleT[i];
+      if ((floatT[i] < 0) != (doubleT[i] < 0) || relative > 1e-3)
+        ++hitDiffs;
+      else {
+        totalRelative += relative;
+        ++agreeing;
+      }
+    }
+
+    std::printf("%10zu %14.1f %14.1f %8.2fx %9zu %12.2e\n", n,
+                doubleRate / 1e3, floatRate / 1e3, floatRate / doubleRate,
+                hitDiffs, agreeing ? totalRelative / agreeing : 0.0);
+  }
+
+  // the ground is a radius 1000 sphere, so c = |oc|^2 - r^2 cancels two
+  // numbers near 1e6: the worst case for the quadratic in float
+  auto scene = precisionScene();
+  const int width = 400, height = 225;
+  std::vector<int> idsDouble, idsFloat;
+  double doubleSeconds, floatSeconds;
+  auto imageDouble = precisionImage<double>(scene, width, height, idsDouble,
+                                            doubleSeconds);
+  auto imageFloat =
+      precisionImage<float>(scene, width, height, idsFloat, floatSeconds);
+
+  double squaredError = 0;
+  size_t objectDiffs = 0;
+  for (size_t i = 0; i < imageDouble.size(); ++i) {
+    double diff = imageDouble[i] - imageFloat[i];
+    squaredError += diff * diff;
+  }
+  for (size_t i = 0; i < idsDouble.size(); ++i)
+    if (idsDouble[i] != idsFloat[i])
+      ++objectDiffs;
+
+  std::printf("final scene primary visibility, %dx%d, %zu spheres "
+              "(brute force hitSphere)\n",
+              width, height, scene.size());
+  std::printf("  double %.3f s, float %.3f s (%.2fx)\n", doubleSeconds,
+              floatSeconds, doubleSeconds / floatSeconds);
+  std::printf("  float vs double: RMSE %.3f (8-bit), %zu of %zu pixels see a "
+              "different sphere\n",
+              std::sqrt(squaredError / imageDouble.size()), objectDiffs,
+              idsDouble.size());
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef REFIT_HPP
+#define REFIT_HPP
+
+#include "benchCommon.hpp"
+#include "instancing.hpp"
+
+#include "animation.hpp"
+#include "scene.hpp"
+#include "sceneFile.hpp"
+
+#include <cstdio>
+
+// per-frame cost of moving every instance of an animated scene: refitting
+// the instance BVH against rebuilding it, and the ray throughput each leaves
+// as the instances drift further from where the refitted tree was built.
+// each instance wanders up to 12 units across the grid and spins a full
+// turn over 16 frames
+inline void benchRefit() {
+  std::printf("%10s %6s %9s %9s %11s %12s %14s\n", "instances", "frame",
+              "place ms", "refit ms", "rebuild ms", "refit Kray/s",
+              "rebuild Kray/s");
+  for (size_t n = 4000; n <= 256000; n *= 4) {
+    SceneFile file;
+    instancingScene(file, n, false);
+    seedRandom(0, 7);
+    for (size_t i = 0; i < n; ++i) {
+      Vec3 axis = randomUnitVector();
+      file.addMotionKey(uint32_t(i), 0, Vec3(0, 0, 0), axis, 0);
+      file.addMotionKey(uint32_t(i), 16,
+                        Vec3(randomDouble(-6, 6), 0, randomDouble(-6, 6)),
+                        axis, 360);
+    }
+
+    Scene refitted, rebuilt;
+    refitted.build(file);
+    rebuilt.build(file);
+    for (int frame = 1; frame <= 16; frame *= 2) {
+      Stopwatch placeTimer;
+      placeInstances(file, refitted, frame, 0);
+      double placeSeconds = placeTimer.seconds();
+      placeInstances(file, rebuilt, frame, 0);
+
+      // the refit side may still rebuild, when refitting has degraded the
+      // tree too far (marked with a *)
+      Stopwatch refitTimer;
+      bool gaveUp = refitted.refit();
+      double refitSeconds = refitTimer.seconds();
+      Stopwatch rebuildTimer;
+      rebuilt.refit(true);
+      double rebuildSeconds = rebuildTimer.seconds();
+
+      std::printf("%10zu %6d %9.2f %8.2f%s %11.2f %12.1f %14.1f\n", n, frame,
+                  placeSeconds * 1e3, refitSeconds * 1e3, gaveUp ? "*" : " ",
+                  rebuildSeconds * 1e3,
+                  traceRate(refitted, 100000) / 1e3,
+                  traceRate(rebuilt, 100000) / 1e3);
+    }
+  }
+}
+
+#endif
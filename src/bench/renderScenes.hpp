@@ -0,0 +1,218 @@
+#ifndef RENDER_SCENES_HPP
+#define RENDER_SCENES_HPP
+
+#include "benchCommon.hpp"
+
+#include "builtinScenes.hpp"
+#include "camera.hpp"
+#include "scene.hpp"
+#include "sceneFile.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum class ReportFormat { Table, Csv, Json };
+
+struct SceneResult {
+  std::string name;
+  size_t spheres;
+  RenderStats stats;
+  double buildSeconds;
+};
+
+struct MicroResult {
+  std::string name;
+  double nsPerCall;
+};
+
+// renders every built-in scene end to end at a fixed small size and reports
+// where the rays went. the counters need RT_STATS, which the bench target
+// defines; the timings are always there
+inline std::vector<SceneResult> renderBuiltinScenes() {
+  const std::string outputPath = "benchRender.ppm";
+  std::vector<SceneResult> results;
+
+  int count;
+  const BuiltinScene *scenes = builtinScenes(count);
+  for (int i = 0; i < count; ++i) {
+    SceneFile file;
+    seedRandom(0, 0);
+    scenes[i].generate(file);
+
+    Stopwatch buildTimer;
+    Scene scene;
+    scene.build(file);
+    double buildSeconds = buildTimer.seconds();
+
+    Camera cam;
+    file.applyCamera(cam);
+    cam.IMAGE_WIDTH = 320;
+    cam.SAMPLES_PER_PIXEL = 16;
+    cam.MAX_DEPTH = 50;
+    cam.LIGHTS = &scene.lights;
+    cam.IMAGE_FORMAT = ImageFormat::PpmBinary;
+    cam.OUTPUT_PATH = outputPath;
+    cam.LOG_PROGRESS = false;
+    cam.render(scene.world);
+
+    results.push_back(
+        {scenes[i].name, file.sphereCount(), cam.lastStats(), buildSeconds});
+  }
+  std::remove(outputPath.c_str());
+  return results;
+}
+
+// the per-call cost of the functions every path spends its time in, in
+// isolation: a single sphere test, a linear HittableList of 64 spheres, and
+// each material's scatter
+inline std::vector<MicroResult> microBenchmarks() {
+  std::vector<MicroResult> results;
+  const size_t calls = 2000000;
+  MaterialTable materials;
+  auto lambertian = materials.add<Lambertian>(Colour(0.5, 0.5, 0.5));
+  auto metal = materials.add<Metal>(Colour(0.7, 0.6, 0.5), 0.1);
+  auto dielectric = materials.add<Dielectric>(1.5);
+
+  seedRandom(0, 3);
+  std::vector<Ray> rays(1024);
+  for (auto &r : rays)
+    r = Ray(Point3(0, 0, 0), randomUnitVector());
+
+  HitRecord rec;
+  size_t hits = 0;
+  Sphere sphere(Point3(0, 0, -2), 1.0, lambertian);
+  Stopwatch sphereTimer;
+  for (size_t i = 0; i < calls; ++i)
+    hits += sphere.hit(rays[i & 1023], Interval(0.001, infinity), rec);
+  results.push_back({"Sphere::hit", sphereTimer.seconds() * 1e9 / calls});
+
+  HittableList list;
+  for (int i = 0; i < 64; ++i)
+    list.add(make_shared<Sphere>(Vec3::random(-4, 4), 0.5, lambertian));
+  const size_t listCalls = calls / 16;
+  Stopwatch listTimer;
+  for (size_t i = 0; i < listCalls; ++i)
+    hits += list.hit(rays[i & 1023], Interval(0.001, infinity), rec);
+  results.push_back(
+      {"HittableList::hit (64)", listTimer.seconds() * 1e9 / listCalls});
+
+  // one hit record per ray on the unit sphere, entering from outside
+  std::vector<HitRecord> records(rays.size());
+  for (size_t i = 0; i < rays.size(); ++i) {
+    Ray inward(-rays[i].direction() * 2, rays[i].direction());
+    Sphere(Point3(0, 0, 0), 1.0, lambertian)
+        .hit(inward, Interval(0.001, infinity), records[i]);
+  }
+
+  const Material *scatterers[3] = {lambertian, metal, dielectric};
+  const char *names[3] = {"Lambertian::scatter", "Metal::scatter",
+                          "Dielectric::scatter"};
+  for (int m = 0; m < 3; ++m) {
+    Ray scattered;
+    Colour attenuation;
+    Stopwatch timer;
+    for (size_t i = 0; i < calls; ++i) {
+      Ray inward(-rays[i & 1023].direction() * 2, rays[i & 1023].direction());
+      hits += scatterers[m]->scatter(inward, records[i & 1023], attenuation,
+                                     scattered);
+    }
+    results.push_back({names[m], timer.seconds() * 1e9 / calls});
+  }
+
+  // keeps the loops above from being optimised away
+  if (hits == 0)
+    std::printf("(no hits)\n");
+  return results;
+}
+
+inline void printRenderTable(const std::vector<SceneResult> &scenes,
+                             const std::vector<MicroResult> &micro) {
+  std::printf("320 px wide, 16 spp, depth 50%s\n",
+#ifdef RT_STATS
+              ""
+#else
+              " (built without RT_STATS: no ray counts)"
+#endif
+  );
+  std::printf("%-6s %8s %11s %11s %7s %10s %10s %8s %8s %8s\n", "scene",
+              "spheres", "prim Mray/s", "sec Mray/s", "depth", "tests/ray",
+              "nodes/ray", "build s", "render s", "output s");
+  for (const auto &s : scenes) {
+    const RenderStats &st = s.stats;
+    double rays = double(std::max<uint64_t>(st.rays(), 1));
+    std::printf("%-6s %8zu %11.3f %11.3f %7.2f %10.1f %10.1f %8.3f %8.3f "
+                "%8.3f\n",
+                s.name.c_str(), s.spheres,
+                st.primaryRays / st.renderSeconds / 1e6,
+                st.secondaryRays / st.renderSeconds / 1e6,
+                st.primaryRays ? rays / st.primaryRays : 0.0,
+                st.primitiveTests / rays, st.nodeVisits / rays, s.buildSeconds,
+                st.renderSeconds, st.outputSeconds);
+  }
+  for (const auto &m : micro)
+    std::printf("  %-24s %8.2f ns/call\n", m.name.c_str(), m.nsPerCall);
+}
+
+// long format, one value per line, so new metrics don't shift columns
+inline void printRenderCsv(const std::vector<SceneResult> &scenes,
+                           const std::vector<MicroResult> &micro) {
+  std::printf("table,name,metric,value\n");
+  for (const auto &s : scenes) {
+    const RenderStats &st = s.stats;
+    const char *n = s.name.c_str();
+    std::printf("scene,%s,spheres,%zu\n", n, s.spheres);
+    std::printf("scene,%s,primary_rays,%llu\n", n,
+                (unsigned long long)st.primaryRays);
+    std::printf("scene,%s,secondary_rays,%llu\n", n,
+                (unsigned long long)st.secondaryRays);
+    std::printf("scene,%s,primitive_tests,%llu\n", n,
+                (unsigned long long)st.primitiveTests);
+    std::printf("scene,%s,node_visits,%llu\n", n,
+                (unsigned long long)st.nodeVisits);
+    std::printf("scene,%s,build_seconds,%.6f\n", n, s.buildSeconds);
+    std::printf("scene,%s,render_seconds,%.6f\n", n, st.renderSeconds);
+    std::printf("scene,%s,output_seconds,%.6f\n", n, st.outputSeconds);
+  }
+  for (const auto &m : micro)
+    std::printf("micro,%s,ns_per_call,%.3f\n", m.name.c_str(), m.nsPerCall);
+}
+
+// raw counts and seconds only: rates are left to whatever reads it
+inline void printRenderJson(const std::vector<SceneResult> &scenes,
+                            const std::vector<MicroResult> &micro) {
+  std::printf("{\"scenes\": [");
+  for (size_t i = 0; i < scenes.size(); ++i) {
+    const SceneResult &s = scenes[i];
+    const RenderStats &st = s.stats;
+    std::printf("%s\n  {\"name\": \"%s\", \"spheres\": %zu, "
+                "\"primary_rays\": %llu, \"secondary_rays\": %llu, "
+                "\"primitive_tests\": %llu, \"node_visits\": %llu, "
+                "\"build_seconds\": %.6f, \"render_seconds\": %.6f, "
+                "\"output_seconds\": %.6f}",
+                i ? "," : "", s.name.c_str(), s.spheres,
+                (unsigned long long)st.primaryRays,
+                (unsigned long long)st.secondaryRays,
+                (unsigned long long)st.primitiveTests,
+                (unsigned long long)st.nodeVisits, s.buildSeconds,
+                st.renderSeconds, st.outputSeconds);
+  }
+  std::printf("],\n \"micro\": [");
+  for (size_t i = 0; i < micro.size(); ++i)
+    std::printf("%s\n  {\"name\": \"%s\", \"ns_per_call\": %.3f}",
+                i ? "," : "", micro[i].name.c_str(), micro[i].nsPerCall);
+  std::printf("]}\n");
+}
+
+inline void benchRenderScenes(ReportFormat format) {
+  auto scenes = renderBuiltinScenes();
+  auto micro = microBenchmarks();
+  if (format == ReportFormat::Csv)
+    printRenderCsv(scenes, micro);
+  else if (format == ReportFormat::Json)
+    printRenderJson(scenes, micro);
+  else
+    printRenderTable(scenes, micro);
+}
+
+#endif
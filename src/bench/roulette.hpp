@@ -0,0 +1,65 @@
+#ifndef ROULETTE_HPP
+#define ROULETTE_HPP
+
+#include "benchCommon.hpp"
+
+#include "builtinScenes.hpp"
+#include "camera.hpp"
+#include "scene.hpp"
+#include "sceneFile.hpp"
+
+#include <cstdio>
+#include <string>
+
+// what Russian roulette (Camera::ROULETTE_DEPTH) does to the built-in scenes
+// as MAX_DEPTH grows: rays per path, how many paths it ends, and the time
+// and throughput with it off and on. without it paths in enclosed scenes
+// (deep, inst) grow longer as MAX_DEPTH does, each bounce adding less; with
+// it the path length stops growing a few bounces past rouletteDepth. the
+// mean pixel value is there to show the image stays the same on average
+inline void benchRoulette() {
+  const std::string outputPath = "benchRoulette.ppm";
+  const int rouletteDepth = 3;
+
+  std::printf("160 px wide, 8 spp, roulette after %d bounces\n",
+              rouletteDepth);
+  std::printf("%-6s %6s %9s %10s %9s %9s %9s %10s\n", "scene", "depth",
+              "roulette", "rays/path", "ended %", "render s", "Mray/s",
+              "mean");
+  int count;
+  const BuiltinScene *scenes = builtinScenes(count);
+  for (int i = 0; i < count; ++i) {
+    SceneFile file;
+    seedRandom(0, 0);
+    scenes[i].generate(file);
+    Scene scene;
+    scene.build(file);
+
+    for (int maxDepth = 10; maxDepth <= 1000; maxDepth *= 10) {
+      for (int on = 0; on < 2; ++on) {
+        Camera cam;
+        file.applyCamera(cam);
+        cam.IMAGE_WIDTH = 160;
+        cam.SAMPLES_PER_PIXEL = 8;
+        cam.MAX_DEPTH = maxDepth;
+        cam.ROULETTE_DEPTH = on ? rouletteDepth : 0;
+        cam.LIGHTS = &scene.lights;
+        cam.IMAGE_FORMAT = ImageFormat::PpmBinary;
+        cam.OUTPUT_PATH = outputPath;
+        cam.LOG_PROGRESS = false;
+        cam.render(scene.world);
+
+        const RenderStats &s = cam.lastStats();
+        double paths = double(s.primaryRays ? s.primaryRays : 1);
+        std::printf("%-6s %6d %9s %10.2f %9.1f %9.3f %9.2f %10.2f\n",
+                    scenes[i].name, maxDepth, on ? "on" : "off",
+                    s.rays() / paths, 100 * s.roulettePaths / paths,
+                    s.renderSeconds, s.rays() / s.renderSeconds / 1e6,
+                    meanPixel(outputPath));
+      }
+    }
+  }
+  std::remove(outputPath.c_str());
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SCENE_LOAD_HPP
+#define SCENE_LOAD_HPP
+
+#include "benchCommon.hpp"
+
+#include "scene.hpp"
+#include "sceneFile.hpp"
+
+#include <cstdio>
+#include <string>
+
+// writes a random sphere cloud as a binary and a text scene file, then times
+// loading each one and building the renderable Scene from it
+inline void benchSceneLoad() {
+  std::printf("%10s %11s %11s %11s %11s %9s\n", "spheres", "write s",
+              "binary s", "text s", "build s", "MB");
+
+  const std::string binaryPath = "benchScene.rtsc";
+  const std::string textPath = "benchScene.txt";
+
+  for (size_t n = 100000; n <= 10000000; n *= 10) {
+    double writeSeconds;
+    {
+      SceneFile generated;
+      uint32_t mats[3] = {
+          generated.addMaterial(SceneMaterialKind::Lambertian, 0.5, 0.5, 0.5),
+          generated.addMaterial(SceneMaterialKind::Metal, 0.7, 0.6, 0.5, 0.1),
+          generated.addMaterial(SceneMaterialKind::Dielectric, 1.5)};
+      seedRandom(0, n);
+      double halfSide = std::cbrt(double(n));
+      for (size_t i = 0; i < n; ++i)
+        generated.addSphere(Vec3::random(-halfSide, halfSide), 0.25,
+                            mats[i % 3]);
+
+      Stopwatch timer;
+      if (!generated.saveBinary(binaryPath) || !generated.saveText(textPath))
+        return;
+      writeSeconds = timer.seconds();
+    }
+
+    SceneFile binary, text;
+    Stopwatch binaryTimer;
+    binary.load(binaryPath);
+    double binarySeconds = binaryTimer.seconds();
+
+    Stopwatch textTimer;
+    text.load(textPath);
+    double textSeconds = textTimer.seconds();
+
+    Stopwatch buildTimer;
+    Scene scene;
+    scene.build(binary);
+    double buildSeconds = buildTimer.seconds();
+
+    double megabytes = n * sizeof(SceneSphereRecord) / 1e6;
+    std::printf("%10zu %11.3f %11.3f %11.3f %11.3f %9.1f\n", n, writeSeconds,
+                binarySeconds, textSeconds, buildSeconds, megabytes);
+  }
+  std::remove(binaryPath.c_str());
+  std::remove(textPath.c_str());
+}
+
+#endif
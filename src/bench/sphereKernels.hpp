@@ -0,0 +1,62 @@
+#ifndef SPHERE_KERNELS_HPP
+#define SPHERE_KERNELS_HPP
+
+#include "benchCommon.hpp"
+
+#include "linearBvh.hpp"
+#include "sphereSet.hpp"
+
+#include <cstdio>
+#include <vector>
+
+// same sphere cloud traced through a LinearBvh of individual Spheres and
+// through a SphereSet (SIMD packets in the BVH leaves)
+inline void benchSphereKernels() {
+  std::printf("kernel: %s, %d spheres per packet\n", sphereSetKernelName(),
+              SpherePacket::PACKET_WIDTH);
+  std::printf("%10s %14s %14s %9s %9s\n", "spheres", "bvh Kray/s",
+              "set Kray/s", "speedup", "mismatch");
+
+  MaterialTable materials;
+  auto mat = materials.add<Lambertian>(Colour(0.5, 0.5, 0.5));
+
+  for (size_t n = 1000; n <= 1000000; n *= 10) {
+    seedRandom(0, n);
+    HittableList list = sphereCloud(n, mat);
+    LinearBvh bvh(list);
+
+    // same centres as the list, which only holds Spheres
+    seedRandom(0, n);
+    SphereSet set;
+    double halfSide = std::cbrt(double(n));
+    for (size_t i = 0; i < n; ++i)
+      set.add(Vec3::random(-halfSide, halfSide), 0.25, mat);
+    set.build();
+
+    const size_t rayCount = 500000;
+    std::vector<Ray> rays(rayCount);
+    for (auto &r : rays)
+      r = randomRayIn(list.boundingBox());
+
+    HitRecord rec;
+    std::vector<double> bvhT(rayCount);
+    Stopwatch bvhTimer;
+    for (size_t i = 0; i < rayCount; ++i)
+      bvhT[i] = bvh.hit(rays[i], Interval(0.001, infinity), rec) ? rec.t : -1;
+    double bvhRate = rayCount / bvhTimer.seconds();
+
+    size_t mismatches = 0;
+    Stopwatch setTimer;
+    for (size_t i = 0; i < rayCount; ++i) {
+      double t = set.hit(rays[i], Interval(0.001, infinity), rec) ? rec.t : -1;
+      if (t != bvhT[i])
+        ++mismatches;
+    }
+    double setRate = rayCount / setTimer.seconds();
+
+    std::printf("%10zu %14.1f %14.1f %8.2fx %9zu\n", n, bvhRate / 1e3,
+                setRate / 1e3, setRate / bvhRate, mismatches);
+  }
+}
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef BUILTIN_SCENES_HPP
+#define BUILTIN_SCENES_HPP
+
+#include "rtweekend.hpp"
+
+#include "sceneFile.hpp"
+
+// scenes generated in code rather than loaded from scenes/: the cover, and
+// the standard workloads the bench render suite times
+
+inline void setLookAt(SceneCameraRecord &camera, const Point3 &lookfrom,
+                      const Point3 &lookat) {
+  for (int i = 0; i < 3; ++i) {
+    camera.lookfrom[i] = lookfrom[i];
+    camera.lookat[i] = lookat[i];
+  }
+}
+
+// the cover of Ray Tracing in One Weekend: three large spheres on a diffuse
+// ground, surrounded by a grid of small random ones
+inline void coverScene(SceneFile &file) {
+  file.camera.aspectRatio = 16.0 / 9.0;
+  file.camera.imageWidth = 1200;
+  file.camera.samplesPerPixel = 100;
+  file.camera.maxDepth = 50;
+
+  file.camera.vfov = 20;
+  setLookAt(file.camera, Point3(13, 2, 3), Point3(0, 0, -1));
+
+  file.camera.defocusAngle = 0.6;
+  file.camera.focusDistance = 10.0;
+
+  auto ground = file.addMaterial(SceneMaterialKind::Lambertian, 0.5, 0.5, 0.5);
+  file.addSphere(Point3(0, -1000, 0), 1000, ground);
+
+  auto material1 = file.addMaterial(SceneMaterialKind::Dielectric, 1.5);
+  file.addSphere(Point3(0, 1, 0), 1.0, material1);
+
+  auto material2 =
+      file.addMaterial(SceneMaterialKind::Lambertian, 0.4, 0.2, 0.1);
+  file.addSphere(Point3(-4, 1, 0), 1.0, material2);
+
+  auto material3 =
+      file.addMaterial(SceneMaterialKind::Metal, 0.7, 0.6, 0.5, 0.0);
+  file.addSphere(Point3(4, 1, 0), 1.0, material3);
+
+  for (int a = -11; a < 11; a++) {
+    for (int b = -11; b < 11; b++) {
+      auto choose_mat = randomDouble();
+      Point3 center(a + 0.9 * randomDouble(), 0.2, b + 0.9 * randomDouble());
+
+      if ((center - Point3(4, 0.2, 0)).length() > 0.9) {
+        uint32_t sphere_material;
+
+        if (choose_mat < 0.8) {
+          // diffuse
+          auto albedo = Colour::random() * Colour::random();
+          sphere_material =
+              file.addMaterial(SceneMaterialKind::Lambertian, albedo.x(),
+                               albedo.y(), albedo.z());
+        } else if (choose_mat < 0.95) {
+          // metal
+          auto albedo = Colour::random(0.5, 1);
+          auto fuzz = randomDouble(0, 0.5);
+          sphere_material =
+              file.addMaterial(SceneMaterialKind::Metal, albedo.x(),
+                               albedo.y(), albedo.z(), fuzz);
+        } else {
+          // glass
+          sphere_material =
+              file.addMaterial(SceneMaterialKind::Dielectric, 1.5);
+        }
+        file.addSphere(center, 0.2, sphere_material);
+      }
+    }
+  }
+}
+
+// a 100x100 grid of small diffuse and metal spheres seen from above: lots of
+// primitives per ray, short paths
+inline void gridScene(SceneFile &file) {
+  file.camera.aspectRatio = 16.0 / 9.0;
+  file.camera.maxDepth = 50;
+  file.camera.vfov = 40;
+  setLookAt(file.camera, Point3(0, 30, 40), Point3(0, 0, 0));
+
+  auto ground = file.addMaterial(SceneMaterialKind::Lambertian, 0.5, 0.5, 0.5);
+  file.addSphere(Point3(0, -1000, 0), 1000, ground);
+
+  seedRandom(0, 1);
+  for (int a = -50; a < 50; ++a) {
+    for (int b = -50; b < 50; ++b) {
+      auto albedo = Colour::random(0.2, 0.9);
+      auto mat = randomDouble() < 0.8
+                     ? file.addMaterial(SceneMaterialKind::Lambertian,
+                                        albedo.x(), albedo.y(), albedo.z())
+                     : file.addMaterial(SceneMaterialKind::Metal, albedo.x(),
+                                        albedo.y(), albedo.z(), 0.1);
+      file.addSphere(Point3(a * 0.5, 0.2, b * 0.5), 0.2, mat);
+    }
+  }
+}
+
+// a few hundred glass spheres, some nested as hollow shells: every hit
+// refracts or reflects, so nearly every path runs long
+inline void glassScene(SceneFile &file) {
+  file.camera.aspectRatio = 16.0 / 9.0;
+  file.camera.maxDepth = 50;
+  file.camera.vfov = 30;
+  setLookAt(file.camera, Point3(0, 3, 12), Point3(0, 1, 0));
+
+  auto ground = file.addMaterial(SceneMaterialKind::Lambertian, 0.4, 0.5, 0.4);
+  file.addSphere(Point3(0, -1000, 0), 1000, ground);
+
+  auto glass = file.addMaterial(SceneMaterialKind::Dielectric, 1.5);
+  auto air = file.addMaterial(SceneMaterialKind::Dielectric, 1.0 / 1.5);
+  seedRandom(0, 2);
+  for (int i = 0; i < 300; ++i) {
+    Point3 centre(randomDouble(-6, 6), randomDouble(0.3, 3),
+                  randomDouble(-6, 3));
+    auto radius = randomDouble(0.15, 0.3);
+    file.addSphere(centre, radius, glass);
+    if (i % 4 == 0)
+      file.addSphere(centre, radius * 0.8, air);
+  }
+}
+
+// the camera sits between two huge facing mirrors with a row of diffuse
+// spheres between them, so paths bounce until MAX_DEPTH or absorption
+inline void deepBounceScene(SceneFile &file) {
+  file.camera.aspectRatio = 16.0 / 9.0;
+  file.camera.maxDepth = 50;
+  file.camera.vfov = 60;
+  setLookAt(file.camera, Point3(0, 1, 0), Point3(0, 1, -1));
+
+  auto mirror = file.addMaterial(SceneMaterialKind::Metal, 0.95, 0.95, 0.95, 0);
+  file.addSphere(Point3(0, 1, -1004), 1000, mirror);
+  file.addSphere(Point3(0, 1, 1004), 1000, mirror);
+  auto floor = file.addMaterial(SceneMaterialKind::Metal, 0.8, 0.8, 0.9, 0.02);
+  file.addSphere(Point3(0, -1000, 0), 1000, floor);
+
+  auto diffuse = file.addMaterial(SceneMaterialKind::Lambertian, 0.9, 0.9, 0.9);
+  for (int i = -3; i <= 3; ++i)
+    file.addSphere(Point3(i * 1.2, 0.5, -2), 0.5, diffuse);
+}
+
+// a small cluster of seven spheres (a diffuse core with metal and glass
+// satellites), instanced 14400 times over a field with random turns and
+// sizes: a hundred thousand spheres held as one object plus a transform each
+inline void instancedScene(SceneFile &file) {
+  file.camera.aspectRatio = 16.0 / 9.0;
+  file.camera.maxDepth = 50;
+  file.camera.vfov = 35;
+  setLookAt(file.camera, Point3(0, 6, 30), Point3(0, 0, 0));
+
+  auto ground = file.addMaterial(SceneMaterialKind::Lambertian, 0.5, 0.5, 0.5);
+  file.addSphere(Point3(0, -1000, 0), 1000, ground);
+
+  auto core = file.addMaterial(SceneMaterialKind::Lambertian, 0.7, 0.3, 0.2);
+  auto metal = file.addMaterial(SceneMaterialKind::Metal, 0.8, 0.8, 0.9, 0.05);
+  auto glass = file.addMaterial(SceneMaterialKind::Dielectric, 1.5);
+  auto cluster = file.beginObject();
+  file.addSphere(Point3(0, 0, 0), 0.2, core);
+  for (int axis = 0; axis < 3; ++axis) {
+    Vec3 offset(axis == 0, axis == 1, axis == 2);
+    file.addSphere(0.3 * offset, 0.1, metal);
+    file.addSphere(-0.3 * offset, 0.1, glass);
+  }
+  file.endObject();
+
+  seedRandom(0, 4);
+  for (int a = -60; a < 60; ++a) {
+    for (int b = -60; b < 60; ++b) {
+      auto scale = randomDouble(0.6, 1.4);
+      auto toWorld =
+          Affine::translate(Vec3(a * 0.8, 0.4 * scale, b * 0.8)) *
+          Affine::rotate(randomUnitVector(), randomDouble(0, 360)) *
+          Affine::scale(Vec3(scale, scale, scale));
+      file.addInstance(cluster, toWorld);
+    }
+  }
+}
+
+// a night version of the cover: the sky nearly off, lit by a few small
+// coloured emitters hanging among diffuse, metal and glass spheres. found by
+// chance the lights take thousands of samples to converge, which is what
+// next-event estimation is for
+inline void litScene(SceneFile &file) {
+  file.camera.aspectRatio = 16.0 / 9.0;
+  file.camera.maxDepth = 50;
+  file.camera.vfov = 30;
+  setLookAt(file.camera, Point3(10, 3, 6), Point3(0, 0.5, 0));
+  file.environment.skyScale = 0.02f;
+
+  auto ground = file.addMaterial(SceneMaterialKind::Lambertian, 0.5, 0.5, 0.5);
+  file.addSphere(Point3(0, -1000, 0), 1000, ground);
+
+  auto warm = file.addMaterial(SceneMaterialKind::Light, 40, 28, 16);
+  auto cool = file.addMaterial(SceneMaterialKind::Light, 12, 20, 40);
+  file.addSphere(Point3(-1, 2.5, 1), 0.15, warm);
+  file.addSphere(Point3(2, 1.8, -2), 0.12, cool);
+  file.addSphere(Point3(3, 0.6, 2.5), 0.1, warm);
+
+  auto glass = file.addMaterial(SceneMaterialKind::Dielectric, 1.5);
+  auto metal = file.addMaterial(SceneMaterialKind::Metal, 0.8, 0.8, 0.8, 0.0);
+  auto red = file.addMaterial(SceneMaterialKind::Lambertian, 0.7, 0.2, 0.2);
+  file.addSphere(Point3(0, 1, 0), 1.0, glass);
+  file.addSphere(Point3(-3, 1, -1), 1.0, metal);
+  file.addSphere(Point3(2, 0.7, 0.5), 0.7, red);
+
+  seedRandom(0, 5);
+  for (int a = -6; a < 6; ++a) {
+    for (int b = -6; b < 6; ++b) {
+      Point3 centre(a + 0.8 * randomDouble(), 0.2, b + 0.8 * randomDouble());
+      if ((centre - Point3(0, 0.2, 0)).length() < 1.3 ||
+          (centre - Point3(-3, 0.2, -1)).length() < 1.3 ||
+          (centre - Point3(2, 0.2, 0.5)).length() < 1)
+        continue;
+      auto albedo = Colour::random() * Colour::random();
+      bool diffuse = randomDouble() < 0.85;
+      auto material =
+          diffuse ? file.addMaterial(SceneMaterialKind::Lambertian, albedo.x(),
+                                     albedo.y(), albedo.z())
+                  : file.addMaterial(SceneMaterialKind::Metal, 0.7, 0.7, 0.7,
+                                     0.1);
+      file.addSphere(centre, 0.2, material);
+    }
+  }
+}
+
+struct BuiltinScene {
+  const char *name;
+  void (*generate)(SceneFile &file);
+};
+
+inline const BuiltinScene *builtinScenes(int &count) {
+  static const BuiltinScene scenes[] = {{"cover", coverScene},
+                                        {"grid", gridScene},
+                                        {"glass", glassScene},
+                                        {"deep", deepBounceScene},
+                                        {"inst", instancedScene},
+                                        {"lights", litScene}};
+  count = int(sizeof(scenes) / sizeof(scenes[0]));
+  return scenes;
+}
+
+#endif
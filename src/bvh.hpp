@@ -0,0 +1,210 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include "rtweekend.hpp"
+
+#include "aabb.hpp"
+#include "hittable.hpp"
+#include "hittableList.hpp"
+
+#include <algorithm>
+#include <vector>
+
+// result of searching for the best SAH split of a range of objects
+struct SahSplit {
+  int axis = -1;      // -1 when every centroid coincides (nothing to split on)
+  double pos = 0;     // objects with centroid[axis] < pos go on the left
+  double cost = 0;    // expected number of child intersection tests per ray
+                      // that reaches this node, i.e. (A_l*N_l + A_r*N_r) / A
+};
+
+// binned surface area heuristic: bucket the centroids into SAH_BINS slots along
+// each axis and evaluate the SAH cost at every bucket boundary. binning keeps
+// the build O(N) per level instead of sorting every range on every axis
+const int SAH_BINS = 16;
+
+// the buckets of one range. a big range can be binned in pieces, one SahBins
+// per thread, and the pieces merged: the boxes and counts come out the same
+// whatever way the range was cut, so the split does too
+class SahBins {
+public:
+  explicit SahBins(const AABB &centroidBounds) {
+    for (int axis = 0; axis < 3; ++axis) {
+      extent[axis] = centroidBounds.axisInterval(axis);
+      // an axis every centroid sits at the same point of can't be split
+      scale[axis] =
+          extent[axis].size() > 0 ? SAH_BINS / extent[axis].size() : 0;
+      for (int b = 0; b < SAH_BINS; ++b)
+        count[axis][b] = 0;
+    }
+  }
+
+  void add(const AABB &box) {
+    Point3 centroid = box.centroid();
+    for (int axis = 0; axis < 3; ++axis) {
+      if (scale[axis] == 0)
+        continue;
+      int b = int((centroid[axis] - extent[axis].min) * scale[axis]);
+      b = std::min(std::max(b, 0), SAH_BINS - 1);
+      ++count[axis][b];
+      boxes[axis][b] = AABB(boxes[axis][b], box);
+    }
+  }
+
+  void merge(const SahBins &other) {
+    for (int axis = 0; axis < 3; ++axis) {
+      for (int b = 0; b < SAH_BINS; ++b) {
+        count[axis][b] += other.count[axis][b];
+        boxes[axis][b] = AABB(boxes[axis][b], other.boxes[axis][b]);
+      }
+    }
+  }
+
+  // the cheapest split at a bucket boundary of a range bounded by bounds
+  SahSplit best(const AABB &bounds) const {
+    SahSplit best;
+    best.cost = infinity;
+    double parentArea = bounds.surfaceArea();
+
+    for (int axis = 0; axis < 3; ++axis) {
+      if (scale[axis] == 0)
+        continue;
+
+      // sweep right to left to get the area and count of every right half...
+      double rightArea[SAH_BINS];
+      size_t rightCount[SAH_BINS];
+      AABB acc;
+      size_t n = 0;
+      for (int b = SAH_BINS - 1; b > 0; --b) {
+        acc = AABB(acc, boxes[axis][b]);
+        n += count[axis][b];
+        rightArea[b] = acc.surfaceArea();
+        rightCount[b] = n;
+      }
+
+      // ...then left to right, pairing them with the matching left half
+      acc = AABB();
+      n = 0;
+      for (int b = 1; b < SAH_BINS; ++b) {
+        acc = AABB(acc, boxes[axis][b - 1]);
+        n += count[axis][b - 1];
+        if (n == 0 || rightCount[b] == 0)
+          continue;
+
+        double cost =
+            (acc.surfaceArea() * n + rightArea[b] * rightCount[b]) /
+            parentArea;
+        if (cost < best.cost) {
+          best.axis = axis;
+          best.pos = extent[axis].min + b / scale[axis];
+          best.cost = cost;
+        }
+      }
+    }
+    return best;
+  }
+
+private:
+  Interval extent[3];
+  double scale[3]; // buckets per unit of extent, 0 for an axis not split on
+  AABB boxes[3][SAH_BINS];
+  size_t count[3][SAH_BINS];
+};
+
+template <typename BoxFn>
+SahSplit findSahSplit(size_t count, const AABB &bounds,
+                      const AABB &centroidBounds, const BoxFn &boxOf) {
+  SahBins bins(centroidBounds);
+  for (size_t i = 0; i < count; ++i)
+    bins.add(boxOf(i));
+  return bins.best(bounds);
+}
+
+// reorders objects[start, end) around the best SAH split and returns the index
+// of the first object of the right half. falls back to an even split when the
+// centroids are all the same point
+inline size_t sahPartition(std::vector<shared_ptr<Hittable>> &objects,
+                           size_t start, size_t end) {
+  AABB bounds, centroidBounds;
+  for (size_t i = start; i < end; ++i) {
+    AABB box = objects[i]->boundingBox();
+    bounds = AABB(bounds, box);
+    Point3 c = box.centroid();
+    centroidBounds = AABB(centroidBounds, AABB(c, c));
+  }
+
+  SahSplit split = findSahSplit(
+      end - start, bounds, centroidBounds,
+      [&](size_t i) { return objects[start + i]->boundingBox(); });
+
+  if (split.axis < 0)
+    return start + (end - start) / 2;
+
+  auto mid = std::partition(
+      objects.begin() + start, objects.begin() + end,
+      [&](const shared_ptr<Hittable> &object) {
+        return object->boundingBox().centroid()[split.axis] < split.pos;
+      });
+
+  // rounding at a bin edge can in principle empty one side
+  if (mid == objects.begin() + start || mid == objects.begin() + end)
+    return start + (end - start) / 2;
+  return size_t(mid - objects.begin());
+}
+
+// binary tree of bounding boxes. each node owns two children, which are either
+// further BvhNodes or the scene objects themselves
+class BvhNode : public Hittable {
+public:
+  BvhNode(HittableList list) : BvhNode(list.objects, 0, list.objects.size()) {
+    // the copy of list only lives until this constructor finishes, the tree
+    // keeps its own references to the objects
+  }
+
+  BvhNode(std::vector<shared_ptr<Hittable>> &objects, size_t start,
+          size_t end) {
+    size_t span = end - start;
+
+    if (span == 1) {
+      left = right = objects[start];
+    } else if (span == 2) {
+      left = objects[start];
+      right = objects[start + 1];
+    } else {
+      size_t mid = sahPartition(objects, start, end);
+      left = make_shared<BvhNode>(objects, start, mid);
+      right = make_shared<BvhNode>(objects, mid, end);
+    }
+
+    bbox = AABB(left->boundingBox(), right->boundingBox());
+  }
+
+  bool hit(const Ray &r, Interval rayT, HitRecord &rec) const override {
+    RT_STAT(hitCalls, 1);
+    RT_STAT(nodeVisits, 1);
+    if (!bbox.hit(r, rayT))
+      return false;
+
+    bool hitLeft = left->hit(r, rayT, rec);
+    bool hitRight =
+        right->hit(r, Interval(rayT.min, hitLeft ? rec.t : rayT.max), rec);
+
+    return hitLeft || hitRight;
+  }
+
+  bool occluded(const Ray &r, Interval rayT) const override {
+    RT_STAT(hitCalls, 1);
+    RT_STAT(nodeVisits, 1);
+    return bbox.hit(r, rayT) &&
+           (left->occluded(r, rayT) || right->occluded(r, rayT));
+  }
+
+  AABB boundingBox() const override { return bbox; }
+
+private:
+  shared_ptr<Hittable> left;
+  shared_ptr<Hittable> right;
+  AABB bbox;
+};
+
+#endif
@@ -3,8 +3,24 @@
 
 #include "rtweekend.hpp"
 
+#include "checkpoint.hpp"
+#include "denoise.hpp"
+#include "environment.hpp"
 #include "hittable.hpp"
+#include "image.hpp"
+#include "light.hpp"
 #include "material.hpp"
+#include "parallel.hpp"
+#include "sampler.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <vector>
 
 class Camera {
 public:
@@ -27,30 +43,316 @@ public:
          // projection distance)
   double focusDistance = 10; // distance from LOOKFROM to perfect focus plane
 
+  int THREADS = 0;    // number of render threads (0 = all hardware threads)
+  int TILE_SIZE = 16; // width and height (in pixels) of the square render tiles
+  unsigned long long SEED = 0; // every pixel sample gets its own random
+                               // stream derived from this, so a given SEED
+                               // always renders the same image no matter the
+                               // thread count or tile size
+  SamplerType SAMPLER = SamplerType::Independent; // where pixel and lens
+                                                  // positions come from
+  ImageFormat IMAGE_FORMAT = ImageFormat::PpmAscii; // encoding of the output
+  std::string OUTPUT_PATH = ""; // file to write the image to (empty = stdout)
+  bool WAVEFRONT = false; // trace each tile as a wavefront of paths instead of
+                          // one recursive path at a time
+  bool LOG_PROGRESS = true; // report tiles remaining (and, built with
+                            // RT_STATS, the statistics) on std::clog
+  int PACKET_SIZE = 0; // camera rays are traced together in packets covering
+                       // PACKET_SIZE x PACKET_SIZE pixels (at most 8), each
+                       // path going on alone after its first hit; the
+                       // wavefront packs its first bounce PACKET_SIZE^2 paths
+                       // at a time. the image is the same either way (0 =
+                       // one ray at a time)
+  int ROULETTE_DEPTH = 0; // Russian roulette: after this many bounces each
+                          // path carries on with probability equal to its
+                          // brightest throughput channel and survivors are
+                          // scaled up to match, so the image stays unbiased
+                          // but dim paths end long before MAX_DEPTH (0 = off)
+  double SHUTTER = 0; // motion blur: how long the shutter stays open, as a
+                      // fraction of a frame. when > 0 each camera ray gets a
+                      // random time in [0, 1) across the open shutter, which
+                      // moving geometry uses to place itself (0 = no blur)
+  double SKY_SCALE = 1; // the sky's radiance is multiplied by this (0 = dark)
+
+  // next-event estimation. with LIGHTS set (Scene::lights) every diffuse hit
+  // also sends a shadow ray towards a point sampled on one of the lights,
+  // and light reached both that way and by scattering is weighted with
+  // multiple importance sampling (the power heuristic), so small bright
+  // emitters converge without double counting. null = emitters are only
+  // found by chance
+  const LightList *LIGHTS = nullptr;
+
+  // an HDR environment map to light the scene with instead of the sky
+  // gradient, scaled by SKY_SCALE like it. ENVIRONMENT_SAMPLING is how
+  // diffuse hits sample it with shadow rays, weighted against the rays that
+  // escape by multiple importance sampling as with LIGHTS
+  const EnvironmentMap *ENVIRONMENT = nullptr;
+  EnvironmentSampling ENVIRONMENT_SAMPLING = EnvironmentSampling::Importance;
+
+  // adaptive sampling (recursive integrator only). when ADAPTIVE_THRESHOLD > 0
+  // a pixel stops taking samples once the 95% confidence interval of its mean
+  // luminance is within ADAPTIVE_THRESHOLD of the mean (relative), so
+  // SAMPLES_PER_PIXEL becomes the maximum rather than the exact count
+  double ADAPTIVE_THRESHOLD = 0;
+  int ADAPTIVE_MIN_SAMPLES = 16; // samples every pixel takes before it can stop
+  std::string HEATMAP_PATH = ""; // if set, also write the per-pixel sample
+                                 // counts here as a blue (few) to red (many)
+                                 // PPM
+
+  // progressive rendering. when PASS_SAMPLES > 0 the image is built up in
+  // passes of PASS_SAMPLES samples per pixel (up to SAMPLES_PER_PIXEL) in a
+  // float accumulation buffer. after every pass the current average goes to
+  // PREVIEW_PATH, and every CHECKPOINT_INTERVAL passes (and at the end) the
+  // buffer is saved to CHECKPOINT_PATH. a later run with the same camera and
+  // scene resumes from that checkpoint, so raising SAMPLES_PER_PIXEL only
+  // renders the extra samples
+  int PASS_SAMPLES = 0;
+  std::string PREVIEW_PATH = "";
+  std::string CHECKPOINT_PATH = "";
+  int CHECKPOINT_INTERVAL = 1;
+
+  // built with RT_STATS, the intersection work (BVH nodes plus primitive
+  // tests) spent on each pixel is written here as a blue (cheap) to red
+  // (expensive) PPM
+  std::string COST_MAP_PATH = "";
+
+  // denoising (see denoise.hpp). with DENOISE the image is filtered before
+  // it's written, guided by what each pixel's camera rays hit first: the
+  // surface albedo, normal and depth. ALBEDO_PATH, NORMAL_PATH and
+  // DEPTH_PATH write those buffers out as well, in IMAGE_FORMAT (8-bit
+  // formats get the normals mapped into [0, 1] and the depth divided by its
+  // largest value)
+  bool DENOISE = false;
+  std::string ALBEDO_PATH = "";
+  std::string NORMAL_PATH = "";
+  std::string DEPTH_PATH = "";
+
+  // timings and (when built with RT_STATS) ray counts of the last render
+  const RenderStats &lastStats() const { return stats; }
+
+  // seconds spent on each tile of the last render, row by row (RT_STATS only)
+  const std::vector<double> &lastTileSeconds() const { return tileSeconds; }
+
+  // whether renders fill the feature buffers, and the buffers themselves.
+  // empty unless denoising or writing one of them
+  bool collectsFeatures() const {
+    return DENOISE || !ALBEDO_PATH.empty() || !NORMAL_PATH.empty() ||
+           !DEPTH_PATH.empty();
+  }
+  FeatureBuffers &features() { return featureBuffers; }
+
   void render(const Hittable &world) {
+    beginRender();
+    if (PASS_SAMPLES > 0) {
+      renderProgressive(world);
+      return;
+    }
+
+    // the framebuffer collects radiance sums, divided by the sample counts
+    // once every tile is done
+    Image framebuffer(IMAGE_WIDTH, IMAGE_HEIGHT);
+    std::vector<int> sampleCounts(size_t(IMAGE_WIDTH) * IMAGE_HEIGHT);
+    std::vector<PixelVariance> variances(sampleCounts.size());
+    renderTiles(world, SAMPLES_PER_PIXEL, framebuffer, sampleCounts,
+                variances);
+    for (size_t i = 0; i < framebuffer.pixels.size(); ++i)
+      framebuffer.pixels[i] = framebuffer.pixels[i] / sampleCounts[i];
+
+    // tiles finish in any order, so the image is only written once it's whole
+    finishRender(framebuffer, sampleCounts);
+  }
+
+  // the steps of render() on their own, for a distributed render (farm.hpp)
+  // whose tiles are traced in other processes: beginRender() once on every
+  // side, renderTile() wherever a tile runs, and finishRender() with the
+  // merged per-pixel averages on the side that writes the image
+
+  // pixel rows [m0, m1) and columns [n0, n1) of the image
+  struct Tile {
+    int m0, m1, n0, n1;
+  };
+
+  // running mean and variance of a pixel's sample luminance (Welford's
+  // method, which stays accurate without storing the samples)
+  struct PixelVariance {
+    int count = 0;
+    double mean = 0;
+    double m2 = 0; // sum of squared differences from the mean
+
+    void add(double x) {
+      ++count;
+      double delta = x - mean;
+      mean += delta / count;
+      m2 += delta * (x - mean);
+    }
+
+    // true once the 95% confidence half-width of the mean is within
+    // threshold of it. the small floor keeps near-black pixels from
+    // demanding an impossibly tight absolute error
+    bool converged(double threshold) const {
+      if (count < 2)
+        return false;
+      double varianceOfMean = m2 / (count - 1) / count;
+      return 1.96 * sqrt(varianceOfMean) <= threshold * (mean + 1e-3);
+    }
+  };
+
+  void beginRender() {
     initialize();
+    stats = RenderStats();
+    tileSeconds.clear();
+    pixelCost.assign(STATS_ENABLED && !COST_MAP_PATH.empty()
+                         ? size_t(IMAGE_WIDTH) * IMAGE_HEIGHT
+                         : 0,
+                     0);
+    if (collectsFeatures())
+      featureBuffers.reset(IMAGE_WIDTH, IMAGE_HEIGHT);
+    else
+      featureBuffers = FeatureBuffers();
+  }
 
-    std::cout << "P3\n" << IMAGE_WIDTH << ' ' << IMAGE_HEIGHT << "\n255\n";
+  int imageHeight() const { return IMAGE_HEIGHT; }
 
-    for (int m = 0; m < IMAGE_HEIGHT; ++m) {
-      std::clog << "\rScanlines remaining: " << (IMAGE_HEIGHT - m) << ' '
-                << std::flush;
-      for (int n = 0; n < IMAGE_WIDTH; ++n) {
-        Colour pixelColour(0, 0, 0);
-        for (int sample = 0; sample < SAMPLES_PER_PIXEL; ++sample) {
-          Ray r = getRay(m, n);
-          pixelColour += rayColour(r, MAX_DEPTH, world);
+  int tileCount() const {
+    int tileSize = std::max(TILE_SIZE, 1);
+    int tilesX = (IMAGE_WIDTH + tileSize - 1) / tileSize;
+    int tilesY = (IMAGE_HEIGHT + tileSize - 1) / tileSize;
+    return tilesX * tilesY;
+  }
+
+  // tiles are numbered row by row
+  Tile tileBounds(int tile) const {
+    int tileSize = std::max(TILE_SIZE, 1);
+    int tilesX = (IMAGE_WIDTH + tileSize - 1) / tileSize;
+    Tile bounds;
+    bounds.m0 = (tile / tilesX) * tileSize;
+    bounds.n0 = (tile % tilesX) * tileSize;
+    bounds.m1 = std::min(bounds.m0 + tileSize, IMAGE_HEIGHT);
+    bounds.n1 = std::min(bounds.n0 + tileSize, IMAGE_WIDTH);
+    return bounds;
+  }
+
+  // traces every sample of one tile on the calling thread, adding radiance
+  // sums to framebuffer. the buffers cover the whole image
+  void renderTile(const Hittable &world, int tile, Image &framebuffer,
+                  std::vector<int> &sampleCounts,
+                  std::vector<PixelVariance> &variances) {
+    if (WAVEFRONT)
+      renderTileWavefront(world, tileBounds(tile), SAMPLES_PER_PIXEL,
+                          framebuffer, sampleCounts);
+    else
+      renderTileRecursive(world, tileBounds(tile), SAMPLES_PER_PIXEL,
+                          framebuffer, sampleCounts, variances);
+  }
+
+  // takes every pixel up to sampleEnd samples, adding the new radiance to
+  // framebuffer: one progressive pass over buffers the caller keeps across
+  // passes (preview.hpp)
+  void renderPass(const Hittable &world, int sampleEnd, Image &framebuffer,
+                  std::vector<int> &sampleCounts,
+                  std::vector<PixelVariance> &variances) {
+    renderTiles(world, sampleEnd, framebuffer, sampleCounts, variances);
+  }
+
+  // writes the finished image (per-pixel averages), denoised if asked, and
+  // the reports
+  void finishRender(const Image &image, const std::vector<int> &sampleCounts) {
+    Image denoised;
+    if (DENOISE) {
+      auto denoiseStart = std::chrono::steady_clock::now();
+      ATrousDenoiser denoiser;
+      denoiser.threads = THREADS;
+      denoised = denoiser.denoise(image, featureBuffers, sampleCounts);
+      stats.denoiseSeconds = secondsSince(denoiseStart);
+      if (LOG_PROGRESS)
+        std::clog << "Denoised in " << stats.denoiseSeconds << " s\n";
+    }
+
+    auto outputStart = std::chrono::steady_clock::now();
+    writeImage(DENOISE ? denoised : image, IMAGE_FORMAT, OUTPUT_PATH);
+    stats.outputSeconds = secondsSince(outputStart);
+    writeFeatures();
+    reportSampling(sampleCounts);
+    reportStats();
+  }
+
+  // everything about the camera that changes which samples a pixel gets.
+  // SAMPLES_PER_PIXEL is left out on purpose: raising it is how a resumed
+  // render adds samples
+  uint64_t cameraFingerprint() const {
+    Fingerprint f;
+    f.add(IMAGE_WIDTH);
+    f.add(IMAGE_HEIGHT);
+    f.add(MAX_DEPTH);
+    f.add(VFOV);
+    f.add(lookfrom);
+    f.add(lookat);
+    f.add(vup);
+    f.add(defocusAngle);
+    f.add(focusDistance);
+    f.add(uint64_t(SEED));
+    f.add(int(SAMPLER));
+    f.add(samplerBlockSize());
+    f.add(int(WAVEFRONT));
+    f.add(SHUTTER);
+    f.add(ROULETTE_DEPTH);
+    f.add(SKY_SCALE);
+    f.add(int(samplesLights() ? LIGHTS->size() : 0));
+    if (ENVIRONMENT) {
+      f.add(ENVIRONMENT->mapWidth());
+      f.add(ENVIRONMENT->mapHeight());
+      f.add(ENVIRONMENT->power());
+      f.add(int(ENVIRONMENT_SAMPLING));
+    }
+    f.add(ADAPTIVE_THRESHOLD);
+    f.add(ADAPTIVE_MIN_SAMPLES);
+    f.add(int(sizeof(Real)));
+    return f.value();
+  }
+
+  // the world has no serialized form to hash, so probe it instead: its
+  // bounds, plus what a grid of camera rays hits and how the material there
+  // scatters (with a fixed random stream). any edit that shows up in the
+  // probes invalidates old checkpoints
+  uint64_t sceneFingerprint(const Hittable &world) const {
+    Fingerprint f;
+    AABB bounds = world.boundingBox();
+    f.add(bounds.x.min);
+    f.add(bounds.x.max);
+    f.add(bounds.y.min);
+    f.add(bounds.y.max);
+    f.add(bounds.z.min);
+    f.add(bounds.z.max);
+
+    const int probes = 32;
+    for (int i = 0; i < probes; ++i) {
+      for (int j = 0; j < probes; ++j) {
+        auto pixel = PIXEL00_LOC + ((j + 0.5) * IMAGE_WIDTH / probes) *
+                                       PIXEL_DELTA_U +
+                     ((i + 0.5) * IMAGE_HEIGHT / probes) * PIXEL_DELTA_V;
+        Ray r(CAMERA_CENTRE, pixel - CAMERA_CENTRE);
+        HitRecord rec;
+        if (!world.hit(r, Interval(0.001, infinity), rec)) {
+          f.add(-1);
+          continue;
         }
-        writeColour(std::cout, PIXEL_SAMPLES_SCALE * pixelColour);
+        f.add(rec.t);
+        f.add(rec.normal);
+
+        seedRandom(0, uint64_t(i * probes + j));
+        Ray scattered;
+        Colour attenuation;
+        f.add(int(rec.mat->scatter(r, rec, attenuation, scattered)));
+        f.add(attenuation);
+        f.add(scattered.direction());
       }
     }
-    std::clog << "\rDone.                 \n";
+    return f.value();
   }
 
 private:
   // these private fields are defined based on initialize()
   int IMAGE_HEIGHT;           // rendered image height
-  double PIXEL_SAMPLES_SCALE; // colour scale factor for sum of pixel samples
   Point3 CAMERA_CENTRE;       // camera centre
   Point3 PIXEL00_LOC;         // location of pixel 0,0
   Vec3 PIXEL_DELTA_U;         // vector to pixel to the right
@@ -59,14 +361,525 @@ private:
                      // w(opposite view direction)
   Vec3 defocusDiskU; // horizontal radius of defocus disk
   Vec3 defocusDiskV; // vertical radius of defocus disk
+  RenderStats stats;
+  FeatureBuffers featureBuffers;
+  std::vector<double> tileSeconds;
+  std::vector<uint64_t> pixelCost; // empty unless a cost map was asked for
+
+  bool isAdaptive() const { return ADAPTIVE_THRESHOLD > 0 && !WAVEFRONT; }
+
+  // adaptive sampling decides per pixel, and the cost map per ray, so
+  // neither mixes with packets
+  bool usesPackets() const {
+    return PACKET_SIZE > 0 && !isAdaptive() && pixelCost.empty();
+  }
+
+  int packetWidth() const { return std::min(PACKET_SIZE, 8); }
+
+  void renderProgressive(const Hittable &world) {
+    RenderCheckpoint state(IMAGE_WIDTH, IMAGE_HEIGHT, cameraFingerprint(),
+                           sceneFingerprint(world));
+    if (!CHECKPOINT_PATH.empty()) {
+      RenderCheckpoint saved;
+      if (saved.load(CHECKPOINT_PATH) && saved.matches(state)) {
+        state = std::move(saved);
+      } else if (saved.width > 0) {
+        std::clog << "Checkpoint " << CHECKPOINT_PATH
+                  << " is for a different camera or scene, starting over\n";
+      }
+    }
+
+    // sample loops work on ints and double-precision variance; the
+    // checkpoint keeps the compact copies
+    std::vector<int> sampleCounts(state.sampleCounts.begin(),
+                                  state.sampleCounts.end());
+    std::vector<PixelVariance> variances(state.pixelCount());
+    int samplesDone = 0;
+    for (size_t i = 0; i < state.pixelCount(); ++i) {
+      variances[i].count = sampleCounts[i];
+      variances[i].mean = state.luminanceMean[i];
+      variances[i].m2 = state.luminanceM2[i];
+      samplesDone = std::max(samplesDone, sampleCounts[i]);
+    }
+    if (samplesDone > 0)
+      std::clog << "Resuming from " << CHECKPOINT_PATH << " at "
+                << samplesDone << " samples per pixel\n";
+
+    Image passSums(IMAGE_WIDTH, IMAGE_HEIGHT);
+    int pass = 0;
+    while (samplesDone < SAMPLES_PER_PIXEL) {
+      samplesDone = std::min(samplesDone + PASS_SAMPLES, SAMPLES_PER_PIXEL);
+      std::clog << "Pass " << ++pass << ", up to " << samplesDone
+                << " samples per pixel\n";
+
+      std::fill(passSums.pixels.begin(), passSums.pixels.end(),
+                Colour(0, 0, 0));
+      renderTiles(world, samplesDone, passSums, sampleCounts, variances);
+
+      for (size_t i = 0; i < state.pixelCount(); ++i) {
+        for (int c = 0; c < 3; ++c)
+          state.radiance[i * 3 + c] += float(passSums.pixels[i][c]);
+        state.sampleCounts[i] = uint32_t(sampleCounts[i]);
+        state.luminanceMean[i] = float(variances[i].mean);
+        state.luminanceM2[i] = float(variances[i].m2);
+      }
+
+      if (!PREVIEW_PATH.empty())
+        writeImage(state.resolve(), IMAGE_FORMAT, PREVIEW_PATH);
+      if (!CHECKPOINT_PATH.empty() &&
+          (pass % std::max(CHECKPOINT_INTERVAL, 1) == 0 ||
+           samplesDone == SAMPLES_PER_PIXEL) &&
+          !state.save(CHECKPOINT_PATH))
+        std::cerr << "could not save checkpoint " << CHECKPOINT_PATH << '\n';
+    }
+
+    finishRender(state.resolve(), sampleCounts);
+  }
+
+  // size of the blocks the sampler stratifies over: one progressive pass, or
+  // the whole render
+  int samplerBlockSize() const {
+    return PASS_SAMPLES > 0 ? PASS_SAMPLES : SAMPLES_PER_PIXEL;
+  }
+
+  void reportSampling(const std::vector<int> &sampleCounts) const {
+    if (isAdaptive()) {
+      double total = 0;
+      for (int count : sampleCounts)
+        total += count;
+      std::clog << "Average samples per pixel: "
+                << total / sampleCounts.size() << " (max "
+                << SAMPLES_PER_PIXEL << ")\n";
+    }
+    if (!HEATMAP_PATH.empty())
+      writeImage(heatmap(sampleCounts, SAMPLES_PER_PIXEL),
+                 ImageFormat::PpmBinary, HEATMAP_PATH);
+  }
+
+  void writeFeatures() const {
+    if (featureBuffers.empty())
+      return;
+    bool eightBit = IMAGE_FORMAT == ImageFormat::PpmAscii ||
+                    IMAGE_FORMAT == ImageFormat::PpmBinary;
+    size_t size = featureBuffers.samples.size();
+    Image image(IMAGE_WIDTH, IMAGE_HEIGHT);
+    if (!ALBEDO_PATH.empty()) {
+      for (size_t i = 0; i < size; ++i)
+        image.pixels[i] = featureBuffers.albedoAt(i);
+      writeImage(image, IMAGE_FORMAT, ALBEDO_PATH);
+    }
+    if (!NORMAL_PATH.empty()) {
+      for (size_t i = 0; i < size; ++i) {
+        Vec3 n = featureBuffers.normalAt(i);
+        image.pixels[i] = eightBit ? Real(0.5) * (n + Vec3(1, 1, 1)) : n;
+      }
+      writeImage(image, IMAGE_FORMAT, NORMAL_PATH);
+    }
+    if (!DEPTH_PATH.empty()) {
+      double maxDepth = 0;
+      for (size_t i = 0; i < size; ++i)
+        maxDepth = std::max(maxDepth, featureBuffers.depthAt(i));
+      double scale = eightBit && maxDepth > 0 ? 1 / maxDepth : 1;
+      for (size_t i = 0; i < size; ++i) {
+        Real d = Real(featureBuffers.depthAt(i) * scale);
+        image.pixels[i] = Colour(d, d, d);
+      }
+      writeImage(image, IMAGE_FORMAT, DEPTH_PATH);
+    }
+  }
+
+  void reportStats() const {
+    if (!STATS_ENABLED)
+      return;
+    if (LOG_PROGRESS) {
+      stats.print(std::clog);
+      auto slowest = std::max_element(tileSeconds.begin(), tileSeconds.end());
+      if (slowest != tileSeconds.end()) {
+        double total = 0;
+        for (double seconds : tileSeconds)
+          total += seconds;
+        Tile tile = tileBounds(int(slowest - tileSeconds.begin()));
+        std::clog << "Tiles: " << tileSeconds.size() << ", mean "
+                  << 1e3 * total / tileSeconds.size() << " ms, slowest "
+                  << 1e3 * *slowest << " ms at pixel row " << tile.m0
+                  << " column " << tile.n0 << '\n';
+      }
+    }
+    if (!COST_MAP_PATH.empty() && !pixelCost.empty()) {
+      // a few pixels (caustics, grazing rays) cost far more than the rest,
+      // so the scale tops out at the 99th percentile rather than the maximum
+      std::vector<uint64_t> sorted = pixelCost;
+      auto p99 = sorted.begin() + sorted.size() * 99 / 100;
+      std::nth_element(sorted.begin(), p99, sorted.end());
+      std::vector<double> clamped(pixelCost.begin(), pixelCost.end());
+      for (double &cost : clamped)
+        cost = std::min(cost, double(*p99));
+      writeImage(heatmap(clamped, double(std::max<uint64_t>(*p99, 1))),
+                 ImageFormat::PpmBinary, COST_MAP_PATH);
+    }
+  }
+
+  // takes every pixel from sampleCounts[pixel] samples up to sampleEnd (or
+  // until adaptive sampling stops it), adding the new samples' radiance to
+  // framebuffer
+  void renderTiles(const Hittable &world, int sampleEnd, Image &framebuffer,
+                   std::vector<int> &sampleCounts,
+                   std::vector<PixelVariance> &variances) {
+    int tileCount = this->tileCount();
+    tileSeconds.resize(size_t(tileCount)); // progressive passes accumulate
+
+    std::mutex progressMutex;
+    int tilesDone = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    parallelFor(tileCount, THREADS, [&](int tile, int) {
+      threadStats() = RenderStats();
+      auto tileStart = STATS_ENABLED ? std::chrono::steady_clock::now()
+                                     : std::chrono::steady_clock::time_point();
+      Tile bounds = tileBounds(tile);
+
+      if (WAVEFRONT)
+        renderTileWavefront(world, bounds, sampleEnd, framebuffer,
+                            sampleCounts);
+      else
+        renderTileRecursive(world, bounds, sampleEnd, framebuffer,
+                            sampleCounts, variances);
+
+      std::lock_guard<std::mutex> lock(progressMutex);
+      stats += threadStats();
+      if (STATS_ENABLED)
+        tileSeconds[tile] += secondsSince(tileStart);
+      ++tilesDone;
+      if (LOG_PROGRESS)
+        std::clog << "\rTiles remaining: " << (tileCount - tilesDone) << ' '
+                  << std::flush;
+    });
+    stats.renderSeconds += secondsSince(start);
+    if (LOG_PROGRESS)
+      std::clog << "\rDone.                 \n";
+  }
+
+  static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  }
+
+  void renderTileRecursive(const Hittable &world, const Tile &tile,
+                           int sampleEnd, Image &framebuffer,
+                           std::vector<int> &sampleCounts,
+                           std::vector<PixelVariance> &variances) {
+    if (usesPackets()) {
+      renderTilePackets(world, tile, sampleEnd, framebuffer, sampleCounts);
+      return;
+    }
+    auto sampler = makeSampler(SAMPLER, SEED, samplerBlockSize());
+    for (int m = tile.m0; m < tile.m1; ++m) {
+      for (int n = tile.n0; n < tile.n1; ++n) {
+        size_t pixel = size_t(m) * IMAGE_WIDTH + n;
+        PixelVariance &variance = variances[pixel];
+        int sample = sampleCounts[pixel];
+        // a pixel that converged in an earlier pass stays finished
+        if (isAdaptive() && sample >= ADAPTIVE_MIN_SAMPLES &&
+            variance.converged(ADAPTIVE_THRESHOLD))
+          continue;
+
+        uint64_t workBefore = STATS_ENABLED ? threadStats().work() : 0;
+        Colour pixelColour(0, 0, 0);
+        while (sample < sampleEnd) {
+          seedPathRandom(m * IMAGE_WIDTH + n, sample, 0);
+          Ray r = getRay(m, n, sample, *sampler);
+          RT_STAT(primaryRays, 1);
+          Colour sampleColour;
+          if (featureBuffers.empty()) {
+            sampleColour = rayColour(r, MAX_DEPTH, world);
+          } else {
+            PathFeatures features;
+            sampleColour =
+                rayColour(r, MAX_DEPTH, world, Colour(1, 1, 1), &features);
+            featureBuffers.add(pixel, features.albedo, features.normal,
+                               features.depth);
+          }
+          pixelColour += sampleColour;
+          ++sample;
+
+          if (isAdaptive()) {
+            variance.add(luminance(sampleColour));
+            // only test every few samples, the interval barely moves in one
+            if (sample >= ADAPTIVE_MIN_SAMPLES && sample % 8 == 0 &&
+                variance.converged(ADAPTIVE_THRESHOLD))
+              break;
+          }
+        }
+        framebuffer.at(m, n) += pixelColour;
+        sampleCounts[pixel] = sample;
+        if (STATS_ENABLED && !pixelCost.empty())
+          pixelCost[pixel] += threadStats().work() - workBefore;
+      }
+    }
+  }
+
+  // renderTileRecursive with the camera rays traced as packets: the tile is
+  // cut into blocks of packetWidth() pixels square, and each sample of a
+  // block sends all its camera rays through the scene at once. every path
+  // then carries on from its first hit alone, drawing the same random
+  // numbers it would have, so the image doesn't change
+  void renderTilePackets(const Hittable &world, const Tile &tile,
+                         int sampleEnd, Image &framebuffer,
+                         std::vector<int> &sampleCounts) {
+    auto sampler = makeSampler(SAMPLER, SEED, samplerBlockSize());
+    int width = packetWidth();
+    RayPacket packet;
+    int pixels[RayPacket::MAX_SIZE];
+    Colour sums[RayPacket::MAX_SIZE];
+    for (int m0 = tile.m0; m0 < tile.m1; m0 += width) {
+      for (int n0 = tile.n0; n0 < tile.n1; n0 += width) {
+        int m1 = std::min(m0 + width, tile.m1);
+        int n1 = std::min(n0 + width, tile.n1);
+        int firstSample = sampleEnd;
+        for (int m = m0; m < m1; ++m)
+          for (int n = n0; n < n1; ++n)
+            firstSample =
+                std::min(firstSample, sampleCounts[m * IMAGE_WIDTH + n]);
+        std::fill(sums, sums + RayPacket::MAX_SIZE, Colour(0, 0, 0));
+
+        for (int sample = firstSample; sample < sampleEnd; ++sample) {
+          // a pixel resumed from a checkpoint may already have this sample
+          packet.clear();
+          for (int m = m0; m < m1; ++m) {
+            for (int n = n0; n < n1; ++n) {
+              int pixel = m * IMAGE_WIDTH + n;
+              if (sample < sampleCounts[pixel])
+                continue;
+              pixels[packet.size] = pixel;
+              packet.add(getRay(m, n, sample, *sampler));
+            }
+          }
+          RT_STAT(primaryRays, packet.size);
+          packet.close();
+          world.hitPacket(packet, packet.allRays());
+
+          for (int i = 0; i < packet.size; ++i) {
+            seedPathRandom(pixels[i], sample, 0);
+            int slot = (pixels[i] / IMAGE_WIDTH - m0) * width +
+                       pixels[i] % IMAGE_WIDTH - n0;
+            if (featureBuffers.empty()) {
+              sums[slot] += shade(packet.rays[i], packet.hits[i],
+                                  packet.recs[i], MAX_DEPTH, world,
+                                  Colour(1, 1, 1), nullptr, 0);
+            } else {
+              PathFeatures features;
+              sums[slot] += shade(packet.rays[i], packet.hits[i],
+                                  packet.recs[i], MAX_DEPTH, world,
+                                  Colour(1, 1, 1), &features, 0);
+              featureBuffers.add(size_t(pixels[i]), features.albedo,
+                                 features.normal, features.depth);
+            }
+          }
+        }
+
+        for (int m = m0; m < m1; ++m) {
+          for (int n = n0; n < n1; ++n) {
+            framebuffer.at(m, n) += sums[(m - m0) * width + n - n0];
+            int &count = sampleCounts[m * IMAGE_WIDTH + n];
+            count = std::max(count, sampleEnd);
+          }
+        }
+      }
+    }
+  }
+
+  static double luminance(const Colour &c) {
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+  }
+
+  // one value per pixel, blue at 0 to red at maxValue
+  template <typename T>
+  Image heatmap(const std::vector<T> &values, double maxValue) const {
+    Image image(IMAGE_WIDTH, IMAGE_HEIGHT);
+    for (size_t i = 0; i < values.size(); ++i) {
+      double t = double(values[i]) / maxValue;
+      image.pixels[i] = Colour(t, 0.1, 1 - t);
+    }
+    return image;
+  }
+
+  // one in-flight path of the wavefront integrator
+  struct PathState {
+    Ray ray;
+    Colour throughput; // product of the attenuations so far
+    int pixel;         // framebuffer index the path contributes to
+    int sample;        // which of the pixel's samples this is
+    double scatterPdf; // density the ray was scattered with (see emission)
+  };
+
+  // iterative alternative to rayColour: every sample of the tile is generated
+  // up front, then each bounce intersects the whole queue, groups the hits by
+  // material type so scatter() runs over one material at a time, and compacts
+  // the surviving paths for the next bounce
+  void renderTileWavefront(const Hittable &world, const Tile &tile,
+                           int sampleEnd, Image &framebuffer,
+                           std::vector<int> &sampleCounts) {
+    std::vector<PathState> paths;
+    // kept alongside paths (and compacted with them) only while collecting
+    // features; each path adds to the buffers once its features settle
+    std::vector<PathFeatures> features, featureSurvivors;
+    bool collect = !featureBuffers.empty();
+    auto settle = [&](size_t i) {
+      featureBuffers.add(size_t(paths[i].pixel), features[i].albedo,
+                         features[i].normal, features[i].depth);
+      features[i].following = false;
+    };
+    auto sampler = makeSampler(SAMPLER, SEED, samplerBlockSize());
+    for (int m = tile.m0; m < tile.m1; ++m) {
+      for (int n = tile.n0; n < tile.n1; ++n) {
+        int pixel = m * IMAGE_WIDTH + n;
+        for (int sample = sampleCounts[pixel]; sample < sampleEnd; ++sample)
+          paths.push_back(PathState{getRay(m, n, sample, *sampler),
+                                    Colour(1, 1, 1), pixel, sample, 0});
+        RT_STAT(primaryRays, std::max(sampleEnd - sampleCounts[pixel], 0));
+        sampleCounts[pixel] = std::max(sampleCounts[pixel], sampleEnd);
+      }
+    }
+    if (collect)
+      features.resize(paths.size());
+
+    std::vector<HitRecord> hits;
+    std::vector<char> firstHits; // hit or not, when traced as packets
+    std::vector<std::type_index> materialTypes;
+    std::vector<std::vector<size_t>> byMaterial;
+    std::vector<PathState> survivors;
+
+    for (int depth = MAX_DEPTH; depth > 0 && !paths.empty(); --depth) {
+      // intersect the whole queue; misses pick up the sky and leave
+      hits.resize(paths.size());
+      for (auto &bucket : byMaterial)
+        bucket.clear();
+      // the camera rays are queued pixel by pixel, so neighbours in the
+      // queue make coherent packets
+      firstHits.clear();
+      if (depth == MAX_DEPTH && usesPackets())
+        tracePackets(world, paths, hits, firstHits);
+
+      for (size_t i = 0; i < paths.size(); ++i) {
+        uint64_t workBefore = STATS_ENABLED ? threadStats().work() : 0;
+        bool hit = firstHits.empty()
+                       ? world.hit(paths[i].ray, Interval(0.001, infinity),
+                                   hits[i])
+                       : firstHits[i] != 0;
+        if (STATS_ENABLED && !pixelCost.empty())
+          pixelCost[paths[i].pixel] += threadStats().work() - workBefore;
+        if (collect && features[i].following) {
+          if (hit)
+            features[i].hit(paths[i].ray, hits[i]);
+          else
+            features[i].miss(background(paths[i].ray));
+          if (!features[i].following)
+            settle(i);
+        }
+        if (!hit) {
+          RT_STAT(escapedPaths, 1);
+          framebuffer.pixels[paths[i].pixel] +=
+              paths[i].throughput *
+              skyLight(paths[i].ray, paths[i].scatterPdf);
+          continue;
+        }
+        framebuffer.pixels[paths[i].pixel] +=
+            paths[i].throughput *
+            emission(paths[i].ray, hits[i], paths[i].scatterPdf);
+
+        // there are only a handful of material types, so a linear lookup
+        // beats hashing
+        std::type_index type(typeid(*hits[i].mat));
+        size_t bucket = 0;
+        while (bucket < materialTypes.size() && materialTypes[bucket] != type)
+          ++bucket;
+        if (bucket == materialTypes.size()) {
+          materialTypes.push_back(type);
+          byMaterial.emplace_back();
+        }
+        byMaterial[bucket].push_back(i);
+      }
+
+      // scatter one material type at a time, keeping only paths that survive
+      survivors.clear();
+      featureSurvivors.clear();
+      for (const auto &bucket : byMaterial) {
+        for (size_t i : bucket) {
+          // paths are reordered every bounce, so each scatter draws from a
+          // stream keyed by its own (pixel, sample, bounce)
+          seedPathRandom(paths[i].pixel, paths[i].sample, MAX_DEPTH - depth);
+          if (samplesDirect() && dispatch::samplesLights(*hits[i].mat))
+            framebuffer.pixels[paths[i].pixel] +=
+                paths[i].throughput *
+                directLight(paths[i].ray, hits[i], world);
+          Ray scattered;
+          Colour attenuation;
+          if (dispatch::scatter(*hits[i].mat, paths[i].ray, hits[i],
+                                attenuation, scattered)) {
+            Colour throughput = paths[i].throughput * attenuation;
+            double survival = roulette(MAX_DEPTH - depth, throughput);
+            if (survival == 0) {
+              RT_STAT(roulettePaths, 1);
+              if (collect && features[i].following)
+                settle(i);
+              continue;
+            }
+            if (survival < 1)
+              throughput = throughput / Real(survival);
+            RT_STAT(secondaryRays, 1);
+            survivors.push_back(PathState{
+                scattered, throughput, paths[i].pixel, paths[i].sample,
+                nextScatterPdf(hits[i], scattered)});
+            if (collect) {
+              features[i].tint = features[i].tint * attenuation;
+              featureSurvivors.push_back(features[i]);
+            }
+          } else {
+            RT_STAT(absorbedPaths, 1);
+            if (collect && features[i].following)
+              settle(i);
+          }
+        }
+      }
+      std::swap(paths, survivors);
+      std::swap(features, featureSurvivors);
+    }
+    for (size_t i = 0; collect && i < paths.size(); ++i)
+      if (features[i].following)
+        settle(i);
+    // paths still alive at MAX_DEPTH gather no more light, like rayColour
+    RT_STAT(maxDepthPaths, paths.size());
+  }
+
+  // traces the queue's rays packetWidth()^2 at a time, filling in hits and
+  // whether each ray hit anything
+  void tracePackets(const Hittable &world, const std::vector<PathState> &paths,
+                    std::vector<HitRecord> &hits,
+                    std::vector<char> &hit) const {
+    size_t size = size_t(packetWidth() * packetWidth());
+    hit.resize(paths.size());
+    RayPacket packet;
+    for (size_t start = 0; start < paths.size(); start += size) {
+      size_t end = std::min(start + size, paths.size());
+      packet.clear();
+      for (size_t i = start; i < end; ++i)
+        packet.add(paths[i].ray);
+      packet.close();
+      world.hitPacket(packet, packet.allRays());
+      for (size_t i = start; i < end; ++i) {
+        hit[i] = packet.hits[i - start];
+        if (hit[i])
+          hits[i] = packet.recs[i - start];
+      }
+    }
+  }
 
   void initialize() {
     // calculate the image height with min val = 1
     IMAGE_HEIGHT = int(IMAGE_WIDTH / ASPECT_RATIO);
     IMAGE_HEIGHT = (IMAGE_HEIGHT < 1) ? 1 : IMAGE_HEIGHT;
 
-    PIXEL_SAMPLES_SCALE = 1.0 / SAMPLES_PER_PIXEL;
-
     CAMERA_CENTRE = lookfrom;
 
     // determine viewport dimensions
@@ -113,52 +926,268 @@ private:
     defocusDiskV = v * defocusRadius;
   }
 
-  Ray getRay(int m, int n) const {
-    // make a ray from defocus disk to a random sample in the region of pixel
+  // seeds the thread's random generator for everything a path does after its
+  // camera ray. keyed by pixel and sample (not by tile or thread), so the
+  // image doesn't depend on how the work was split up
+  void seedPathRandom(int pixel, int sample, int bounce) const {
+    seedRandom(SEED, mixBits((uint64_t(pixel) << 32) | uint32_t(sample)) +
+                         uint64_t(bounce));
+  }
+
+  Ray getRay(int m, int n, int sample, Sampler &sampler) const {
+    // make a ray from defocus disk to a sampled point in the region of pixel
     // (i,j)
-    auto offset = sampleSquare();
+    sampler.startPixelSample(uint64_t(m) * IMAGE_WIDTH + n, sample);
+    auto offset = sampleSquare(sampler);
     auto pixelSample = PIXEL00_LOC + (n + offset.x()) * PIXEL_DELTA_U +
                        (m + offset.y()) * PIXEL_DELTA_V;
 
-    auto rayOrigin = (defocusAngle <= 0) ? CAMERA_CENTRE : defocusDiskSample();
+    auto rayOrigin =
+        (defocusAngle <= 0) ? CAMERA_CENTRE : defocusDiskSample(sampler);
     auto rayDirection = pixelSample - rayOrigin;
 
-    return Ray(rayOrigin, rayDirection);
+    // the time dimension comes last so a still render's samples don't move
+    Real rayTime = SHUTTER > 0 ? Real(sampler.get1D()) : 0;
+    return Ray(rayOrigin, rayDirection, rayTime);
   }
 
-  Vec3 sampleSquare() const {
-    // returns a vector to a random point in the unit square with the centre at
-    // the origin
-    return Vec3(randomDouble() - 0.5, randomDouble() - 0.5, 0);
+  Vec3 sampleSquare(Sampler &sampler) const {
+    // returns a vector to a sampled point in the unit square with the centre
+    // at the origin
+    return sampler.get2D() - Vec3(0.5, 0.5, 0);
   }
 
-  Point3 defocusDiskSample() const {
-    auto p = randomInUnitDisk();
+  Point3 defocusDiskSample(Sampler &sampler) const {
+    auto u = sampler.get2D();
+    auto p = mapToUnitDisk(u[0], u[1]);
     return CAMERA_CENTRE + (p[0] * defocusDiskU) + (p[1] * defocusDiskV);
   }
 
-  Colour rayColour(const Ray &r, int depth, const Hittable &world) const {
+  // what a camera ray shows, for the feature buffers: the depth of its first
+  // hit, and the albedo and normal of the first rough surface along it.
+  // mirrors and glass are looked through, tinted by what they pass on, so
+  // the denoiser keeps the edges of what they reflect instead of smearing
+  // them. a miss sees the sky, at no particular distance
+  struct PathFeatures {
+    Colour albedo{0, 0, 0};
+    Vec3 normal{0, 0, 0};
+    double depth = 0;
+    Colour tint{1, 1, 1}; // product of the specular attenuations so far
+    bool following = true; // still going through specular surfaces
+    bool hitAny = false;
+
+    void hit(const Ray &r, const HitRecord &rec) {
+      if (!hitAny)
+        depth = double(rec.t * r.direction().length());
+      hitAny = true;
+      albedo = tint * rec.mat->surfaceAlbedo();
+      normal = rec.normal;
+      following = rec.mat->isSpecular();
+    }
+
+    void miss(const Colour &sky) {
+      albedo = tint * sky;
+      following = false;
+    }
+  };
+
+  // Russian roulette for a path about to carry throughput on from its
+  // bounce'th scatter (0 = where the camera ray hit). returns the chance it
+  // survived with, to divide its weight by, or 0 if it ends here
+  double roulette(int bounce, const Colour &throughput) const {
+    if (ROULETTE_DEPTH <= 0 || bounce < ROULETTE_DEPTH)
+      return 1;
+    Real brightest = std::max({throughput.x(), throughput.y(), throughput.z()});
+    double survival = std::min(1.0, double(brightest));
+    if (survival >= 1)
+      return 1;
+    return randomDouble() < survival ? survival : 0;
+  }
+
+  bool samplesLights() const { return LIGHTS && !LIGHTS->empty(); }
+
+  bool samplesEnvironment() const {
+    return ENVIRONMENT && !ENVIRONMENT->empty() &&
+           ENVIRONMENT_SAMPLING != EnvironmentSampling::Off;
+  }
+
+  // whether diffuse hits send shadow rays at all
+  bool samplesDirect() const {
+    return samplesLights() || samplesEnvironment();
+  }
+
+  static double powerHeuristic(double pdf, double otherPdf) {
+    return pdf * pdf / (pdf * pdf + otherPdf * otherPdf);
+  }
+
+  // the density the next bounce's emission() is told scattered came with: 0
+  // where no light was sampled at rec, so whatever it hits counts in full
+  double nextScatterPdf(const HitRecord &rec, const Ray &scattered) const {
+    if (!samplesDirect() || !dispatch::samplesLights(*rec.mat))
+      return 0;
+    return dispatch::scatterPdf(*rec.mat, rec,
+                                unitVector(scattered.direction()));
+  }
+
+  // light rec's surface sends back along r. scatterPdf is the density the
+  // previous bounce picked r's direction with, 0 for camera rays and
+  // specular bounces; otherwise the previous bounce also sampled the lights
+  // directly (directLight), and this estimate gets the share the power
+  // heuristic gives it
+  Colour emission(const Ray &r, const HitRecord &rec,
+                  double scatterPdf) const {
+    Colour emitted = dispatch::emitted(*rec.mat, rec);
+    if (scatterPdf <= 0 || !samplesLights())
+      return emitted;
+    double lightPdf = LIGHTS->pdf(r, rec.t);
+    return Real(powerHeuristic(scatterPdf, lightPdf)) * emitted;
+  }
+
+  // the same for a ray that escapes: the sky, weighted against the
+  // environment's shadow rays
+  Colour skyLight(const Ray &r, double scatterPdf) const {
+    Colour sky = background(r);
+    if (scatterPdf <= 0 || !samplesEnvironment())
+      return sky;
+    double environmentPdf = ENVIRONMENT->pdf(unitVector(r.direction()),
+                                             ENVIRONMENT_SAMPLING);
+    return Real(powerHeuristic(scatterPdf, environmentPdf)) * sky;
+  }
+
+  // next-event estimation at rec: light from a point sampled on one of the
+  // LIGHTS and from a direction sampled on the ENVIRONMENT, where nothing is
+  // in the way, each with the power heuristic's share
+  Colour directLight(const Ray &r, const HitRecord &rec,
+                     const Hittable &world) const {
+    Colour light(0, 0, 0);
+    if (samplesLights())
+      light += lightSample(r, rec, world);
+    if (samplesEnvironment())
+      light += environmentSample(r, rec, world);
+    return light;
+  }
+
+  Colour lightSample(const Ray &r, const HitRecord &rec,
+                     const Hittable &world) const {
+    double u0 = randomDouble();
+    double u1 = randomDouble();
+    double u2 = randomDouble();
+    Vec3 direction;
+    HitRecord at;
+    double lightPdf;
+    if (!LIGHTS->sample(rec.p, u0, u1, u2, direction, at, lightPdf))
+      return Colour(0, 0, 0);
+    Real cosine = dot(rec.normal, direction);
+    if (cosine <= 0)
+      return Colour(0, 0, 0);
+    RT_STAT(shadowRays, 1);
+    // stop just short of the light, which would otherwise occlude itself
+    if (world.occluded(Ray(rec.p, direction, r.time()),
+                       Interval(0.001, at.t * Real(1 - 1e-4))))
+      return Colour(0, 0, 0);
+    double weight = powerHeuristic(
+        lightPdf, dispatch::scatterPdf(*rec.mat, rec, direction));
+    return Real(weight / lightPdf) * cosine *
+           dispatch::brdf(*rec.mat, rec, direction) *
+           dispatch::emitted(*at.mat, at);
+  }
+
+  Colour environmentSample(const Ray &r, const HitRecord &rec,
+                           const Hittable &world) const {
+    double u0 = randomDouble();
+    double u1 = randomDouble();
+    Vec3 direction;
+    double environmentPdf;
+    if (!ENVIRONMENT->sample(u0, u1, ENVIRONMENT_SAMPLING, direction,
+                             environmentPdf))
+      return Colour(0, 0, 0);
+    Real cosine = dot(rec.normal, direction);
+    if (cosine <= 0)
+      return Colour(0, 0, 0);
+    RT_STAT(shadowRays, 1);
+    Ray shadow(rec.p, direction, r.time());
+    if (world.occluded(shadow, Interval(0.001, infinity)))
+      return Colour(0, 0, 0);
+    double weight = powerHeuristic(
+        environmentPdf, dispatch::scatterPdf(*rec.mat, rec, direction));
+    return Real(weight / environmentPdf) * cosine *
+           dispatch::brdf(*rec.mat, rec, direction) * background(shadow);
+  }
+
+  // throughput is the product of the attenuations (and roulette weights)
+  // that light coming back along r will be scaled by. features, if given, is
+  // filled in along the ray's path (see PathFeatures). scatterPdf is the
+  // density r was scattered with (see emission)
+  Colour rayColour(const Ray &r, int depth, const Hittable &world,
+                   const Colour &throughput = Colour(1, 1, 1),
+                   PathFeatures *features = nullptr,
+                   double scatterPdf = 0) const {
     // if we hit the max depth, no more light will be gathered
     if (depth <= 0) {
+      RT_STAT(maxDepthPaths, 1);
       return Colour(0, 0, 0);
     }
 
     HitRecord rec;
-    if (world.hit(r, Interval(0.001, infinity), rec)) {
+    bool hit = world.hit(r, Interval(0.001, infinity), rec);
+    return shade(r, hit, rec, depth, world, throughput, features, scatterPdf);
+  }
+
+  // the rest of rayColour once r has been traced: rec is its closest hit, if
+  // it hit anything. packets of camera rays (see renderTilePackets) start
+  // here with the hits they found together
+  Colour shade(const Ray &r, bool hit, const HitRecord &rec, int depth,
+               const Hittable &world, const Colour &throughput,
+               PathFeatures *features, double scatterPdf) const {
+    if (hit) {
+      if (features)
+        features->hit(r, rec);
+      Colour light = emission(r, rec, scatterPdf);
+      if (samplesDirect() && dispatch::samplesLights(*rec.mat))
+        light += directLight(r, rec, world);
       Ray scattered;
       Colour attenuation;
-      if (rec.mat->scatter(r, rec, attenuation, scattered))
-        return attenuation * rayColour(scattered, depth - 1, world);
-      else {
-        return Colour(0, 0, 0); // otherwise the ray is completely absorbed
+      if (dispatch::scatter(*rec.mat, r, rec, attenuation, scattered)) {
+        double survival =
+            roulette(MAX_DEPTH - depth, throughput * attenuation);
+        if (survival == 0) {
+          RT_STAT(roulettePaths, 1);
+          return light;
+        }
+        if (survival < 1)
+          attenuation = attenuation / Real(survival);
+        RT_STAT(secondaryRays, 1);
+        PathFeatures *next = nullptr;
+        if (features && features->following) {
+          features->tint = features->tint * attenuation;
+          next = features;
+        }
+        return light + attenuation * rayColour(scattered, depth - 1, world,
+                                               throughput * attenuation, next,
+                                               nextScatterPdf(rec, scattered));
+      } else {
+        RT_STAT(absorbedPaths, 1);
+        return light; // otherwise the ray is completely absorbed
       }
     }
 
+    RT_STAT(escapedPaths, 1);
+    if (features)
+      features->miss(background(r));
+    return skyLight(r, scatterPdf);
+  }
+
+  // light arriving along a ray that escapes the scene
+  Colour background(const Ray &r) const {
     Vec3 unitDirection = unitVector(r.direction());
+    if (ENVIRONMENT)
+      return Real(SKY_SCALE) * ENVIRONMENT->lookup(unitDirection);
     auto alpha = 0.5 * (unitDirection.y() + 1.0); // puts alpha between 0 and 1
-    return (1.0 - alpha) * Colour(1.0, 1.0, 1.0) +
-           alpha * Colour(0.5, 0.7,
-                          1.0); // linear interpolation between blue and white
+    Colour sky = (1.0 - alpha) * Colour(1.0, 1.0, 1.0) +
+                 alpha * Colour(0.5, 0.7,
+                                1.0); // linear interpolation between blue and
+                                      // white
+    return Real(SKY_SCALE) * sky;
   }
 };
 
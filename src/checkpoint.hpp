@@ -0,0 +1,198 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include "rtweekend.hpp"
+
+#include "image.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// order-dependent 64-bit hash of a sequence of values, used to tell whether a
+// checkpoint was made with the same camera and scene
+class Fingerprint {
+public:
+  void add(uint64_t v) { h = mixBits(h ^ mixBits(v)); }
+
+  void add(double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    add(bits);
+  }
+
+  void add(float v) { add(double(v)); }
+  void add(int v) { add(uint64_t(int64_t(v))); }
+
+  template <typename T> void add(const Vec3T<T> &v) {
+    add(v.x());
+    add(v.y());
+    add(v.z());
+  }
+
+  uint64_t value() const { return h; }
+
+private:
+  uint64_t h = 0x6a09e667f3bcc908;
+};
+
+// everything a progressive render needs to pick up where it left off:
+//   "RTCK" | u32 version (1) | u32 width | u32 height | u64 camera hash |
+//   u64 scene hash | per pixel: f32 r, g, b radiance sums, u32 sample count,
+//   f32 luminance mean, f32 luminance M2 (adaptive sampling state)
+// all little-endian. there's no random generator state to save: path random
+// numbers are keyed by (seed, pixel, sample, bounce) and the seed is part of
+// the camera hash, so the sample counts say where every pixel's sequence
+// resumes
+class RenderCheckpoint {
+public:
+  int width = 0;
+  int height = 0;
+  uint64_t cameraHash = 0;
+  uint64_t sceneHash = 0;
+  std::vector<float> radiance; // 3 floats per pixel, summed over samples
+  std::vector<uint32_t> sampleCounts;
+  std::vector<float> luminanceMean;
+  std::vector<float> luminanceM2;
+
+  RenderCheckpoint() {}
+  RenderCheckpoint(int width, int height, uint64_t cameraHash,
+                   uint64_t sceneHash)
+      : width{width}, height{height}, cameraHash{cameraHash},
+        sceneHash{sceneHash}, radiance(size_t(width) * height * 3),
+        sampleCounts(size_t(width) * height),
+        luminanceMean(size_t(width) * height),
+        luminanceM2(size_t(width) * height) {}
+
+  size_t pixelCount() const { return sampleCounts.size(); }
+
+  // true if other was rendered with the same image size, camera and scene
+  bool matches(const RenderCheckpoint &other) const {
+    return width == other.width && height == other.height &&
+           cameraHash == other.cameraHash && sceneHash == other.sceneHash;
+  }
+
+  // average radiance per pixel (black where nothing was sampled yet)
+  Image resolve() const {
+    Image image(width, height);
+    for (size_t i = 0; i < pixelCount(); ++i) {
+      if (sampleCounts[i] == 0)
+        continue;
+      image.pixels[i] = Colour(radiance[i * 3], radiance[i * 3 + 1],
+                               radiance[i * 3 + 2]) /
+                        Real(sampleCounts[i]);
+    }
+    return image;
+  }
+
+  // written to a temporary file first and renamed over path, so a render
+  // killed mid-save still leaves the previous checkpoint intact
+  bool save(const std::string &path) const {
+    std::string buffer = "RTCK";
+    appendUint32(buffer, VERSION);
+    appendUint32(buffer, uint32_t(width));
+    appendUint32(buffer, uint32_t(height));
+    appendUint64(buffer, cameraHash);
+    appendUint64(buffer, sceneHash);
+    buffer.reserve(buffer.size() + pixelCount() * 6 * 4);
+    for (size_t i = 0; i < pixelCount(); ++i) {
+      appendFloat(buffer, radiance[i * 3]);
+      appendFloat(buffer, radiance[i * 3 + 1]);
+      appendFloat(buffer, radiance[i * 3 + 2]);
+      appendUint32(buffer, sampleCounts[i]);
+      appendFloat(buffer, luminanceMean[i]);
+      appendFloat(buffer, luminanceM2[i]);
+    }
+
+    std::string tmpPath = path + ".tmp";
+    {
+      std::ofstream file(tmpPath, std::ios::binary);
+      if (!file) {
+        std::cerr << "could not open " << tmpPath << " for writing\n";
+        return false;
+      }
+      file.write(buffer.data(), std::streamsize(buffer.size()));
+      if (!file)
+        return false;
+    }
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+  }
+
+  // false if path is missing, truncated or not a checkpoint
+  bool load(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+      return false;
+    std::string buffer((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+
+    size_t pos = 4;
+    if (buffer.size() < HEADER_SIZE || buffer.compare(0, 4, "RTCK") != 0 ||
+        readUint32(buffer, pos) != VERSION)
+      return false;
+    int w = int(readUint32(buffer, pos));
+    int h = int(readUint32(buffer, pos));
+    if (buffer.size() != HEADER_SIZE + size_t(w) * h * 6 * 4)
+      return false;
+
+    uint64_t camera = readUint64(buffer, pos);
+    uint64_t scene = readUint64(buffer, pos);
+    *this = RenderCheckpoint(w, h, camera, scene);
+    for (size_t i = 0; i < pixelCount(); ++i) {
+      radiance[i * 3] = readFloat(buffer, pos);
+      radiance[i * 3 + 1] = readFloat(buffer, pos);
+      radiance[i * 3 + 2] = readFloat(buffer, pos);
+      sampleCounts[i] = readUint32(buffer, pos);
+      luminanceMean[i] = readFloat(buffer, pos);
+      luminanceM2[i] = readFloat(buffer, pos);
+    }
+    return true;
+  }
+
+private:
+  static const uint32_t VERSION = 1;
+  static const size_t HEADER_SIZE = 4 + 3 * 4 + 2 * 8;
+
+  static void appendUint32(std::string &buffer, uint32_t v) {
+    for (int i = 0; i < 4; ++i)
+      buffer.push_back(char((v >> (8 * i)) & 0xff));
+  }
+
+  static void appendUint64(std::string &buffer, uint64_t v) {
+    appendUint32(buffer, uint32_t(v));
+    appendUint32(buffer, uint32_t(v >> 32));
+  }
+
+  static void appendFloat(std::string &buffer, float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    appendUint32(buffer, bits);
+  }
+
+  static uint32_t readUint32(const std::string &buffer, size_t &pos) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i)
+      v |= uint32_t(uint8_t(buffer[pos + i])) << (8 * i);
+    pos += 4;
+    return v;
+  }
+
+  static uint64_t readUint64(const std::string &buffer, size_t &pos) {
+    uint64_t lo = readUint32(buffer, pos);
+    uint64_t hi = readUint32(buffer, pos);
+    return lo | (hi << 32);
+  }
+
+  static float readFloat(const std::string &buffer, size_t &pos) {
+    uint32_t bits = readUint32(buffer, pos);
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+  }
+};
+
+#endif
@@ -14,7 +14,8 @@ inline double linearToGamma(double linearComponent) {
   return 0;
 }
 
-void writeColour(std::ostream &out, const Colour &pixelColour) {
+// gamma corrected 8-bit rgb, as stored in PPM files
+inline void colourToBytes(const Colour &pixelColour, unsigned char rgb[3]) {
   auto r = pixelColour.x();
   auto g = pixelColour.y();
   auto b = pixelColour.z();
@@ -26,12 +27,17 @@ void writeColour(std::ostream &out, const Colour &pixelColour) {
 
   // translate values from [0,1] -> [0,255]
   static const Interval intensity(0.000, 0.999);
-  int rbyte = int(255.999 * intensity.clamp(r));
-  int gbyte = int(255.999 * intensity.clamp(g));
-  int bbyte = int(255.999 * intensity.clamp(b));
+  rgb[0] = (unsigned char)(255.999 * intensity.clamp(r));
+  rgb[1] = (unsigned char)(255.999 * intensity.clamp(g));
+  rgb[2] = (unsigned char)(255.999 * intensity.clamp(b));
+}
+
+void writeColour(std::ostream &out, const Colour &pixelColour) {
+  unsigned char rgb[3];
+  colourToBytes(pixelColour, rgb);
 
   // write out the components as defined in PPM format
-  out << rbyte << ' ' << gbyte << ' ' << bbyte << '\n';
+  out << int(rgb[0]) << ' ' << int(rgb[1]) << ' ' << int(rgb[2]) << '\n';
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,333 @@
+#ifndef DENOISE_HPP
+#define DENOISE_HPP
+
+#include "rtweekend.hpp"
+
+#include "image.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// the filter kernel is picked at build time like the SphereSet one (see
+// RT_SIMD in CMakeLists.txt): eight or four pixels at a time, or one
+#if !defined(RT_SIMD_SCALAR) && defined(__AVX2__)
+#include <immintrin.h>
+#define DENOISE_AVX2
+#elif !defined(RT_SIMD_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define DENOISE_SSE2
+#endif
+
+// what a pixel's camera rays saw, summed over its samples: the albedo and
+// world-space normal of the first rough surface (looking through mirrors and
+// glass, see Camera::PathFeatures) and the distance to the first hit. rays
+// that escape count the sky as their albedo, with a zero normal and
+// distance. these are the auxiliary outputs (AOVs) the denoiser is guided by
+class FeatureBuffers {
+public:
+  Image albedo;
+  Image normal;
+  std::vector<double> depth;
+  std::vector<int> samples;
+
+  void reset(int width, int height) {
+    albedo = Image(width, height);
+    normal = Image(width, height);
+    depth.assign(albedo.pixels.size(), 0);
+    samples.assign(albedo.pixels.size(), 0);
+  }
+
+  bool empty() const { return samples.empty(); }
+
+  void add(size_t pixel, const Colour &a, const Vec3 &n, double d) {
+    albedo.pixels[pixel] += a;
+    normal.pixels[pixel] += n;
+    depth[pixel] += d;
+    ++samples[pixel];
+  }
+
+  // the same pixel set to one already averaged sample, as a farm worker
+  // sends it
+  void set(size_t pixel, const Colour &a, const Vec3 &n, double d) {
+    albedo.pixels[pixel] = a;
+    normal.pixels[pixel] = n;
+    depth[pixel] = d;
+    samples[pixel] = 1;
+  }
+
+  Colour albedoAt(size_t pixel) const {
+    return albedo.pixels[pixel] / std::max(samples[pixel], 1);
+  }
+  Vec3 normalAt(size_t pixel) const {
+    return normal.pixels[pixel] / std::max(samples[pixel], 1);
+  }
+  double depthAt(size_t pixel) const {
+    return depth[pixel] / std::max(samples[pixel], 1);
+  }
+};
+
+namespace denoise {
+
+// a few floats processed side by side, with just the operations the filter
+// needs. Lanes1 is the plain scalar version every build has
+struct Lanes1 {
+  static const int N = 1;
+  float v;
+
+  Lanes1(float x) : v{x} {}
+  static Lanes1 load(const float *p) { return Lanes1(*p); }
+  void store(float *p) const { *p = v; }
+
+  friend Lanes1 operator+(Lanes1 a, Lanes1 b) { return a.v + b.v; }
+  friend Lanes1 operator-(Lanes1 a, Lanes1 b) { return a.v - b.v; }
+  friend Lanes1 operator*(Lanes1 a, Lanes1 b) { return a.v * b.v; }
+  friend Lanes1 operator/(Lanes1 a, Lanes1 b) { return a.v / b.v; }
+  friend Lanes1 max(Lanes1 a, Lanes1 b) { return a.v > b.v ? a.v : b.v; }
+  friend Lanes1 abs(Lanes1 a) { return std::fabs(a.v); }
+};
+
+#if defined(DENOISE_AVX2)
+struct Lanes8 {
+  static const int N = 8;
+  __m256 v;
+
+  Lanes8(__m256 x) : v{x} {}
+  Lanes8(float x) : v{_mm256_set1_ps(x)} {}
+  static Lanes8 load(const float *p) { return _mm256_loadu_ps(p); }
+  void store(float *p) const { _mm256_storeu_ps(p, v); }
+
+  friend Lanes8 operator+(Lanes8 a, Lanes8 b) {
+    return _mm256_add_ps(a.v, b.v);
+  }
+  friend Lanes8 operator-(Lanes8 a, Lanes8 b) {
+    return _mm256_sub_ps(a.v, b.v);
+  }
+  friend Lanes8 operator*(Lanes8 a, Lanes8 b) {
+    return _mm256_mul_ps(a.v, b.v);
+  }
+  friend Lanes8 operator/(Lanes8 a, Lanes8 b) {
+    return _mm256_div_ps(a.v, b.v);
+  }
+  friend Lanes8 max(Lanes8 a, Lanes8 b) { return _mm256_max_ps(a.v, b.v); }
+  friend Lanes8 abs(Lanes8 a) {
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v);
+  }
+};
+using Lanes = Lanes8;
+#elif defined(DENOISE_SSE2)
+struct Lanes4 {
+  static const int N = 4;
+  __m128 v;
+
+  Lanes4(__m128 x) : v{x} {}
+  Lanes4(float x) : v{_mm_set1_ps(x)} {}
+  static Lanes4 load(const float *p) { return _mm_loadu_ps(p); }
+  void store(float *p) const { _mm_storeu_ps(p, v); }
+
+  friend Lanes4 operator+(Lanes4 a, Lanes4 b) { return _mm_add_ps(a.v, b.v); }
+  friend Lanes4 operator-(Lanes4 a, Lanes4 b) { return _mm_sub_ps(a.v, b.v); }
+  friend Lanes4 operator*(Lanes4 a, Lanes4 b) { return _mm_mul_ps(a.v, b.v); }
+  friend Lanes4 operator/(Lanes4 a, Lanes4 b) { return _mm_div_ps(a.v, b.v); }
+  friend Lanes4 max(Lanes4 a, Lanes4 b) { return _mm_max_ps(a.v, b.v); }
+  friend Lanes4 abs(Lanes4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+};
+using Lanes = Lanes4;
+#else
+using Lanes = Lanes1;
+#endif
+
+inline const char *kernelName() {
+#if defined(DENOISE_AVX2)
+  return "avx2";
+#elif defined(DENOISE_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+// (1 + x/8)^-8, a stand-in for exp(-x) on x >= 0 that needs no table or
+// bit tricks, so every lane width computes the same weights
+template <typename L> inline L expNeg(L x) {
+  L t = L(1) / (L(1) + x * L(0.125f));
+  t = t * t;
+  t = t * t;
+  return t * t;
+}
+
+// one image's worth of planes, one float per pixel each
+struct Planes {
+  std::vector<float> c[3];
+
+  explicit Planes(size_t size = 0) {
+    for (auto &plane : c)
+      plane.assign(size, 0);
+  }
+};
+
+// the guide features in planar form, plus the per-pass constants
+struct Guide {
+  int width = 0, height = 0;
+  Planes albedo, normal;
+  std::vector<float> depth;
+  std::vector<float> samples; // each pixel's sample count
+  float colourScale; // times samples, 1 / sigma_colour^2 for this pass
+  float normalScale;
+  float depthScale; // 1 / (sigma_depth * step)
+  float albedoScale;
+};
+
+// the B3 spline the a-trous wavelet spreads over its holes
+const float KERNEL[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16};
+
+// filters L::N pixels of row m starting at column n. the taps are step
+// pixels apart, and each is weighted by the kernel times how alike the two
+// pixels' colour, normal, depth and albedo are. CLIP drops taps past the
+// left and right edges, which only the one-pixel version has to check
+template <typename L, bool CLIP>
+inline void filterPixels(const Guide &g, const Planes &in, Planes &out, int m,
+                         int n, int step) {
+  size_t p = size_t(m) * g.width + n;
+  L cr = L::load(&in.c[0][p]), cg = L::load(&in.c[1][p]),
+    cb = L::load(&in.c[2][p]);
+  L ar = L::load(&g.albedo.c[0][p]), ag = L::load(&g.albedo.c[1][p]),
+    ab = L::load(&g.albedo.c[2][p]);
+  L nx = L::load(&g.normal.c[0][p]), ny = L::load(&g.normal.c[1][p]),
+    nz = L::load(&g.normal.c[2][p]);
+  L z = L::load(&g.depth[p]);
+  // depth differences are relative to the pixel's own depth, so the
+  // tolerance grows with distance like the surface a pixel covers does
+  L zScale = L(g.depthScale) / max(z, L(1e-3f));
+  // and colour differences are relative to the pixel's noise, which falls
+  // off as 1 / sqrt(samples)
+  L cScale = L::load(&g.samples[p]) * L(g.colourScale);
+
+  L sumW(0.0f), sumR(0.0f), sumG(0.0f), sumB(0.0f);
+  for (int dy = -2; dy <= 2; ++dy) {
+    int mq = m + dy * step;
+    if (mq < 0 || mq >= g.height)
+      continue;
+    for (int dx = -2; dx <= 2; ++dx) {
+      int nq = n + dx * step;
+      if (CLIP && (nq < 0 || nq >= g.width))
+        continue;
+      size_t q = size_t(mq) * g.width + nq;
+      L qr = L::load(&in.c[0][q]), qg = L::load(&in.c[1][q]),
+        qb = L::load(&in.c[2][q]);
+      L dr = qr - cr, dg = qg - cg, db = qb - cb;
+      L dar = L::load(&g.albedo.c[0][q]) - ar,
+        dag = L::load(&g.albedo.c[1][q]) - ag,
+        dab = L::load(&g.albedo.c[2][q]) - ab;
+      L cosine = nx * L::load(&g.normal.c[0][q]) +
+                 ny * L::load(&g.normal.c[1][q]) +
+                 nz * L::load(&g.normal.c[2][q]);
+      L x = (dr * dr + dg * dg + db * db) * cScale +
+            max(L(0.0f), L(1) - cosine) * L(g.normalScale) +
+            abs(L::load(&g.depth[q]) - z) * zScale +
+            (dar * dar + dag * dag + dab * dab) * L(g.albedoScale);
+      L w = L(KERNEL[dy + 2] * KERNEL[dx + 2]) * expNeg(x);
+      sumW = sumW + w;
+      sumR = sumR + w * qr;
+      sumG = sumG + w * qg;
+      sumB = sumB + w * qb;
+    }
+  }
+  // the centre tap always counts fully, so sumW > 0
+  (sumR / sumW).store(&out.c[0][p]);
+  (sumG / sumW).store(&out.c[1][p]);
+  (sumB / sumW).store(&out.c[2][p]);
+}
+
+// one a-trous pass over row m: full vectors wherever every tap stays inside
+// the row, single pixels near the edges
+inline void filterRow(const Guide &g, const Planes &in, Planes &out, int m,
+                      int step) {
+  int margin = 2 * step;
+  int n = 0;
+  for (; n < std::min(margin, g.width); ++n)
+    filterPixels<Lanes1, true>(g, in, out, m, n, step);
+  for (; n + Lanes::N + margin <= g.width; n += Lanes::N)
+    filterPixels<Lanes, false>(g, in, out, m, n, step);
+  for (; n < g.width; ++n)
+    filterPixels<Lanes1, true>(g, in, out, m, n, step);
+}
+
+} // namespace denoise
+
+// edge-avoiding a-trous wavelet filter (Dammertz et al. 2010): a few passes
+// of a 5x5 B3-spline kernel whose taps spread out twice as far every pass,
+// so five passes cover 65 pixels for 125 taps per pixel. each tap's weight
+// falls off with how different its colour, normal, depth and albedo are
+// from the centre's, which keeps edges and texture sharp while the noise on
+// flat regions averages away. the filter runs on the image divided by the
+// albedo (the lighting alone) and multiplies it back afterwards, so surface
+// colour never gets blurred across
+class ATrousDenoiser {
+public:
+  int iterations = 5;
+  double sigmaColour = 1.6;  // the colour difference tolerated at one
+                             // sample per pixel in the first pass, shrinking
+                             // with 1 / sqrt(samples) and halved every pass
+  double sigmaNormal = 0.1;  // of 1 - cos(angle between the normals)
+  double sigmaDepth = 0.02;  // relative depth difference per pixel of step
+  double sigmaAlbedo = 0.1;
+  int threads = 0; // 0 = all hardware threads
+
+  // sampleCounts holds how many samples each pixel of image averages
+  Image denoise(const Image &image, const FeatureBuffers &features,
+                const std::vector<int> &sampleCounts) const {
+    int width = image.width, height = image.height;
+    size_t size = image.pixels.size();
+    denoise::Guide g;
+    g.width = width;
+    g.height = height;
+    g.albedo = denoise::Planes(size);
+    g.normal = denoise::Planes(size);
+    g.depth.resize(size);
+    g.samples.resize(size);
+    denoise::Planes a(size), b(size);
+    for (size_t i = 0; i < size; ++i) {
+      Colour albedo = features.albedoAt(i);
+      Vec3 normal = features.normalAt(i);
+      for (int c = 0; c < 3; ++c) {
+        g.albedo.c[c][i] = float(albedo[c]);
+        g.normal.c[c][i] = float(normal[c]);
+        a.c[c][i] = float(image.pixels[i][c] / demodulator(g.albedo.c[c][i]));
+      }
+      g.depth[i] = float(features.depthAt(i));
+      g.samples[i] = float(std::max(sampleCounts[i], 1));
+    }
+
+    // rows are independent within a pass; bands of rows keep the tasks
+    // coarse enough for parallelFor
+    const int band = 8;
+    int bands = (height + band - 1) / band;
+    for (int pass = 0, step = 1; pass < iterations; ++pass, step *= 2) {
+      double sigma = sigmaColour / double(1 << pass);
+      g.colourScale = float(1 / (sigma * sigma));
+      g.normalScale = float(1 / sigmaNormal);
+      g.depthScale = float(1 / (sigmaDepth * step));
+      g.albedoScale = float(1 / (sigmaAlbedo * sigmaAlbedo));
+      parallelFor(bands, threads, [&](int task, int) {
+        int end = std::min((task + 1) * band, height);
+        for (int m = task * band; m < end; ++m)
+          denoise::filterRow(g, a, b, m, step);
+      });
+      std::swap(a, b);
+    }
+
+    Image result(width, height);
+    for (size_t i = 0; i < size; ++i)
+      for (int c = 0; c < 3; ++c)
+        result.pixels[i][c] = a.c[c][i] * demodulator(g.albedo.c[c][i]);
+    return result;
+  }
+
+private:
+  // near-black albedo would blow the noise up, so it's floored
+  static double demodulator(double albedo) { return std::max(albedo, 0.01); }
+};
+
+#endif
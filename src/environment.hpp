@@ -0,0 +1,215 @@
+#ifndef ENVIRONMENT_HPP
+#define ENVIRONMENT_HPP
+
+#include "rtweekend.hpp"
+
+#include "image.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// how diffuse hits sample an EnvironmentMap directly (Camera::ENVIRONMENT)
+enum class EnvironmentSampling {
+  Off,        // the environment is only seen by rays that escape the scene
+  Uniform,    // shadow rays go in directions uniform over the sphere
+  Importance, // shadow rays go in proportion to the map's brightness
+};
+
+// an HDR environment in latitude-longitude layout: column u = 0..1 is the
+// angle around the y axis from +x towards +z, row v = 0..1 runs from straight
+// up (+y) to straight down. texels are kept as float RGB, halved in size at
+// load until they fit maxWidth, so a huge map costs a bounded amount of
+// memory. next to them go the tables for importance sampling: a cumulative
+// distribution over the rows and one over the texels of each row, in
+// proportion to luminance times the solid angle a texel covers (sin of its
+// polar angle), so a sample lands on the sun about as often as the sun
+// lights the scene
+class EnvironmentMap {
+public:
+  // loads a Radiance .hdr or a PFM (see readHdrImage). false if it can't
+  bool load(const std::string &path, int maxWidth = 4096) {
+    Image image;
+    if (!readHdrImage(path, image))
+      return false;
+    build(image, maxWidth);
+    return true;
+  }
+
+  void build(const Image &image, int maxWidth = 4096) {
+    width = image.width;
+    height = image.height;
+    texels.resize(size_t(width) * height * 3);
+    for (size_t i = 0; i < image.pixels.size(); ++i)
+      for (int c = 0; c < 3; ++c)
+        texels[i * 3 + c] = std::max(float(image.pixels[i][c]), 0.0f);
+    while (width > std::max(maxWidth, 1) && height > 1)
+      halve();
+    buildTables();
+  }
+
+  bool empty() const { return texels.empty(); }
+  int mapWidth() const { return width; }
+  int mapHeight() const { return height; }
+
+  // the radiance arriving from the unit direction, from the nearest texel
+  Colour lookup(const Vec3 &direction) const {
+    int i, j;
+    texelAt(direction, i, j);
+    const float *t = &texels[(size_t(j) * width + i) * 3];
+    return Colour(t[0], t[1], t[2]);
+  }
+
+  // picks a unit direction with the uniform numbers u0 and u1, and its
+  // density per solid angle. false if it can't (a pole, or how is Off)
+  bool sample(double u0, double u1, EnvironmentSampling how, Vec3 &direction,
+              double &pdf) const {
+    if (how == EnvironmentSampling::Uniform) {
+      double y = 1 - 2 * u0;
+      double r = std::sqrt(std::max(0.0, 1 - y * y));
+      double phi = 2 * pi * u1;
+      direction = Vec3(r * std::cos(phi), y, r * std::sin(phi));
+      pdf = 1 / (4 * pi);
+      return true;
+    }
+    if (how != EnvironmentSampling::Importance || empty())
+      return false;
+
+    int j = find(marginal.data(), height, u0);
+    const float *row = &conditional[size_t(j) * (width + 1)];
+    int i = find(row, width, u1);
+    double rowWidth = double(marginal[j + 1]) - marginal[j];
+    double texelWidth = double(row[i + 1]) - row[i];
+    // where inside the texel, reusing what's left of the numbers
+    double du = texelWidth > 0 ? (u1 - row[i]) / texelWidth : 0.5;
+    double dv = rowWidth > 0 ? (u0 - marginal[j]) / rowWidth : 0.5;
+    double u = (i + std::min(std::max(du, 0.0), 1.0)) / width;
+    double v = (j + std::min(std::max(dv, 0.0), 1.0)) / height;
+
+    double theta = pi * v;
+    double sinTheta = std::sin(theta);
+    if (sinTheta <= 0)
+      return false;
+    double phi = 2 * pi * u;
+    direction = Vec3(sinTheta * std::cos(phi), std::cos(theta),
+                     sinTheta * std::sin(phi));
+    pdf = rowWidth * height * texelWidth * width / (2 * pi * pi * sinTheta);
+    return pdf > 0;
+  }
+
+  // the density sample() has for the unit direction
+  double pdf(const Vec3 &direction, EnvironmentSampling how) const {
+    if (how == EnvironmentSampling::Uniform)
+      return 1 / (4 * pi);
+    if (how != EnvironmentSampling::Importance || empty())
+      return 0;
+    int i, j;
+    texelAt(direction, i, j);
+    double sinTheta = std::sqrt(
+        std::max(0.0, 1 - double(direction.y()) * double(direction.y())));
+    if (sinTheta <= 0)
+      return 0;
+    const float *row = &conditional[size_t(j) * (width + 1)];
+    double rowWidth = double(marginal[j + 1]) - marginal[j];
+    double texelWidth = double(row[i + 1]) - row[i];
+    return rowWidth * height * texelWidth * width / (2 * pi * pi * sinTheta);
+  }
+
+  // the integral of luminance over the sphere, for fingerprinting a map
+  double power() const { return totalPower; }
+
+  size_t textureBytes() const { return texels.capacity() * sizeof(float); }
+
+  size_t tableBytes() const {
+    return (marginal.capacity() + conditional.capacity()) * sizeof(float);
+  }
+
+private:
+  int width = 0;
+  int height = 0;
+  std::vector<float> texels;      // RGB, row-major from the top
+  std::vector<float> marginal;    // height + 1 entries, 0 to 1
+  std::vector<float> conditional; // height rows of width + 1, each 0 to 1
+  double totalPower = 0;
+
+  static double luminance(const float *t) {
+    return 0.2126 * t[0] + 0.7152 * t[1] + 0.0722 * t[2];
+  }
+
+  void texelAt(const Vec3 &direction, int &i, int &j) const {
+    double y = std::min(std::max(double(direction.y()), -1.0), 1.0);
+    double phi = std::atan2(double(direction.z()), double(direction.x()));
+    if (phi < 0)
+      phi += 2 * pi;
+    i = std::min(int(phi / (2 * pi) * width), width - 1);
+    j = std::min(int(std::acos(y) / pi * height), height - 1);
+  }
+
+  // averages 2x2 blocks (the last row or column on its own if the size is
+  // odd)
+  void halve() {
+    int halfWidth = (width + 1) / 2;
+    int halfHeight = (height + 1) / 2;
+    std::vector<float> half(size_t(halfWidth) * halfHeight * 3);
+    for (int j = 0; j < halfHeight; ++j) {
+      for (int i = 0; i < halfWidth; ++i) {
+        int j1 = std::min(2 * j + 1, height - 1);
+        int i1 = std::min(2 * i + 1, width - 1);
+        for (int c = 0; c < 3; ++c) {
+          auto at = [&](int jj, int ii) {
+            return texels[(size_t(jj) * width + ii) * 3 + c];
+          };
+          half[(size_t(j) * halfWidth + i) * 3 + c] =
+              0.25f * (at(2 * j, 2 * i) + at(2 * j, i1) + at(j1, 2 * i) +
+                       at(j1, i1));
+        }
+      }
+    }
+    texels.swap(half);
+    width = halfWidth;
+    height = halfHeight;
+  }
+
+  // accumulates in double and stores the normalised sums as float. a map
+  // that's black everywhere gets uniform tables
+  void buildTables() {
+    // fresh vectors, so a smaller map doesn't keep a larger one's capacity
+    std::vector<float>(size_t(height) + 1).swap(marginal);
+    std::vector<float>(size_t(height) * (width + 1)).swap(conditional);
+    std::vector<double> rowSums(height);
+    double total = 0;
+    for (int j = 0; j < height; ++j) {
+      double sinTheta = std::sin(pi * (j + 0.5) / height);
+      float *row = &conditional[size_t(j) * (width + 1)];
+      std::vector<double> sums(size_t(width) + 1, 0);
+      for (int i = 0; i < width; ++i)
+        sums[i + 1] =
+            sums[i] + luminance(&texels[(size_t(j) * width + i) * 3]) *
+                          sinTheta;
+      for (int i = 0; i <= width; ++i)
+        row[i] = sums[width] > 0 ? float(sums[i] / sums[width])
+                                 : float(i) / float(width);
+      rowSums[j] = sums[width];
+      total += sums[width];
+    }
+    double running = 0;
+    for (int j = 0; j < height; ++j) {
+      running += rowSums[j];
+      marginal[j + 1] =
+          total > 0 ? float(running / total) : float(j + 1) / float(height);
+    }
+    marginal[height] = 1;
+    totalPower = total * (2 * pi / width) * (pi / height);
+  }
+
+  // the entry k in [0, count) with cdf[k] <= u < cdf[k + 1], skipping
+  // entries of zero width
+  static int find(const float *cdf, int count, double u) {
+    const float *after = std::upper_bound(cdf, cdf + count + 1, float(u));
+    int k = int(after - cdf) - 1;
+    return std::min(std::max(k, 0), count - 1);
+  }
+};
+
+#endif
@@ -0,0 +1,408 @@
+#ifndef FARM_HPP
+#define FARM_HPP
+
+#include "rtweekend.hpp"
+
+#include "camera.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Distributed rendering: a coordinator process starts workers (itself, run
+// with --worker) connected over Unix socket pairs and hands them tiles one at
+// a time. Each worker rebuilds the scene from the same arguments and traces
+// its tiles with the same counter-keyed random streams, so the merged image
+// is the one a single process would render.
+//
+// Every message is a u32 type, a u32 payload size and the payload, all
+// little-endian:
+//   HELLO  worker -> coordinator  u64 camera hash, u64 scene hash
+//   TILE   coordinator -> worker  u32 tile index
+//   RESULT worker -> coordinator  u32 tile index, then for each pixel of the
+//                                 tile row by row: f64 r, g, b (the average)
+//                                 and u32 sample count, followed, when the
+//                                 camera collects features for denoising,
+//                                 by f64 albedo r, g, b, normal x, y, z and
+//                                 depth (the averages)
+//   STOP   coordinator -> worker  empty
+// the hashes are the checkpoint fingerprints (checkpoint.hpp): a worker that
+// built a different scene or camera is turned away rather than trusted
+namespace farm {
+
+enum MessageType : uint32_t { HELLO = 1, TILE, RESULT, STOP };
+
+struct Message {
+  uint32_t type = 0;
+  std::string payload;
+  size_t pos = 0; // read position in payload
+
+  void appendUint32(uint32_t v) {
+    for (int i = 0; i < 4; ++i)
+      payload.push_back(char((v >> (8 * i)) & 0xff));
+  }
+
+  void appendUint64(uint64_t v) {
+    appendUint32(uint32_t(v));
+    appendUint32(uint32_t(v >> 32));
+  }
+
+  void appendDouble(double d) {
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    appendUint64(bits);
+  }
+
+  // reads past the end return 0; callers check remaining() first
+  uint32_t readUint32() {
+    uint32_t v = 0;
+    for (int i = 0; i < 4 && pos < payload.size(); ++i, ++pos)
+      v |= uint32_t(uint8_t(payload[pos])) << (8 * i);
+    return v;
+  }
+
+  uint64_t readUint64() {
+    uint64_t lo = readUint32();
+    uint64_t hi = readUint32();
+    return lo | (hi << 32);
+  }
+
+  double readDouble() {
+    uint64_t bits = readUint64();
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+    return d;
+  }
+
+  size_t remaining() const { return payload.size() - pos; }
+};
+
+inline bool writeAll(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    // MSG_NOSIGNAL: a worker that died turns into an error here, not SIGPIPE
+    ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= size_t(n);
+  }
+  return true;
+}
+
+inline bool readAll(int fd, char *data, size_t size) {
+  while (size > 0) {
+    ssize_t n = ::read(fd, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= size_t(n);
+  }
+  return true;
+}
+
+inline bool send(int fd, const Message &message) {
+  Message header;
+  header.appendUint32(message.type);
+  header.appendUint32(uint32_t(message.payload.size()));
+  std::string buffer = header.payload + message.payload;
+  return writeAll(fd, buffer.data(), buffer.size());
+}
+
+// false on end of file, a read error or an implausibly large payload
+inline bool receive(int fd, Message &message) {
+  Message header;
+  header.payload.resize(8);
+  if (!readAll(fd, &header.payload[0], 8))
+    return false;
+  message.type = header.readUint32();
+  uint32_t size = header.readUint32();
+  if (size > (1u << 30))
+    return false;
+  message.payload.resize(size);
+  message.pos = 0;
+  return size == 0 || readAll(fd, &message.payload[0], size);
+}
+
+// one worker process as the coordinator sees it
+struct Worker {
+  pid_t pid = -1;
+  int fd = -1;
+  int tile = -1;      // tile it's working on, -1 when idle
+  bool hello = false; // passed the fingerprint check
+};
+
+// starts `self --worker <fd> args...` on the far end of a new socket pair
+inline bool spawnWorker(const std::string &self,
+                        const std::vector<std::string> &args, Worker &worker) {
+  int fds[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+    return false;
+
+  pid_t pid = ::fork();
+  if (pid < 0) {
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return false;
+  }
+  if (pid == 0) {
+    // the worker keeps only its own end open across exec
+    ::fcntl(fds[1], F_SETFD, 0);
+    std::string fdArg = std::to_string(fds[1]);
+    std::vector<const char *> argv = {self.c_str(), "--worker", fdArg.c_str()};
+    for (const auto &arg : args)
+      argv.push_back(arg.c_str());
+    argv.push_back(nullptr);
+    ::execv("/proc/self/exe", const_cast<char *const *>(argv.data()));
+    ::execvp(self.c_str(), const_cast<char *const *>(argv.data()));
+    ::_exit(127);
+  }
+
+  ::close(fds[1]);
+  worker.pid = pid;
+  worker.fd = fds[0];
+  return true;
+}
+
+// copies a RESULT payload into the merged image (and the camera's feature
+// buffers). false if it doesn't fit the tile it claims to be
+inline bool mergeTile(Camera &cam, Message &message, int tile, Image &image,
+                      std::vector<int> &sampleCounts) {
+  Camera::Tile bounds = cam.tileBounds(tile);
+  size_t pixels = size_t(bounds.m1 - bounds.m0) * (bounds.n1 - bounds.n0);
+  bool features = cam.collectsFeatures();
+  if (message.remaining() != pixels * (features ? 84 : 28))
+    return false;
+  for (int m = bounds.m0; m < bounds.m1; ++m) {
+    for (int n = bounds.n0; n < bounds.n1; ++n) {
+      double r = message.readDouble();
+      double g = message.readDouble();
+      double b = message.readDouble();
+      image.at(m, n) = Colour(r, g, b);
+      size_t pixel = size_t(m) * image.width + n;
+      sampleCounts[pixel] = int(message.readUint32());
+      if (features) {
+        double v[7];
+        for (double &x : v)
+          x = message.readDouble();
+        cam.features().set(pixel, Colour(v[0], v[1], v[2]),
+                           Vec3(v[3], v[4], v[5]), v[6]);
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace farm
+
+// worker side: says hello with its fingerprints, then renders whatever tiles
+// it's sent until STOP or the coordinator goes away
+inline int runFarmWorker(Camera &cam, const Hittable &world, int fd) {
+  cam.beginRender();
+  farm::Message hello;
+  hello.type = farm::HELLO;
+  hello.appendUint64(cam.cameraFingerprint());
+  hello.appendUint64(cam.sceneFingerprint(world));
+  if (!farm::send(fd, hello))
+    return 1;
+
+  // whole-image buffers, as the tile renderers index them by pixel
+  Image sums(cam.IMAGE_WIDTH, cam.imageHeight());
+  std::vector<int> sampleCounts(sums.pixels.size());
+  std::vector<Camera::PixelVariance> variances(sums.pixels.size());
+
+  farm::Message message;
+  while (farm::receive(fd, message) && message.type == farm::TILE) {
+    int tile = int(message.readUint32());
+    if (tile < 0 || tile >= cam.tileCount())
+      return 1;
+    cam.renderTile(world, tile, sums, sampleCounts, variances);
+
+    // the same averages render() would divide out, sent at full precision:
+    // rounding them to float would move the odd 8-bit pixel
+    farm::Message result;
+    result.type = farm::RESULT;
+    result.appendUint32(uint32_t(tile));
+    Camera::Tile bounds = cam.tileBounds(tile);
+    for (int m = bounds.m0; m < bounds.m1; ++m) {
+      for (int n = bounds.n0; n < bounds.n1; ++n) {
+        size_t pixel = size_t(m) * sums.width + n;
+        Colour average = sums.pixels[pixel] / sampleCounts[pixel];
+        result.appendDouble(average.x());
+        result.appendDouble(average.y());
+        result.appendDouble(average.z());
+        result.appendUint32(uint32_t(sampleCounts[pixel]));
+        if (cam.collectsFeatures()) {
+          const FeatureBuffers &f = cam.features();
+          Colour albedo = f.albedoAt(pixel);
+          Vec3 normal = f.normalAt(pixel);
+          for (int c = 0; c < 3; ++c)
+            result.appendDouble(albedo[c]);
+          for (int c = 0; c < 3; ++c)
+            result.appendDouble(normal[c]);
+          result.appendDouble(f.depthAt(pixel));
+        }
+      }
+    }
+    if (!farm::send(fd, result))
+      return 1;
+  }
+  ::close(fd);
+  return 0;
+}
+
+// coordinator side: renders world with workerCount copies of self (started
+// with args after --worker <fd>) and writes the merged image. tiles of a
+// worker that dies or sends garbage go back on the queue; whatever is left
+// when no worker remains is rendered here
+inline bool renderFarm(Camera &cam, const Hittable &world, int workerCount,
+                       const std::string &self,
+                       const std::vector<std::string> &args) {
+  cam.beginRender();
+  uint64_t cameraHash = cam.cameraFingerprint();
+  uint64_t sceneHash = cam.sceneFingerprint(world);
+
+  std::vector<farm::Worker> workers(size_t(std::max(workerCount, 1)));
+  for (auto &worker : workers)
+    if (!farm::spawnWorker(self, args, worker))
+      std::cerr << "could not start a worker: " << std::strerror(errno)
+                << '\n';
+
+  int tileCount = cam.tileCount();
+  std::deque<int> pending;
+  for (int tile = 0; tile < tileCount; ++tile)
+    pending.push_back(tile);
+
+  Image image(cam.IMAGE_WIDTH, cam.imageHeight());
+  std::vector<int> sampleCounts(image.pixels.size());
+  int tilesDone = 0;
+
+  auto retire = [&](farm::Worker &worker) {
+    if (worker.tile >= 0)
+      pending.push_front(worker.tile);
+    ::close(worker.fd);
+    worker.fd = -1;
+    worker.tile = -1;
+  };
+
+  // the next tile, or STOP once the queue is empty
+  auto assign = [&](farm::Worker &worker) {
+    farm::Message message;
+    if (pending.empty()) {
+      message.type = farm::STOP;
+      farm::send(worker.fd, message);
+      retire(worker);
+      return;
+    }
+    worker.tile = pending.front();
+    pending.pop_front();
+    message.type = farm::TILE;
+    message.appendUint32(uint32_t(worker.tile));
+    if (!farm::send(worker.fd, message))
+      retire(worker);
+  };
+
+  std::vector<pollfd> fds;
+  std::vector<farm::Worker *> polled;
+  while (tilesDone < tileCount) {
+    fds.clear();
+    polled.clear();
+    for (auto &worker : workers) {
+      if (worker.fd < 0)
+        continue;
+      fds.push_back(pollfd{worker.fd, POLLIN, 0});
+      polled.push_back(&worker);
+    }
+    if (fds.empty())
+      break;
+    if (::poll(fds.data(), nfds_t(fds.size()), -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    for (size_t i = 0; i < fds.size(); ++i) {
+      if (fds[i].revents == 0)
+        continue;
+      farm::Worker &worker = *polled[i];
+      farm::Message message;
+      if (!farm::receive(worker.fd, message)) {
+        if (worker.tile >= 0 || !pending.empty())
+          std::cerr << "worker " << worker.pid << " went away\n";
+        retire(worker);
+        continue;
+      }
+
+      if (message.type == farm::HELLO && !worker.hello) {
+        uint64_t workerCamera = message.readUint64();
+        uint64_t workerScene = message.readUint64();
+        if (workerCamera != cameraHash || workerScene != sceneHash) {
+          std::cerr << "worker " << worker.pid
+                    << " built a different camera or scene, ignoring it\n";
+          worker.tile = -1;
+          message = farm::Message();
+          message.type = farm::STOP;
+          farm::send(worker.fd, message);
+          retire(worker);
+          continue;
+        }
+        worker.hello = true;
+      } else if (message.type == farm::RESULT && worker.tile >= 0 &&
+                 int(message.readUint32()) == worker.tile &&
+                 farm::mergeTile(cam, message, worker.tile, image,
+                                 sampleCounts)) {
+        worker.tile = -1;
+        ++tilesDone;
+        if (cam.LOG_PROGRESS)
+          std::clog << "\rTiles remaining: " << (tileCount - tilesDone) << ' '
+                    << std::flush;
+      } else {
+        std::cerr << "worker " << worker.pid << " sent a bad message\n";
+        retire(worker);
+        continue;
+      }
+      assign(worker);
+    }
+  }
+
+  for (auto &worker : workers) {
+    if (worker.fd >= 0)
+      ::close(worker.fd);
+    if (worker.pid > 0)
+      ::waitpid(worker.pid, nullptr, 0);
+  }
+
+  if (!pending.empty()) {
+    std::clog << "\rRendering the last " << pending.size()
+              << " tiles locally\n";
+    Image sums(image.width, image.height);
+    std::vector<Camera::PixelVariance> variances(image.pixels.size());
+    for (int tile : pending) {
+      cam.renderTile(world, tile, sums, sampleCounts, variances);
+      Camera::Tile bounds = cam.tileBounds(tile);
+      for (int m = bounds.m0; m < bounds.m1; ++m)
+        for (int n = bounds.n0; n < bounds.n1; ++n)
+          image.at(m, n) =
+              sums.at(m, n) / sampleCounts[size_t(m) * image.width + n];
+    }
+  }
+  if (cam.LOG_PROGRESS)
+    std::clog << "\rDone.                 \n";
+
+  cam.finishRender(image, sampleCounts);
+  return true;
+}
+
+#endif
@@ -1,15 +1,22 @@
 #ifndef HITTABLE_HPP
 #define HITTABLE_HPP
 
+#include "aabb.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
 class Material;
 
 class HitRecord {
 public:
   Point3 p;
   Vec3 normal;
-  shared_ptr<Material> mat; // call member functions of this to determine
-                            // scattered ray + properties
-  double t;
+  const Material *mat; // call member functions of this to determine
+                       // scattered ray + properties. owned by the scene's
+                       // MaterialTable, so copying a record is just a copy
+  Real t;
   bool frontFace;
 
   void setFaceNormal(const Ray &r, const Vec3 &outwardNormal) {
@@ -21,12 +28,96 @@ public:
   }
 };
 
+// camera rays of a small block of pixels, traced together by hitPacket() so
+// a BVH walks its nodes once for the whole packet rather than once per ray.
+// each ray keeps its own closest hit. close() bounds the packet by a frustum
+// in interval form: the box its origins lie in and, per axis, the range of
+// its reciprocal directions. that holds rays from a lens too, where a
+// frustum of planes through one apex wouldn't
+struct RayPacket {
+  static const int MAX_SIZE = 64; // an 8x8 block, one bit each in a mask
+
+  int size = 0;
+  Real tMin = Real(0.001);
+  Ray rays[MAX_SIZE];
+  Real tMax[MAX_SIZE]; // the ray's closest hit so far, or infinity
+  bool hits[MAX_SIZE];
+  HitRecord recs[MAX_SIZE];
+
+  // the frustum, set by close(). an axis the rays don't all cross the same
+  // way bounds nothing
+  double originMin[3], originMax[3];
+  double invDirMin[3], invDirMax[3];
+  bool axisBounded[3];
+  bool dirIsNeg[3]; // the first ray's, for picking the near child
+
+  void clear() { size = 0; }
+
+  void add(const Ray &r) {
+    rays[size] = r;
+    tMax[size] = infinity;
+    hits[size] = false;
+    ++size;
+  }
+
+  uint64_t allRays() const {
+    return size >= 64 ? ~uint64_t(0) : (uint64_t(1) << size) - 1;
+  }
+
+  void close() {
+    for (int axis = 0; axis < 3; ++axis) {
+      double oMin = infinity, oMax = -infinity;
+      double dMin = infinity, dMax = -infinity;
+      for (int i = 0; i < size; ++i) {
+        double o = double(rays[i].origin()[axis]);
+        double d = double(rays[i].direction()[axis]);
+        oMin = std::min(oMin, o);
+        oMax = std::max(oMax, o);
+        dMin = std::min(dMin, d);
+        dMax = std::max(dMax, d);
+      }
+      originMin[axis] = oMin;
+      originMax[axis] = oMax;
+      axisBounded[axis] = size > 0 && (dMin > 0 || dMax < 0);
+      invDirMin[axis] = axisBounded[axis] ? 1 / dMax : 0;
+      invDirMax[axis] = axisBounded[axis] ? 1 / dMin : 0;
+      dirIsNeg[axis] = size > 0 && rays[0].direction()[axis] < 0;
+    }
+  }
+};
+
 // abstract base class
 class Hittable {
 public:
   virtual ~Hittable() = default;
 
+  // implementations only write to rec when they return true, so callers can
+  // pass the same record to several objects and keep the closest hit
   virtual bool hit(const Ray &r, Interval rayT, HitRecord &rec) const = 0;
+
+  // whether anything at all lies along r inside rayT: the any-hit query of
+  // shadow rays, which can stop at the first hit instead of looking for the
+  // closest and never fills in a record. the default just asks hit()
+  virtual bool occluded(const Ray &r, Interval rayT) const {
+    HitRecord rec;
+    return hit(r, rayT, rec);
+  }
+
+  // hit() for each ray of the packet whose bit is set in mask, keeping the
+  // closer of what it finds and what the ray has already hit. acceleration
+  // structures override it to share their traversal across the rays
+  virtual void hitPacket(RayPacket &packet, uint64_t mask) const {
+    for (int i = 0; i < packet.size; ++i)
+      if ((mask >> i & 1) &&
+          hit(packet.rays[i], Interval(packet.tMin, packet.tMax[i]),
+              packet.recs[i])) {
+        packet.tMax[i] = packet.recs[i].t;
+        packet.hits[i] = true;
+      }
+  }
+
+  // box enclosing everything hit() can report, used by the BVH
+  virtual AABB boundingBox() const = 0;
 };
 
 #endif
\ No newline at end of file
@@ -12,24 +12,49 @@ public:
   HittableList() {}
   HittableList(shared_ptr<Hittable> object) { add(object); }
 
-  void clear() { objects.clear(); }
+  void clear() {
+    objects.clear();
+    bbox = AABB();
+  }
 
-  void add(shared_ptr<Hittable> object) { objects.push_back(object); }
+  void add(shared_ptr<Hittable> object) {
+    objects.push_back(object);
+    bbox = AABB(bbox, object->boundingBox());
+  }
 
   bool hit(const Ray &r, Interval rayT, HitRecord &rec) const override {
-    HitRecord tmpRec;
+    RT_STAT(hitCalls, 1);
     bool hitAnything = false;
     auto closestSoFar = rayT.max;
 
+    // a miss leaves rec alone, so each closer hit can overwrite it in place
     for (const auto &object : objects) {
-      if (object->hit(r, Interval(rayT.min, closestSoFar), tmpRec)) {
+      if (object->hit(r, Interval(rayT.min, closestSoFar), rec)) {
         hitAnything = true;
-        closestSoFar = tmpRec.t;
-        rec = tmpRec;
+        closestSoFar = rec.t;
       }
     }
     return hitAnything;
   }
+
+  bool occluded(const Ray &r, Interval rayT) const override {
+    RT_STAT(hitCalls, 1);
+    for (const auto &object : objects)
+      if (object->occluded(r, rayT))
+        return true;
+    return false;
+  }
+
+  void hitPacket(RayPacket &packet, uint64_t mask) const override {
+    RT_STAT(hitCalls, 1);
+    for (const auto &object : objects)
+      object->hitPacket(packet, mask);
+  }
+
+  AABB boundingBox() const override { return bbox; }
+
+private:
+  AABB bbox;
 };
 
 #endif
\ No newline at end of file
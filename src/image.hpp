@@ -0,0 +1,377 @@
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include "rtweekend.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// a rendered image held in memory, in linear colour, row-major from the top
+// left (the same order the camera walks pixels in)
+class Image {
+public:
+  int width = 0;
+  int height = 0;
+  std::vector<Colour> pixels;
+
+  Image() {}
+  Image(int width, int height)
+      : width{width}, height{height}, pixels(size_t(width) * height) {}
+
+  Colour &at(int m, int n) { return pixels[size_t(m) * width + n]; }
+  const Colour &at(int m, int n) const { return pixels[size_t(m) * width + n]; }
+};
+
+enum class ImageFormat {
+  PpmAscii,   // P3, gamma corrected 8-bit text
+  PpmBinary,  // P6, gamma corrected 8-bit binary
+  Pfm,        // PF, linear 32-bit float (HDR)
+  TiledFloat, // linear 32-bit float stored tile by tile, see TiledFloatWriter
+  Rgbe,       // Radiance .hdr, linear with a shared 8-bit exponent (HDR)
+};
+
+// every writer encodes the whole image into one buffer and hands it to the
+// stream in a single write, rather than formatting pixel by pixel
+class ImageWriter {
+public:
+  virtual ~ImageWriter() = default;
+
+  virtual void write(std::ostream &out, const Image &image) const = 0;
+
+  // conventional file extension, without the dot
+  virtual const char *extension() const = 0;
+
+protected:
+  static void flush(std::ostream &out, const std::string &buffer) {
+    out.write(buffer.data(), std::streamsize(buffer.size()));
+    out.flush();
+  }
+
+  static void appendFloat(std::string &buffer, float f) {
+    // PFM and the tiled format are both little-endian, as is every platform
+    // we build on, so the raw bytes can be copied straight in
+    char bytes[sizeof(float)];
+    std::memcpy(bytes, &f, sizeof(float));
+    buffer.append(bytes, sizeof(float));
+  }
+
+  static void appendUint32(std::string &buffer, uint32_t v) {
+    char bytes[4] = {char(v & 0xff), char((v >> 8) & 0xff),
+                     char((v >> 16) & 0xff), char((v >> 24) & 0xff)};
+    buffer.append(bytes, 4);
+  }
+};
+
+class PpmAsciiWriter : public ImageWriter {
+public:
+  void write(std::ostream &out, const Image &image) const override {
+    std::string buffer = "P3\n" + std::to_string(image.width) + ' ' +
+                         std::to_string(image.height) + "\n255\n";
+    // at most "255 255 255\n" per pixel
+    buffer.reserve(buffer.size() + image.pixels.size() * 12);
+
+    char line[16];
+    for (const auto &pixel : image.pixels) {
+      unsigned char rgb[3];
+      colourToBytes(pixel, rgb);
+      int len = std::snprintf(line, sizeof(line), "%d %d %d\n", rgb[0], rgb[1],
+                              rgb[2]);
+      buffer.append(line, size_t(len));
+    }
+    flush(out, buffer);
+  }
+
+  const char *extension() const override { return "ppm"; }
+};
+
+class PpmBinaryWriter : public ImageWriter {
+public:
+  void write(std::ostream &out, const Image &image) const override {
+    std::string buffer = "P6\n" + std::to_string(image.width) + ' ' +
+                         std::to_string(image.height) + "\n255\n";
+    size_t header = buffer.size();
+    buffer.resize(header + image.pixels.size() * 3);
+
+    unsigned char *dst = reinterpret_cast<unsigned char *>(&buffer[header]);
+    for (const auto &pixel : image.pixels) {
+      colourToBytes(pixel, dst);
+      dst += 3;
+    }
+    flush(out, buffer);
+  }
+
+  const char *extension() const override { return "ppm"; }
+};
+
+// portable float map: linear values, no gamma or clamping. the negative scale
+// in the header marks the data as little-endian, and rows go bottom to top
+class PfmWriter : public ImageWriter {
+public:
+  void write(std::ostream &out, const Image &image) const override {
+    std::string buffer = "PF\n" + std::to_string(image.width) + ' ' +
+                         std::to_string(image.height) + "\n-1.0\n";
+    buffer.reserve(buffer.size() + image.pixels.size() * 3 * sizeof(float));
+
+    for (int m = image.height - 1; m >= 0; --m) {
+      for (int n = 0; n < image.width; ++n) {
+        const Colour &pixel = image.at(m, n);
+        appendFloat(buffer, float(pixel.x()));
+        appendFloat(buffer, float(pixel.y()));
+        appendFloat(buffer, float(pixel.z()));
+      }
+    }
+    flush(out, buffer);
+  }
+
+  const char *extension() const override { return "pfm"; }
+};
+
+// a minimal tiled float format, so a reader can pull out one region without
+// scanning whole rows:
+//   "RTTF" | u32 version (1) | u32 width | u32 height | u32 tile size |
+//   u32 channels (3) | tiles in row-major order, each one's pixels row-major
+//   as little-endian float RGB. tiles on the right and bottom edges are
+//   clipped to the image, not padded
+class TiledFloatWriter : public ImageWriter {
+public:
+  explicit TiledFloatWriter(int tileSize = 32)
+      : tileSize{tileSize < 1 ? 1 : tileSize} {}
+
+  void write(std::ostream &out, const Image &image) const override {
+    std::string buffer = "RTTF";
+    appendUint32(buffer, 1);
+    appendUint32(buffer, uint32_t(image.width));
+    appendUint32(buffer, uint32_t(image.height));
+    appendUint32(buffer, uint32_t(tileSize));
+    appendUint32(buffer, 3);
+    buffer.reserve(buffer.size() + image.pixels.size() * 3 * sizeof(float));
+
+    for (int m0 = 0; m0 < image.height; m0 += tileSize) {
+      for (int n0 = 0; n0 < image.width; n0 += tileSize) {
+        for (int m = m0; m < std::min(m0 + tileSize, image.height); ++m) {
+          for (int n = n0; n < std::min(n0 + tileSize, image.width); ++n) {
+            const Colour &pixel = image.at(m, n);
+            appendFloat(buffer, float(pixel.x()));
+            appendFloat(buffer, float(pixel.y()));
+            appendFloat(buffer, float(pixel.z()));
+          }
+        }
+      }
+    }
+    flush(out, buffer);
+  }
+
+  const char *extension() const override { return "rtt"; }
+
+private:
+  int tileSize;
+};
+
+// Radiance RGBE: three 8-bit mantissas sharing an exponent byte, so 4 bytes
+// a pixel cover the whole float range at about 1% precision. scanlines are
+// written flat (uncompressed), which every reader accepts
+class RgbeWriter : public ImageWriter {
+public:
+  void write(std::ostream &out, const Image &image) const override {
+    std::string buffer = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " +
+                         std::to_string(image.height) + " +X " +
+                         std::to_string(image.width) + "\n";
+    size_t header = buffer.size();
+    buffer.resize(header + image.pixels.size() * 4);
+
+    unsigned char *dst = reinterpret_cast<unsigned char *>(&buffer[header]);
+    for (const auto &pixel : image.pixels) {
+      double r = std::max(double(pixel.x()), 0.0);
+      double g = std::max(double(pixel.y()), 0.0);
+      double b = std::max(double(pixel.z()), 0.0);
+      double brightest = std::max({r, g, b});
+      if (brightest < 1e-32) {
+        std::memset(dst, 0, 4);
+      } else {
+        int exponent;
+        double scale = std::frexp(brightest, &exponent) * 256 / brightest;
+        dst[0] = (unsigned char)(r * scale);
+        dst[1] = (unsigned char)(g * scale);
+        dst[2] = (unsigned char)(b * scale);
+        dst[3] = (unsigned char)(exponent + 128);
+      }
+      dst += 4;
+    }
+    flush(out, buffer);
+  }
+
+  const char *extension() const override { return "hdr"; }
+};
+
+inline std::unique_ptr<ImageWriter> makeImageWriter(ImageFormat format) {
+  switch (format) {
+  case ImageFormat::PpmBinary:
+    return std::unique_ptr<ImageWriter>(new PpmBinaryWriter());
+  case ImageFormat::Pfm:
+    return std::unique_ptr<ImageWriter>(new PfmWriter());
+  case ImageFormat::TiledFloat:
+    return std::unique_ptr<ImageWriter>(new TiledFloatWriter());
+  case ImageFormat::Rgbe:
+    return std::unique_ptr<ImageWriter>(new RgbeWriter());
+  case ImageFormat::PpmAscii:
+  default:
+    return std::unique_ptr<ImageWriter>(new PpmAsciiWriter());
+  }
+}
+
+// writes to path, or to stdout when path is empty. returns false if the file
+// couldn't be written
+inline bool writeImage(const Image &image, ImageFormat format,
+                       const std::string &path) {
+  auto writer = makeImageWriter(format);
+  if (path.empty()) {
+    writer->write(std::cout, image);
+    return bool(std::cout);
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    std::cerr << "could not open " << path << " for writing\n";
+    return false;
+  }
+  writer->write(file, image);
+  return bool(file);
+}
+
+namespace hdr {
+
+// the pixels of a Radiance RGBE file after its header: flat scanlines, or
+// the run-length encoding that stores each channel of a scanline separately
+inline bool readRgbePixels(std::istream &in, Image &image) {
+  std::vector<unsigned char> scanline(size_t(image.width) * 4);
+  for (int m = 0; m < image.height; ++m) {
+    unsigned char start[4];
+    if (!in.read(reinterpret_cast<char *>(start), 4))
+      return false;
+    bool encoded = image.width >= 8 && image.width < 32768 &&
+                   start[0] == 2 && start[1] == 2 && !(start[2] & 0x80);
+    if (!encoded) {
+      std::memcpy(scanline.data(), start, 4);
+      if (!in.read(reinterpret_cast<char *>(scanline.data()) + 4,
+                   std::streamsize(scanline.size() - 4)))
+        return false;
+    } else {
+      if ((start[2] << 8 | start[3]) != image.width)
+        return false;
+      // each channel in turn: runs (count > 128, one value repeated count -
+      // 128 times) and literals (count values copied)
+      for (int c = 0; c < 4; ++c) {
+        for (int n = 0; n < image.width;) {
+          int count = in.get();
+          if (count <= 0)
+            return false;
+          bool run = count > 128;
+          if (run)
+            count -= 128;
+          if (n + count > image.width)
+            return false;
+          for (int k = 0; k < count; ++k, ++n) {
+            int value = run && k > 0 ? scanline[size_t(n - 1) * 4 + c]
+                                     : in.get();
+            if (value < 0)
+              return false;
+            scanline[size_t(n) * 4 + c] = (unsigned char)value;
+          }
+        }
+      }
+    }
+    for (int n = 0; n < image.width; ++n) {
+      const unsigned char *rgbe = &scanline[size_t(n) * 4];
+      double scale = rgbe[3] ? std::ldexp(1.0, int(rgbe[3]) - 136) : 0;
+      image.at(m, n) =
+          Colour(rgbe[0] * scale, rgbe[1] * scale, rgbe[2] * scale);
+    }
+  }
+  return true;
+}
+
+// a Radiance .hdr in the usual -Y h +X w orientation (rows top to bottom)
+inline bool readRgbe(std::istream &in, Image &image, std::string &error) {
+  std::string line;
+  bool rgbe = false;
+  while (std::getline(in, line) && !line.empty())
+    if (line.compare(0, 7, "FORMAT=") == 0)
+      rgbe = line == "FORMAT=32-bit_rle_rgbe";
+  if (!rgbe) {
+    error = "not an RGBE file";
+    return false;
+  }
+  int width = 0, height = 0;
+  if (!std::getline(in, line) ||
+      std::sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 ||
+      width <= 0 || height <= 0) {
+    error = "unsupported orientation or size '" + line + "'";
+    return false;
+  }
+  image = Image(width, height);
+  if (!readRgbePixels(in, image)) {
+    error = "truncated or corrupt pixels";
+    return false;
+  }
+  return true;
+}
+
+// a colour (PF) or greyscale (Pf) portable float map. a negative scale means
+// little-endian, and rows go bottom to top
+inline bool readPfm(std::istream &in, Image &image, std::string &error) {
+  std::string magic;
+  int width = 0, height = 0;
+  double scale = 0;
+  in >> magic >> width >> height >> scale;
+  in.get();
+  int channels = magic == "PF" ? 3 : magic == "Pf" ? 1 : 0;
+  if (!in || channels == 0 || width <= 0 || height <= 0 || scale == 0) {
+    error = "not a PFM file";
+    return false;
+  }
+  if (scale > 0) {
+    error = "big-endian PFM isn't supported";
+    return false;
+  }
+  image = Image(width, height);
+  std::vector<float> row(size_t(width) * channels);
+  for (int m = height - 1; m >= 0; --m) {
+    if (!in.read(reinterpret_cast<char *>(row.data()),
+                 std::streamsize(row.size() * sizeof(float)))) {
+      error = "truncated pixels";
+      return false;
+    }
+    for (int n = 0; n < width; ++n) {
+      const float *p = &row[size_t(n) * channels];
+      image.at(m, n) = channels == 3 ? Colour(p[0], p[1], p[2])
+                                     : Colour(p[0], p[0], p[0]);
+    }
+  }
+  return true;
+}
+
+} // namespace hdr
+
+// reads a linear HDR image, a Radiance .hdr or a PFM told apart by their
+// first bytes. errors go to stderr
+inline bool readHdrImage(const std::string &path, Image &image) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    std::cerr << "could not read " << path << '\n';
+    return false;
+  }
+  std::string error;
+  bool ok = in.peek() == 'P' ? hdr::readPfm(in, image, error)
+                             : hdr::readRgbe(in, image, error);
+  if (!ok)
+    std::cerr << path << ": " << error << '\n';
+  return ok;
+}
+
+#endif
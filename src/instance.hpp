@@ -0,0 +1,188 @@
+#ifndef INSTANCE_HPP
+#define INSTANCE_HPP
+
+#include "rtweekend.hpp"
+
+#include "aabb.hpp"
+#include "hittable.hpp"
+#include "linearBvh.hpp"
+#include "transform.hpp"
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// a shared piece of geometry placed in the world by an affine transform. the
+// ray is taken into the object's space instead of the object into the
+// world's, so any number of instances can point at one object (and its BVH)
+// without copying it
+class Instance final : public Hittable {
+public:
+  // object isn't owned and must outlive the instance. toWorld must be
+  // invertible
+  Instance(const Hittable *object, const Affine &toWorld) : object{object} {
+    place(toWorld);
+  }
+
+  // puts the instance at toWorld. given shutter (the transforms at shutter
+  // open and close, which must outlive the instance) it moves across the
+  // shutter instead, following the blend of the two at each ray's time.
+  // that costs a moving instance an inverse per ray, but blending the
+  // inverses instead would bend each point's path out of its box (and can
+  // pass through a singular matrix), so only a still instance keeps one
+  void place(const Affine &toWorld, const Affine *shutter = nullptr) {
+    motion = shutter;
+    toObject = toWorld.inverse();
+    bbox = AABB();
+    addCorners(toWorld);
+    // blended transforms map each point between its two end positions, so
+    // the box around both ends holds the whole sweep
+    if (motion)
+      addCorners(motion[1]);
+  }
+
+  bool hit(const Ray &r, Interval rayT, HitRecord &rec) const override {
+    RT_STAT(hitCalls, 1);
+    if (motion)
+      return hitThrough(
+          Affine::lerp(motion[0], motion[1], r.time()).inverse(), r, rayT,
+          rec);
+    return hitThrough(toObject, r, rayT, rec);
+  }
+
+  bool occluded(const Ray &r, Interval rayT) const override {
+    RT_STAT(hitCalls, 1);
+    Affine toObj =
+        motion ? Affine::lerp(motion[0], motion[1], r.time()).inverse()
+               : toObject;
+    return object->occluded(Ray(toObj.point(r.origin()),
+                                toObj.vector(r.direction()), r.time()),
+                            rayT);
+  }
+
+  AABB boundingBox() const override { return bbox; }
+
+private:
+  const Hittable *object;
+  const Affine *motion = nullptr; // shutter open and close, if moving
+  Affine toObject;                // world to object space
+  AABB bbox;
+
+  bool hitThrough(const Affine &toObj, const Ray &r, Interval rayT,
+                  HitRecord &rec) const {
+    // the direction isn't renormalised, so t means the same in both spaces
+    // and rayT carries over unchanged
+    Ray local(toObj.point(r.origin()), toObj.vector(r.direction()), r.time());
+    if (!object->hit(local, rayT, rec))
+      return false;
+
+    // affine maps keep the sign of dot(direction, normal), so frontFace
+    // from the object's hit stays right
+    rec.p = r.at(rec.t);
+    rec.normal = unitVector(toObj.transposedVector(rec.normal));
+    return true;
+  }
+
+  // grows bbox by the object box's corners under toWorld
+  void addCorners(const Affine &toWorld) {
+    AABB local = object->boundingBox();
+    for (int corner = 0; corner < 8; ++corner) {
+      Point3 p((corner & 1) ? local.x.max : local.x.min,
+               (corner & 2) ? local.y.max : local.y.min,
+               (corner & 4) ? local.z.max : local.z.min);
+      Point3 q = toWorld.point(p);
+      bbox = AABB(bbox, AABB(q, q));
+    }
+  }
+};
+
+// top level of a two-level acceleration structure: instances kept in one
+// array with a LinearBvh over them, while each instanced object brings its
+// own bottom-level BVH (a SphereSet, say) shared by all its instances
+class InstanceSet final : public Hittable {
+public:
+  void add(const Hittable *object, const Affine &toWorld) {
+    instances.emplace_back(object, toWorld);
+  }
+
+  void reserve(size_t count) { instances.reserve(count); }
+
+  size_t size() const { return instances.size(); }
+
+  // moves instance i to open, or, when close differs, sweeps it from open
+  // to close across the shutter (motion blur). call refit() once the
+  // moves for a frame are done
+  void place(size_t i, const Affine &open, const Affine &close) {
+    if (open == close) {
+      instances[i].place(open);
+      return;
+    }
+    // one pair of slots per instance, allocated the first time anything
+    // moves and never resized after, so the instances can point into it
+    if (shutter.empty())
+      shutter.resize(2 * instances.size());
+    shutter[2 * i] = open;
+    shutter[2 * i + 1] = close;
+    instances[i].place(open, &shutter[2 * i]);
+  }
+
+  // updates the BVH after place(). refitting keeps the tree built for where
+  // the instances used to be, so once its SAH cost has grown past
+  // REBUILD_GROWTH times the cost right after the last build (or when asked
+  // to) the tree is rebuilt instead. returns whether it was rebuilt
+  bool refit(bool forceRebuild = false) {
+    if (!bvh)
+      return false;
+    bvh->refit();
+    if (!forceRebuild && bvh->sahCost() <= REBUILD_GROWTH * builtCost)
+      return false;
+    build();
+    return true;
+  }
+
+  // call after the last add(), before the set goes into a list or BVH
+  void build() {
+    std::vector<const Leaf *> raw(instances.size());
+    for (size_t i = 0; i < instances.size(); ++i)
+      raw[i] = &instances[i];
+    bvh.reset(new LinearBvhT<Leaf>(raw));
+    builtCost = bvh->sahCost();
+  }
+
+  bool hit(const Ray &r, Interval rayT, HitRecord &rec) const override {
+    return bvh && bvh->hit(r, rayT, rec);
+  }
+
+  bool occluded(const Ray &r, Interval rayT) const override {
+    return bvh && bvh->occluded(r, rayT);
+  }
+
+  void hitPacket(RayPacket &packet, uint64_t mask) const override {
+    if (bvh)
+      bvh->hitPacket(packet, mask);
+  }
+
+  AABB boundingBox() const override {
+    return bvh ? bvh->boundingBox() : AABB();
+  }
+
+  // bytes held by the instances and the top-level BVH
+  size_t memoryBytes() const {
+    return instances.capacity() * sizeof(Instance) +
+           shutter.capacity() * sizeof(Affine) +
+           (bvh ? bvh->memoryBytes() : 0);
+  }
+
+private:
+  static constexpr double REBUILD_GROWTH = 2;
+
+  // the BVH calls the instances directly unless DEVIRTUALIZE is off
+  using Leaf = std::conditional<DEVIRTUALIZE, Instance, Hittable>::type;
+
+  std::vector<Instance> instances;
+  std::vector<Affine> shutter; // open and close transforms of each instance
+  std::unique_ptr<LinearBvhT<Leaf>> bvh;
+  double builtCost = 0; // sahCost() right after the last build
+};
+
+#endif
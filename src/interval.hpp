@@ -1,30 +1,45 @@
 #ifndef INTERVAL_HPP
 #define INTERVAL_HPP
 
-class Interval {
+template <typename T> class IntervalT {
 public:
-  double min, max;
+  T min, max;
 
-  Interval() : min(+infinity), max(-infinity) {} // empty
+  IntervalT()
+      : min(+std::numeric_limits<T>::infinity()),
+        max(-std::numeric_limits<T>::infinity()) {} // empty
 
-  Interval(double min, double max) : min{min}, max{max} {}
+  IntervalT(T min, T max) : min{min}, max{max} {}
 
-  double size() const { return max - min; }
+  // tightest interval enclosing both a and b
+  IntervalT(const IntervalT &a, const IntervalT &b)
+      : min{a.min <= b.min ? a.min : b.min},
+        max{a.max >= b.max ? a.max : b.max} {}
 
-  bool contains(double x) const { return min <= x && x <= max; }
+  T size() const { return max - min; }
 
-  bool surrounds(double x) const { return min < x && x < max; }
+  bool contains(T x) const { return min <= x && x <= max; }
 
-  double clamp(double x) const {
+  bool surrounds(T x) const { return min < x && x < max; }
+
+  T clamp(T x) const {
     if (x < min) return min;
     if (x > max) return max;
     return x;
   }
 
-  static const Interval empty, universe;
+  static const IntervalT empty, universe;
 };
 
-const Interval Interval::empty = Interval(+infinity, -infinity);
-const Interval Interval::universe = Interval(-infinity, +infinity);
+template <typename T>
+const IntervalT<T> IntervalT<T>::empty =
+    IntervalT<T>(+std::numeric_limits<T>::infinity(),
+                 -std::numeric_limits<T>::infinity());
+template <typename T>
+const IntervalT<T> IntervalT<T>::universe =
+    IntervalT<T>(-std::numeric_limits<T>::infinity(),
+                 +std::numeric_limits<T>::infinity());
+
+using Interval = IntervalT<Real>;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,118 @@
+#ifndef LIGHT_HPP
+#define LIGHT_HPP
+
+#include "rtweekend.hpp"
+
+#include "hittable.hpp"
+#include "material.hpp"
+
+#include <cmath>
+#include <vector>
+
+// an emissive sphere the integrator samples directly
+struct SphereLight {
+  Point3 centre;
+  Real radius;
+  const Material *mat; // emits, owned by the scene's MaterialTable
+};
+
+// the lights next-event estimation picks from (see Camera::directLight):
+// every emissive sphere of the scene that isn't inside an instanced object.
+// a shading point picks one light uniformly, then a direction uniformly
+// within the cone the sphere subtends from it, which covers exactly the
+// visible part of the sphere
+class LightList {
+public:
+  void add(const Point3 &centre, Real radius, const Material *mat) {
+    lights.push_back(SphereLight{centre, radius, mat});
+  }
+
+  size_t size() const { return lights.size(); }
+  bool empty() const { return lights.empty(); }
+
+  // picks a light and a unit direction from p towards it, using the uniform
+  // numbers u0, u1 and u2. fills in where the direction meets the light as a
+  // record of a hit on its outside, and the density of the choice per
+  // solid angle. false if p is inside the light it picked
+  bool sample(const Point3 &p, double u0, double u1, double u2,
+              Vec3 &direction, HitRecord &at, double &pdf) const {
+    size_t count = lights.size();
+    const SphereLight &light =
+        lights[std::min(size_t(u0 * double(count)), count - 1)];
+    Vec3 toCentre = light.centre - p;
+    double distanceSquared = double(toCentre.lengthSquared());
+    double radiusSquared = double(light.radius) * double(light.radius);
+    if (distanceSquared <= radiusSquared)
+      return false;
+
+    // uniform over the cone's solid angle: cos(theta) uniform in
+    // [cosMax, 1]. 1 - cosMax is computed without the cancellation the
+    // obvious form has for small, distant lights
+    double sinSquaredMax = radiusSquared / distanceSquared;
+    double cosMax = std::sqrt(1 - sinSquaredMax);
+    double oneMinusCosMax = sinSquaredMax / (1 + cosMax);
+    double cosTheta = 1 - u1 * oneMinusCosMax;
+    double sinTheta = std::sqrt(std::max(0.0, 1 - cosTheta * cosTheta));
+    double phi = 2 * pi * u2;
+
+    Vec3 w = unitVector(toCentre);
+    Vec3 a = std::fabs(double(w.x())) > 0.9 ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
+    Vec3 v = unitVector(cross(w, a));
+    Vec3 u = cross(w, v);
+    direction = unitVector(Real(sinTheta * std::cos(phi)) * u +
+                           Real(sinTheta * std::sin(phi)) * v +
+                           Real(cosTheta) * w);
+
+    Real t = entryDistance(light, p, direction);
+    at.t = t;
+    at.p = p + t * direction;
+    at.normal = (at.p - light.centre) / light.radius;
+    at.frontFace = true;
+    at.mat = light.mat;
+    pdf = 1 / (2 * pi * oneMinusCosMax * double(count));
+    return true;
+  }
+
+  // the density sample() has of picking the direction of r from its origin,
+  // given that r hits something emissive at distance t (in units of r's
+  // direction). 0 unless what it hit is one of the listed lights
+  double pdf(const Ray &r, Real t) const {
+    Point3 p = r.at(t);
+    double slack = 1e-4 * double(t * r.direction().length());
+    double total = 0;
+    for (const auto &light : lights) {
+      Vec3 toCentre = light.centre - r.origin();
+      double distanceSquared = double(toCentre.lengthSquared());
+      double radiusSquared = double(light.radius) * double(light.radius);
+      if (distanceSquared <= radiusSquared)
+        continue;
+      // the light that was hit is the one whose surface the hit is on
+      double offSurface =
+          std::fabs(double((p - light.centre).length() - light.radius));
+      if (offSurface > 1e-3 * double(light.radius) + slack)
+        continue;
+      double sinSquaredMax = radiusSquared / distanceSquared;
+      double oneMinusCosMax =
+          sinSquaredMax / (1 + std::sqrt(1 - sinSquaredMax));
+      total += 1 / (2 * pi * oneMinusCosMax);
+    }
+    return total / double(lights.size());
+  }
+
+private:
+  std::vector<SphereLight> lights;
+
+  // distance along the unit direction from p (outside the light) to where it
+  // enters the sphere. only called with directions inside the cone
+  static Real entryDistance(const SphereLight &light, const Point3 &p,
+                            const Vec3 &direction) {
+    Vec3 toCentre = light.centre - p;
+    Real h = dot(direction, toCentre);
+    Real c = toCentre.lengthSquared() - light.radius * light.radius;
+    Real discriminant = h * h - c;
+    // a direction inside the cone can round to a graze
+    return h - std::sqrt(std::max(discriminant, Real(0)));
+  }
+};
+
+#endif
@@ -0,0 +1,627 @@
+#ifndef LINEAR_BVH_HPP
+#define LINEAR_BVH_HPP
+
+#include "rtweekend.hpp"
+
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "hittable.hpp"
+#include "hittableList.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// one BVH node packed into 32 bytes, so two nodes share a cache line. bounds
+// are floats rounded outwards from the double-precision boxes, so the float box
+// always contains the real one
+struct LinearBvhNode {
+  float boundsMin[3];
+  float boundsMax[3];
+  union {
+    uint32_t primitivesOffset;  // leaf: first primitive in the primitive array
+    uint32_t secondChildOffset; // interior: index of the second child (the
+                                // first child always directly follows)
+  };
+  uint16_t primitiveCount; // 0 for interior nodes
+  uint8_t axis;            // interior: split axis, used to pick the near child
+  uint8_t pad;
+};
+
+static_assert(sizeof(LinearBvhNode) == 32, "BVH nodes should be 32 bytes");
+
+// BVH flattened into a single depth-first array of compact nodes. traversal
+// walks the array with a small fixed stack instead of chasing shared_ptrs, and
+// visits the child on the near side of the split first so closer hits shrink
+// the ray interval before the far child is tested.
+// Primitive is what the leaves hold: any Hittable through its virtual
+// functions, or one concrete type (a final class, or a non-virtual one with
+// the same hit, occluded, hitPacket and boundingBox) whose calls the
+// compiler can make direct and inline into the walk.
+// big trees are built on buildThreads threads (0 = one per hardware thread):
+// the top levels bin their primitives in parallel, and the subtrees below
+// them are built as tasks of their own. the tree comes out the same on any
+// number of threads
+template <typename Primitive> class LinearBvhT : public Hittable {
+public:
+  LinearBvhT(const HittableList &list, int maxPrimitivesInLeaf = 4,
+             int buildThreads = 0)
+      : LinearBvhT(list.objects, maxPrimitivesInLeaf, buildThreads) {}
+
+  LinearBvhT(const std::vector<shared_ptr<Hittable>> &objects,
+             int maxPrimitivesInLeaf = 4, int buildThreads = 0)
+      : LinearBvhT(rawPointers(objects), maxPrimitivesInLeaf, buildThreads) {
+    owned = objects;
+  }
+
+  // doesn't take ownership: the objects must outlive the BVH. lets objects
+  // that live in one contiguous array go into a BVH without a shared_ptr each
+  LinearBvhT(const std::vector<const Primitive *> &objects,
+             int maxPrimitivesInLeaf = 4, int buildThreads = 0)
+      : maxLeaf{maxPrimitivesInLeaf < 1 ? 1 : maxPrimitivesInLeaf} {
+    if (objects.empty())
+      return;
+
+    size_t count = objects.size();
+    BuildContext context;
+    context.threads =
+        count < PARALLEL_BUILD_MIN ? 1 : resolveThreadCount(buildThreads);
+    std::vector<BuildPrimitive> build(count);
+    inChunks(count, context.threads, [&](size_t begin, size_t end, int) {
+      for (size_t i = begin; i < end; ++i) {
+        build[i].box = objects[i]->boundingBox();
+        build[i].centroid = build[i].box.centroid();
+        build[i].index = i;
+      }
+    });
+
+    // nodes are built into an arena of 2 * count - 1 slots, where the nodes
+    // of a subtree over n primitives go into the 2n - 1 slots starting at
+    // its root. subtrees being built at once never need to agree on where
+    // their nodes go, and flatten() packs them into nodes afterwards
+    std::unique_ptr<LinearBvhNode[]> arena(new LinearBvhNode[2 * count - 1]);
+    context.arena = arena.get();
+    // a few tasks per thread, so stealing can even out uneven subtrees
+    context.taskSize =
+        context.threads > 1
+            ? std::max(count / (8 * size_t(context.threads)),
+                       size_t(MIN_TASK_SIZE))
+            : count;
+    context.nodeCount =
+        buildNode(build, context, 0, count, 0, 0, context.threads > 1);
+    std::vector<size_t> taskNodes(context.tasks.size());
+    parallelFor(int(context.tasks.size()), context.threads,
+                [&](int t, int) {
+                  const SubtreeTask &task = context.tasks[t];
+                  taskNodes[t] = buildNode(build, context, task.start,
+                                           task.end, task.slot, task.depth,
+                                           false);
+                });
+    for (size_t n : taskNodes)
+      context.nodeCount += n;
+    flatten(context.arena, context.nodeCount);
+
+    // primitives are stored in leaf order, so a leaf's primitives are
+    // contiguous in memory too
+    primitives.resize(count);
+    inChunks(count, context.threads, [&](size_t begin, size_t end, int) {
+      for (size_t i = begin; i < end; ++i)
+        primitives[i] = objects[build[i].index];
+    });
+  }
+
+  bool hit(const Ray &r, Interval rayT, HitRecord &rec) const override {
+    RT_STAT(hitCalls, 1);
+    if (nodes.empty())
+      return false;
+
+    RaySlabs slabs(r);
+    bool hitAnything = false;
+
+    uint32_t stack[64];
+    int stackSize = 0;
+    uint32_t current = 0;
+
+    while (true) {
+      const LinearBvhNode &node = nodes[current];
+      RT_STAT(nodeVisits, 1);
+      if (slabs.hit(node, rayT)) {
+        if (node.primitiveCount > 0) {
+          for (uint32_t i = 0; i < node.primitiveCount; ++i) {
+            if (primitives[node.primitivesOffset + i]->hit(r, rayT, rec)) {
+              hitAnything = true;
+              rayT.max = rec.t;
+            }
+          }
+          if (stackSize == 0)
+            break;
+          current = stack[--stackSize];
+        } else if (slabs.dirIsNeg[node.axis]) {
+          // the second child is on the near side, visit it first
+          stack[stackSize++] = current + 1;
+          current = node.secondChildOffset;
+        } else {
+          stack[stackSize++] = node.secondChildOffset;
+          current = current + 1;
+        }
+      } else {
+        if (stackSize == 0)
+          break;
+        current = stack[--stackSize];
+      }
+    }
+    return hitAnything;
+  }
+
+  // the same walk as hit(), but done at the first primitive in the way. the
+  // order children are visited in doesn't matter for that, so the near
+  // child still goes first only because it's the likelier to stop the walk
+  bool occluded(const Ray &r, Interval rayT) const override {
+    RT_STAT(hitCalls, 1);
+    if (nodes.empty())
+      return false;
+
+    RaySlabs slabs(r);
+    uint32_t stack[64];
+    int stackSize = 0;
+    uint32_t current = 0;
+
+    while (true) {
+      const LinearBvhNode &node = nodes[current];
+      RT_STAT(nodeVisits, 1);
+      if (slabs.hit(node, rayT)) {
+        if (node.primitiveCount > 0) {
+          for (uint32_t i = 0; i < node.primitiveCount; ++i)
+            if (primitives[node.primitivesOffset + i]->occluded(r, rayT))
+              return true;
+          if (stackSize == 0)
+            break;
+          current = stack[--stackSize];
+        } else if (slabs.dirIsNeg[node.axis]) {
+          stack[stackSize++] = current + 1;
+          current = node.secondChildOffset;
+        } else {
+          stack[stackSize++] = node.secondChildOffset;
+          current = current + 1;
+        }
+      } else {
+        if (stackSize == 0)
+          break;
+        current = stack[--stackSize];
+      }
+    }
+    return false;
+  }
+
+  // the walk of hit() done once for a packet of rays. a node is skipped when
+  // the packet's frustum misses it, which culls it for every ray with one
+  // test, and otherwise entered as soon as one ray of the mask hits its box
+  // (usually the first tried, the rays being coherent). leaves test each
+  // ray's own slab, and the primitives only see the rays that pass it
+  void hitPacket(RayPacket &packet, uint64_t mask) const override {
+    RT_STAT(hitCalls, 1);
+    if (nodes.empty() || mask == 0)
+      return;
+
+    RaySlabs slabs[RayPacket::MAX_SIZE];
+    for (int i = 0; i < packet.size; ++i)
+      if (mask >> i & 1)
+        slabs[i] = RaySlabs(packet.rays[i]);
+    double tFar = farthest(packet, mask);
+
+    uint32_t stack[64];
+    int stackSize = 0;
+    uint32_t current = 0;
+
+    while (true) {
+      const LinearBvhNode &node = nodes[current];
+      RT_STAT(nodeVisits, 1);
+      bool enter = frustumMayHit(node, packet, tFar);
+      if (enter && node.primitiveCount > 0) {
+        uint64_t leafMask = 0;
+        for (int i = 0; i < packet.size; ++i) {
+          if (!(mask >> i & 1))
+            continue;
+          RT_STAT(nodeVisits, 1);
+          if (slabs[i].hit(node, Interval(packet.tMin, packet.tMax[i])))
+            leafMask |= uint64_t(1) << i;
+        }
+        if (leafMask != 0) {
+          for (uint32_t j = 0; j < node.primitiveCount; ++j)
+            primitives[node.primitivesOffset + j]->hitPacket(packet,
+                                                             leafMask);
+          tFar = farthest(packet, mask);
+        }
+      } else if (enter) {
+        enter = false;
+        for (int i = 0; i < packet.size && !enter; ++i) {
+          if (!(mask >> i & 1))
+            continue;
+          RT_STAT(nodeVisits, 1);
+          enter = slabs[i].hit(node, Interval(packet.tMin, packet.tMax[i]));
+        }
+        if (enter) {
+          if (packet.dirIsNeg[node.axis]) {
+            stack[stackSize++] = current + 1;
+            current = node.secondChildOffset;
+          } else {
+            stack[stackSize++] = node.secondChildOffset;
+            current = current + 1;
+          }
+          continue;
+        }
+      }
+      if (stackSize == 0)
+        break;
+      current = stack[--stackSize];
+    }
+  }
+
+  AABB boundingBox() const override { return bbox; }
+
+  size_t nodeCount() const { return nodes.size(); }
+
+  // recomputes every node's bounds from its primitives' current boxes,
+  // keeping the tree as it was built. far cheaper than a rebuild when the
+  // primitives have only moved a little, but the tree gets looser the
+  // further they drift (see sahCost())
+  void refit() {
+    // children always come after their parent, so walking the array
+    // backwards finishes both children before the node that holds them
+    for (size_t i = nodes.size(); i-- > 0;) {
+      LinearBvhNode &node = nodes[i];
+      if (node.primitiveCount > 0) {
+        AABB bounds;
+        for (uint32_t j = 0; j < node.primitiveCount; ++j)
+          bounds = AABB(bounds,
+                        primitives[node.primitivesOffset + j]->boundingBox());
+        setBounds(node, bounds);
+      } else {
+        const LinearBvhNode &a = nodes[i + 1];
+        const LinearBvhNode &b = nodes[node.secondChildOffset];
+        for (int axis = 0; axis < 3; ++axis) {
+          node.boundsMin[axis] = std::min(a.boundsMin[axis], b.boundsMin[axis]);
+          node.boundsMax[axis] = std::max(a.boundsMax[axis], b.boundsMax[axis]);
+        }
+      }
+    }
+    if (!nodes.empty())
+      bbox = AABB(Point3(nodes[0].boundsMin[0], nodes[0].boundsMin[1],
+                         nodes[0].boundsMin[2]),
+                  Point3(nodes[0].boundsMax[0], nodes[0].boundsMax[1],
+                         nodes[0].boundsMax[2]));
+  }
+
+  // expected cost of a random ray through the tree, in primitive tests: the
+  // SAH summed over every node. compare it before and after refit() to see
+  // how much the tree has degraded
+  double sahCost() const {
+    if (nodes.empty())
+      return 0;
+    double rootArea = nodeArea(nodes[0]);
+    if (rootArea <= 0)
+      return 0;
+    double cost = 0;
+    for (const auto &node : nodes)
+      cost += nodeArea(node) / rootArea *
+              (node.primitiveCount > 0 ? double(node.primitiveCount)
+                                       : TRAVERSAL_COST);
+    return cost;
+  }
+
+  // bytes held by the nodes and the primitive pointers
+  size_t memoryBytes() const {
+    return nodes.capacity() * sizeof(LinearBvhNode) +
+           primitives.capacity() * sizeof(const Primitive *);
+  }
+
+private:
+  struct BuildPrimitive {
+    AABB box;
+    Point3 centroid;
+    size_t index; // position in the source object list
+  };
+
+  // per-ray values for the float slab test, computed once per traversal
+  struct RaySlabs {
+    float origin[3];
+    float invDir[3];
+    bool dirIsNeg[3];
+
+    RaySlabs() {}
+
+    RaySlabs(const Ray &r) {
+      for (int axis = 0; axis < 3; ++axis) {
+        origin[axis] = float(r.origin()[axis]);
+        invDir[axis] = float(1.0 / r.direction()[axis]);
+        dirIsNeg[axis] = invDir[axis] < 0;
+      }
+    }
+
+    bool hit(const LinearBvhNode &node, const Interval &rayT) const {
+      float tMin = float(rayT.min);
+      float tMax = float(rayT.max);
+      for (int axis = 0; axis < 3; ++axis) {
+        float t0 = (node.boundsMin[axis] - origin[axis]) * invDir[axis];
+        float t1 = (node.boundsMax[axis] - origin[axis]) * invDir[axis];
+        if (dirIsNeg[axis]) std::swap(t0, t1);
+
+        // widen the far distance by the worst-case float rounding error of the
+        // two operations above, so a box is never missed by an ulp
+        t1 *= 1 + 2 * floatGamma3;
+
+        if (t0 > tMin) tMin = t0;
+        if (t1 < tMax) tMax = t1;
+        if (tMin > tMax)
+          return false;
+      }
+      return true;
+    }
+  };
+
+  // the interval form of the slab test: bounds on where any ray of the packet
+  // enters and leaves the node's box. if the latest entry can't come before
+  // the earliest exit (or the box is behind every ray, or beyond every
+  // ray's closest hit) no ray of the packet hits it. the slack covers the
+  // per-ray float test accepting a box a rounding error away
+  static bool frustumMayHit(const LinearBvhNode &node,
+                            const RayPacket &packet, double tFar) {
+    double enter = double(packet.tMin);
+    double exit = tFar;
+    for (int axis = 0; axis < 3; ++axis) {
+      if (!packet.axisBounded[axis])
+        continue;
+      double lo[2], hi[2]; // [min plane, max plane] t ranges
+      const float bounds[2] = {node.boundsMin[axis], node.boundsMax[axis]};
+      for (int k = 0; k < 2; ++k) {
+        double a = bounds[k] - packet.originMax[axis];
+        double b = bounds[k] - packet.originMin[axis];
+        double c = packet.invDirMin[axis], d = packet.invDirMax[axis];
+        lo[k] = std::min(std::min(a * c, a * d), std::min(b * c, b * d));
+        hi[k] = std::max(std::max(a * c, a * d), std::max(b * c, b * d));
+      }
+      int near = packet.invDirMin[axis] < 0 ? 1 : 0;
+      enter = std::max(enter, lo[near]);
+      exit = std::min(exit, hi[1 - near]);
+    }
+    return enter <= exit + 1e-5 * (std::fabs(exit) + 1);
+  }
+
+  // the farthest any ray of the mask still looks
+  static double farthest(const RayPacket &packet, uint64_t mask) {
+    double t = 0;
+    for (int i = 0; i < packet.size; ++i)
+      if (mask >> i & 1)
+        t = std::max(t, double(packet.tMax[i]));
+    return t;
+  }
+
+  static constexpr float floatGamma3 =
+      3 * std::numeric_limits<float>::epsilon() /
+      (1 - 3 * std::numeric_limits<float>::epsilon());
+
+  // the primitive's own leaf cost is 1, and SAH costs are measured in
+  // primitive tests, so this is how much a node visit costs relative to that
+  static constexpr double TRAVERSAL_COST = 0.125;
+
+  // the traversal stack holds 64 entries; median splits below this depth add
+  // at most log2(2^32) more levels
+  static constexpr int MAX_SAH_DEPTH = 30;
+
+  // below this many primitives a build stays on one thread, and subtree
+  // tasks are never smaller than MIN_TASK_SIZE, since starting threads
+  // costs more than such builds take
+  static constexpr size_t PARALLEL_BUILD_MIN = 1 << 14;
+  static constexpr size_t MIN_TASK_SIZE = 1 << 12;
+
+  std::vector<LinearBvhNode> nodes;
+  std::vector<const Primitive *> primitives; // hot array used by traversal
+  std::vector<shared_ptr<Hittable>> owned;   // keeps shared primitives alive
+  AABB bbox;
+  int maxLeaf;
+
+  static std::vector<const Hittable *>
+  rawPointers(const std::vector<shared_ptr<Hittable>> &objects) {
+    std::vector<const Hittable *> raw(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i)
+      raw[i] = objects[i].get();
+    return raw;
+  }
+
+  static float roundDown(double x) {
+    float f = float(x);
+    return (double(f) > x) ? std::nextafter(f, -HUGE_VALF) : f;
+  }
+
+  static float roundUp(double x) {
+    float f = float(x);
+    return (double(f) < x) ? std::nextafter(f, HUGE_VALF) : f;
+  }
+
+  static void setBounds(LinearBvhNode &node, const AABB &bounds) {
+    for (int axis = 0; axis < 3; ++axis) {
+      node.boundsMin[axis] = roundDown(bounds.axisInterval(axis).min);
+      node.boundsMax[axis] = roundUp(bounds.axisInterval(axis).max);
+    }
+  }
+
+  static double nodeArea(const LinearBvhNode &node) {
+    double d[3];
+    for (int axis = 0; axis < 3; ++axis)
+      d[axis] = double(node.boundsMax[axis]) - double(node.boundsMin[axis]);
+    return 2 * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+  }
+
+  // a subtree left for a task of its own: primitives [start, end) of the
+  // build array, with its root in arena slot `slot`
+  struct SubtreeTask {
+    size_t start, end, slot;
+    int depth;
+  };
+
+  struct BuildContext {
+    LinearBvhNode *arena;
+    int threads;
+    size_t taskSize; // ranges this small become tasks
+    std::vector<SubtreeTask> tasks;
+    size_t nodeCount;
+  };
+
+  // runs fn(begin, end, chunk) over threads contiguous chunks of [0, count)
+  template <typename Fn>
+  static void inChunks(size_t count, int threads, const Fn &fn) {
+    parallelFor(threads, threads, [&](int chunk, int) {
+      fn(count * chunk / threads, count * (chunk + 1) / threads, chunk);
+    });
+  }
+
+  // the bounds of build[start, end), the bounds of its centroids and the
+  // best SAH split of it
+  static void splitRange(const std::vector<BuildPrimitive> &build,
+                         size_t start, size_t end, AABB &bounds,
+                         AABB &centroidBounds, SahSplit &split) {
+    for (size_t i = start; i < end; ++i) {
+      bounds = AABB(bounds, build[i].box);
+      centroidBounds =
+          AABB(centroidBounds, AABB(build[i].centroid, build[i].centroid));
+    }
+    SahBins bins(centroidBounds);
+    for (size_t i = start; i < end; ++i)
+      bins.add(build[i].box);
+    split = bins.best(bounds);
+  }
+
+  // splitRange() with each of threads threads going over a chunk of the
+  // range, into bounds and bins of its own that are merged after
+  static void splitInParallel(const std::vector<BuildPrimitive> &build,
+                              size_t start, size_t end, int threads,
+                              AABB &bounds, AABB &centroidBounds,
+                              SahSplit &split) {
+    size_t count = end - start;
+    std::vector<AABB> partBounds(threads), partCentroids(threads);
+    inChunks(count, threads, [&](size_t begin, size_t finish, int chunk) {
+      AABB b, c;
+      for (size_t i = start + begin; i < start + finish; ++i) {
+        b = AABB(b, build[i].box);
+        c = AABB(c, AABB(build[i].centroid, build[i].centroid));
+      }
+      partBounds[chunk] = b;
+      partCentroids[chunk] = c;
+    });
+    for (int chunk = 0; chunk < threads; ++chunk) {
+      bounds = AABB(bounds, partBounds[chunk]);
+      centroidBounds = AABB(centroidBounds, partCentroids[chunk]);
+    }
+
+    std::vector<SahBins> bins(threads, SahBins(centroidBounds));
+    inChunks(count, threads, [&](size_t begin, size_t finish, int chunk) {
+      for (size_t i = start + begin; i < start + finish; ++i)
+        bins[chunk].add(build[i].box);
+    });
+    for (int chunk = 1; chunk < threads; ++chunk)
+      bins[0].merge(bins[chunk]);
+    split = bins[0].best(bounds);
+  }
+
+  // builds the subtree over build[start, end) with its root in arena slot
+  // `slot` and returns how many nodes it made. with spawn, ranges of
+  // taskSize or fewer are left in context.tasks instead, and ranges bigger
+  // than that bin their primitives on all the threads
+  size_t buildNode(std::vector<BuildPrimitive> &build, BuildContext &context,
+                   size_t start, size_t end, size_t slot, int depth,
+                   bool spawn) {
+    size_t count = end - start;
+    if (spawn && count <= context.taskSize) {
+      context.tasks.push_back(SubtreeTask{start, end, slot, depth});
+      return 0;
+    }
+    AABB bounds, centroidBounds;
+    SahSplit split;
+    if (spawn && context.threads > 1)
+      splitInParallel(build, start, end, context.threads, bounds,
+                      centroidBounds, split);
+    else
+      splitRange(build, start, end, bounds, centroidBounds, split);
+    LinearBvhNode &node = context.arena[slot];
+    if (slot == 0)
+      bbox = bounds;
+    setBounds(node, bounds);
+
+    // a leaf costs one test per primitive, a split costs a node visit plus the
+    // expected tests in the children
+    bool makeLeaf = count == 1 ||
+                    (count <= size_t(maxLeaf) &&
+                     (split.axis < 0 || count <= TRAVERSAL_COST + split.cost));
+
+    size_t mid = start + count / 2;
+    int splitAxis = centroidBounds.longestAxis();
+    if (!makeLeaf && depth >= MAX_SAH_DEPTH) {
+      // SAH can peel off a few primitives per level on pathological inputs;
+      // deep down switch to median splits so the traversal stack can't overflow
+      std::nth_element(build.begin() + start, build.begin() + mid,
+                       build.begin() + end,
+                       [&](const BuildPrimitive &a, const BuildPrimitive &b) {
+                         return a.centroid[splitAxis] < b.centroid[splitAxis];
+                       });
+    } else if (!makeLeaf && split.axis >= 0) {
+      splitAxis = split.axis;
+      auto it = std::partition(build.begin() + start, build.begin() + end,
+                               [&](const BuildPrimitive &b) {
+                                 return b.centroid[split.axis] < split.pos;
+                               });
+      if (it != build.begin() + start && it != build.begin() + end)
+        mid = size_t(it - build.begin());
+    }
+
+    if (makeLeaf) {
+      node.primitivesOffset = uint32_t(start);
+      node.primitiveCount = uint16_t(count);
+      node.axis = 0;
+      return 1;
+    }
+
+    // the first child's subtree takes the 2 * (mid - start) - 1 slots after
+    // this node, the second's the ones after that
+    node.primitiveCount = 0;
+    node.axis = uint8_t(splitAxis);
+    size_t second = slot + 2 * (mid - start);
+    node.secondChildOffset = uint32_t(second);
+    return 1 + buildNode(build, context, start, mid, slot + 1, depth + 1,
+                         spawn) +
+           buildNode(build, context, mid, end, second, depth + 1, spawn);
+  }
+
+  // copies the tree out of the arena into nodes, depth first, which closes
+  // up the slots the arena left between subtrees. the first child follows
+  // its parent in both, so only the second child offsets change
+  void flatten(const LinearBvhNode *arena, size_t nodeCount) {
+    const uint32_t noParent = ~uint32_t(0);
+    nodes.clear();
+    nodes.reserve(nodeCount);
+    // second children still to copy: their slot, and their parent's index
+    std::vector<std::pair<uint32_t, uint32_t>> pending(
+        1, std::make_pair(uint32_t(0), noParent));
+    while (!pending.empty()) {
+      uint32_t slot = pending.back().first;
+      uint32_t parent = pending.back().second;
+      pending.pop_back();
+      if (parent != noParent)
+        nodes[parent].secondChildOffset = uint32_t(nodes.size());
+      while (true) {
+        nodes.push_back(arena[slot]);
+        if (arena[slot].primitiveCount > 0)
+          break;
+        pending.push_back(std::make_pair(arena[slot].secondChildOffset,
+                                         uint32_t(nodes.size() - 1)));
+        ++slot;
+      }
+    }
+  }
+};
+
+using LinearBvh = LinearBvhT<Hittable>;
+
+#endif
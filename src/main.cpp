@@ -1,106 +1,190 @@
 #include "rtweekend.hpp"
 
+#include "animation.hpp"
+#include "builtinScenes.hpp"
 #include "camera.hpp"
-#include "hittable.hpp"
-#include "hittableList.hpp"
-#include "material.hpp"
-#include "sphere.hpp"
-
-int main() {
-  // world
-  HittableList world;
-
-  //  auto material_ground = make_shared<Lambertian>(Colour(0.8, 0.8, 0.0));
-  //  auto material_center = make_shared<Dielectric>(1.5);
-  //  auto material_bubble = make_shared<Dielectric>(1.00 / 1.50);
-  //  auto material_left = make_shared<Metal>(Colour(0.5, 0.5, 0.5), 0.1);
-  //  auto material_right = make_shared<Metal>(Colour(0.1, 0.1, 0.1), 1.0);
-  //  world.add(
-  //      make_shared<Sphere>(Point3(0.0, -100.5, -1.0), 100.0,
-  //      material_ground));
-  //
-  //  world.add(make_shared<Sphere>(Point3(0.0, 0.0, -1.2), 0.5,
-  //  material_center));
-  //  // world.add(make_shared<Sphere>(Point3(0, 0, -1.2), 0.4,
-  //  material_bubble)); world.add(make_shared<Sphere>(Point3(-1.0, 0.0, -1.0),
-  //  0.5, material_left)); world.add(make_shared<Sphere>(Point3(3.0, 0.0,
-  //  -5.0), 1.0, material_right));
-
-  //  auto R = cos(pi / 4);
-  //
-  //  auto matL = make_shared<Lambertian>(Colour(0, 0, 1));
-  //  auto matR = make_shared<Lambertian>(Colour(1, 0, 0));
-  //
-  //  world.add(make_shared<Sphere>(Point3(-R, 0, -1), R, matL));
-  //  world.add(make_shared<Sphere>(Point3(R, 0, -1), R, matR));
-  // auto material_ground = make_shared<Lambertian>(Colour(0.8, 0.8, 0.0));
-  // auto material_center = make_shared<Lambertian>(Colour(0.1, 0.2, 0.5));
-  // auto material_left = make_shared<Dielectric>(1.50);
-  // auto material_bubble = make_shared<Dielectric>(1.00 / 1.50);
-  // auto material_right = make_shared<Metal>(Colour(0.8, 0.6, 0.2), 1.0);
-
-  // world.add(
-  //     make_shared<Sphere>(Point3(0.0, -100.5, -1.0), 100.0,
-  //     material_ground));
-  // world.add(make_shared<Sphere>(Point3(0.0, 0.0, -1.2), 0.5,
-  // material_center)); world.add(make_shared<Sphere>(Point3(-1.0, 0.0, -1.0),
-  // 0.5, material_left)); world.add(make_shared<Sphere>(Point3(-1.0, 0.0,
-  // -1.0), 0.4, material_bubble)); world.add(make_shared<Sphere>(Point3(1.0,
-  // 0.0, -1.0), 0.5, material_right));
-
-  auto ground_material = make_shared<Lambertian>(Colour(0.5, 0.5, 0.5));
-  world.add(make_shared<Sphere>(Point3(0, -1000, 0), 1000, ground_material));
-
-  auto material1 = make_shared<Dielectric>(1.5);
-  world.add(make_shared<Sphere>(Point3(0, 1, 0), 1.0, material1));
+#include "environment.hpp"
+#include "farm.hpp"
+#include "preview.hpp"
+#include "scene.hpp"
+#include "sceneFile.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// usage: inOneWeekend [--workers <n>] [--frames <n>] [--output <path>]
+//                     [--denoise] [--aovs <prefix>] [--roulette <depth>]
+//                     [--preview <socket>] [--no-nee]
+//                     [--environment <map>] [--packets <n>] [scene file]
+//        inOneWeekend --save-scene <path>
+// renders the given scene file (text or binary), or the cover scene, to
+// stdout or --output. with --workers the tiles are traced by n worker
+// processes (0 = one per hardware thread), see farm.hpp. a scene with
+// 'camera frames' above 1, or --frames, renders as a sequence (see
+// animation.hpp) to --output with its '#'s replaced by the frame number
+// (frame####.ppm by default). --denoise filters the image before writing it
+// and --aovs writes the albedo, normal and depth buffers that guide the
+// filter to <prefix>albedo.ppm and so on. --roulette ends paths by Russian
+// roulette once they have bounced depth times (Camera::ROULETTE_DEPTH). the
+// --preview keeps running as an interactive preview server on the Unix
+// socket (see preview.hpp), also writing each pass to --output if given.
+// --no-nee turns off sampling the scene's lights directly, leaving emitters
+// to be found by chance (Camera::LIGHTS). --environment lights the scene with
+// an HDR map (a Radiance .hdr or a PFM in latitude-longitude layout) in place
+// of the sky, sampled by importance unless --no-nee (Camera::ENVIRONMENT).
+// --packets traces camera rays in packets of n x n pixels, up to 8
+// (Camera::PACKET_SIZE); the image is the same.
+// the second form writes the cover scene out instead, as text if path ends
+// in .txt and binary otherwise
+int main(int argc, char **argv) {
+  SceneFile file;
+  if (argc > 2 && std::strcmp(argv[1], "--save-scene") == 0) {
+    coverScene(file);
+    std::string path = argv[2];
+    bool text = path.size() > 4 && path.substr(path.size() - 4) == ".txt";
+    return (text ? file.saveText(path) : file.saveBinary(path)) ? 0 : 1;
+  }
 
-  auto material2 = make_shared<Lambertian>(Colour(0.4, 0.2, 0.1));
-  world.add(make_shared<Sphere>(Point3(-4, 1, 0), 1.0, material2));
+  int workers = -1;
+  int workerFd = -1; // set when started by a coordinator with --worker <fd>
+  int frames = 0;    // 0 = as the scene says
+  std::string output;
+  bool denoise = false;
+  std::string aovPrefix;
+  int roulette = 0;
+  std::string previewSocket;
+  bool sampleLights = true;
+  std::string environmentPath;
+  int packets = 0;
+  std::vector<std::string> sceneArgs;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+      workers = resolveThreadCount(std::atoi(argv[++i]));
+    else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+      frames = std::max(std::atoi(argv[++i]), 1);
+    else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+      output = argv[++i];
+    else if (std::strcmp(argv[i], "--denoise") == 0)
+      denoise = true;
+    else if (std::strcmp(argv[i], "--aovs") == 0 && i + 1 < argc)
+      aovPrefix = argv[++i];
+    else if (std::strcmp(argv[i], "--roulette") == 0 && i + 1 < argc)
+      roulette = std::max(std::atoi(argv[++i]), 0);
+    else if (std::strcmp(argv[i], "--preview") == 0 && i + 1 < argc)
+      previewSocket = argv[++i];
+    else if (std::strcmp(argv[i], "--no-nee") == 0)
+      sampleLights = false;
+    else if (std::strcmp(argv[i], "--environment") == 0 && i + 1 < argc)
+      environmentPath = argv[++i];
+    else if (std::strcmp(argv[i], "--packets") == 0 && i + 1 < argc)
+      packets = std::min(std::max(std::atoi(argv[++i]), 0), 8);
+    else if (std::strcmp(argv[i], "--worker") == 0 && i + 1 < argc)
+      workerFd = std::atoi(argv[++i]);
+    else
+      sceneArgs.push_back(argv[i]);
+  }
 
-  auto material3 = make_shared<Metal>(Colour(0.7, 0.6, 0.5), 0.0);
-  world.add(make_shared<Sphere>(Point3(4, 1, 0), 1.0, material3));
+  if (!sceneArgs.empty()) {
+    if (!file.load(sceneArgs[0]))
+      return 1;
+  } else {
+    coverScene(file);
+  }
 
-  for (int a = -11; a < 11; a++) {
-    for (int b = -11; b < 11; b++) {
-      auto choose_mat = randomDouble();
-      Point3 center(a + 0.9 * randomDouble(), 0.2, b + 0.9 * randomDouble());
+  Scene scene; // must outlive the render, primitives point into it
+  scene.build(file);
 
-      if ((center - Point3(4, 0.2, 0)).length() > 0.9) {
-        shared_ptr<Material> sphere_material;
+  Camera cam;
+  file.applyCamera(cam);
+  cam.IMAGE_FORMAT = ImageFormat::PpmBinary;
+  cam.DENOISE = denoise;
+  cam.ROULETTE_DEPTH = roulette;
+  cam.PACKET_SIZE = packets;
+  if (sampleLights)
+    cam.LIGHTS = &scene.lights;
+  EnvironmentMap environment;
+  if (!environmentPath.empty()) {
+    auto loadStart = std::chrono::steady_clock::now();
+    if (!environment.load(environmentPath))
+      return 1;
+    std::clog << "Environment " << environment.mapWidth() << 'x'
+              << environment.mapHeight() << " loaded in "
+              << std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - loadStart)
+                     .count()
+              << " s, " << environment.textureBytes() / 1e6 << " MB texels, "
+              << environment.tableBytes() / 1e6 << " MB sampling tables\n";
+    cam.ENVIRONMENT = &environment;
+    if (!sampleLights)
+      cam.ENVIRONMENT_SAMPLING = EnvironmentSampling::Off;
+  }
+  if (!aovPrefix.empty()) {
+    cam.ALBEDO_PATH = aovPrefix + "albedo.ppm";
+    cam.NORMAL_PATH = aovPrefix + "normal.ppm";
+    cam.DEPTH_PATH = aovPrefix + "depth.ppm";
+  }
 
-        if (choose_mat < 0.8) {
-          // diffuse
-          auto albedo = Colour::random() * Colour::random();
-          sphere_material = make_shared<Lambertian>(albedo);
-          world.add(make_shared<Sphere>(center, 0.2, sphere_material));
-        } else if (choose_mat < 0.95) {
-          // metal
-          auto albedo = Colour::random(0.5, 1);
-          auto fuzz = randomDouble(0, 0.5);
-          sphere_material = make_shared<Metal>(albedo, fuzz);
-          world.add(make_shared<Sphere>(center, 0.2, sphere_material));
-        } else {
-          // glass
-          sphere_material = make_shared<Dielectric>(1.5);
-          world.add(make_shared<Sphere>(center, 0.2, sphere_material));
-        }
-      }
+  if (frames == 0)
+    frames = file.animation.frames;
+  // a worker traces tiles of its coordinator's frame and the preview server
+  // shows one view, so neither renders the scene's sequence
+  if (workerFd >= 0 || !previewSocket.empty())
+    frames = 1;
+  if (frames > 1) {
+    if (workers > 0) {
+      std::cerr << "--workers can't render sequences\n";
+      return 1;
     }
+    renderSequence(file, scene, cam, frames,
+                   output.empty() ? "frame####.ppm" : output);
+    return 0;
   }
-
-  Camera cam;
-  cam.ASPECT_RATIO = 16.0 / 9.0;
-  cam.IMAGE_WIDTH = 1200;
-  cam.SAMPLES_PER_PIXEL = 100;
-  cam.MAX_DEPTH = 50;
-
-  cam.VFOV = 20;
-  cam.lookfrom = Point3(13, 2, 3);
-  cam.lookat = Point3(0, 0, -1);
-  cam.vup = Vec3(0, 1, 0);
-
-  cam.defocusAngle = 0.6;
-  cam.focusDistance = 10.0;
-
-  cam.render(world);
-}
\ No newline at end of file
+  // a single frame of an animated scene is its first
+  if (!file.motionKeys.empty()) {
+    placeInstances(file, scene, 0, cam.SHUTTER);
+    scene.refit(true);
+  }
+  cameraAt(file, 0, cam);
+  cam.OUTPUT_PATH = output;
+
+  if (workerFd >= 0)
+    return runFarmWorker(cam, scene.world, workerFd);
+  if (!previewSocket.empty()) {
+    PreviewServer server(file, scene.world, cam);
+    if (!server.listen(previewSocket))
+      return 1;
+    std::clog << "Preview server listening on " << previewSocket << '\n';
+    cam.LOG_PROGRESS = false;
+    cam.PREVIEW_PATH = output;
+    server.run();
+    return 0;
+  }
+  if (workers > 0) {
+    // workers only need to know the frame, to send back the denoising
+    // features, and how to trace
+    std::vector<std::string> workerArgs = sceneArgs;
+    workerArgs.push_back("--frames");
+    workerArgs.push_back(std::to_string(frames));
+    if (cam.collectsFeatures())
+      workerArgs.push_back("--denoise");
+    if (roulette > 0) {
+      workerArgs.push_back("--roulette");
+      workerArgs.push_back(std::to_string(roulette));
+    }
+    if (!sampleLights)
+      workerArgs.push_back("--no-nee");
+    if (!environmentPath.empty()) {
+      workerArgs.push_back("--environment");
+      workerArgs.push_back(environmentPath);
+    }
+    if (packets > 0) {
+      workerArgs.push_back("--packets");
+      workerArgs.push_back(std::to_string(packets));
+    }
+    return renderFarm(cam, scene.world, workers, argv[0], workerArgs) ? 0 : 1;
+  }
+  cam.render(scene.world);
+}
@@ -3,10 +3,27 @@
 
 #include "rtweekend.hpp"
 
+#include "stats.hpp"
+
 class HitRecord;
 
+// the materials the renderer itself defines, tagged so hot loops can switch
+// on the tag instead of making a virtual call (see dispatch below)
+enum class MaterialKind : uint8_t {
+  Lambertian,
+  Metal,
+  Dielectric,
+  Light,
+  Other,
+};
+
 class Material {
 public:
+  // Other for materials from outside this file, which the switch leaves to
+  // their virtual functions
+  const MaterialKind kind;
+
+  explicit Material(MaterialKind kind = MaterialKind::Other) : kind{kind} {}
   virtual ~Material() = default;
 
   // attenuation, scattered are modified parameters
@@ -14,14 +31,40 @@ public:
                        Colour &attenuation, Ray &scattered) const {
     return false;
   }
+
+  // the colour the surface tints light with, independent of lighting. only
+  // guides the denoiser (see denoise.hpp), so an approximation is fine
+  virtual Colour surfaceAlbedo() const { return Colour(0, 0, 0); }
+
+  // whether the surface is (close to) a mirror, so what it shows is the
+  // scene beyond it rather than its own texture. also only for the denoiser
+  virtual bool isSpecular() const { return false; }
+
+  // radiance the surface gives off at rec, towards where the ray came from
+  virtual Colour emitted(const HitRecord &rec) const { return Colour(0, 0, 0); }
+
+  // next-event estimation (see Camera::directLight) needs the BRDF in closed
+  // form: materials that have one say so here, and give the BRDF for light
+  // arriving from the unit direction wi and the density (per solid angle)
+  // with which scatter() picks wi. the others are only ever lit by rays
+  // that happen to hit a light
+  virtual bool samplesLights() const { return false; }
+  virtual Colour brdf(const HitRecord &rec, const Vec3 &wi) const {
+    return Colour(0, 0, 0);
+  }
+  virtual double scatterPdf(const HitRecord &rec, const Vec3 &wi) const {
+    return 0;
+  }
 };
 
-class Lambertian : public Material {
+class Lambertian final : public Material {
 public:
-  Lambertian(const Colour &albedo) : albedo{albedo} {}
+  Lambertian(const Colour &albedo)
+      : Material(MaterialKind::Lambertian), albedo{albedo} {}
 
   bool scatter(const Ray &rIn, const HitRecord &rec, Colour &attenuation,
                Ray &scattered) const override {
+    RT_STAT(scatters[SCATTER_LAMBERTIAN], 1);
     auto scatterDirection =
         rec.normal + randomUnitVector(); // lambertion reflection
     // if you sample randomly from the unit sphere which lies tagent to the
@@ -41,22 +84,37 @@ public:
     if (scatterDirection.nearZero())
       scatterDirection = rec.normal;
 
-    scattered = Ray(rec.p, scatterDirection);
+    scattered = Ray(rec.p, scatterDirection, rIn.time());
     attenuation = albedo;
     return true;
   }
 
+  Colour surfaceAlbedo() const override { return albedo; }
+
+  bool samplesLights() const override { return true; }
+
+  Colour brdf(const HitRecord &rec, const Vec3 &wi) const override {
+    return dot(rec.normal, wi) > 0 ? albedo / pi : Colour(0, 0, 0);
+  }
+
+  // normal + a random unit vector is cosine distributed
+  double scatterPdf(const HitRecord &rec, const Vec3 &wi) const override {
+    return std::max(double(dot(rec.normal, wi)), 0.0) / pi;
+  }
+
 private:
   Colour albedo;
 };
 
-class Metal : public Material {
+class Metal final : public Material {
 public:
-  Metal(const Colour &albedo, double fuzz)
-      : albedo{albedo}, fuzz{fuzz < 1 ? fuzz : 1} {}
+  Metal(const Colour &albedo, Real fuzz)
+      : Material(MaterialKind::Metal), albedo{albedo},
+        fuzz{fuzz < 1 ? fuzz : 1} {}
 
   bool scatter(const Ray &rIn, const HitRecord &rec, Colour &attenuation,
                Ray &scattered) const override {
+    RT_STAT(scatters[SCATTER_METAL], 1);
 
     Vec3 reflected = reflect(rIn.direction(), rec.normal);
     reflected =
@@ -64,37 +122,44 @@ public:
     // reflected ray has to first be normalized so that it is consistently
     // scaled WRT. fuzz sphere (otherwise fuzz factor is meaningless)
 
-    scattered = Ray(rec.p, reflected);
+    scattered = Ray(rec.p, reflected, rIn.time());
     attenuation = albedo;
     return dot(scattered.direction(), rec.normal) >
            0; // if our fuzzing causes the scatter to be towards the surface, we
               // absorb the ray
   }
 
+  Colour surfaceAlbedo() const override { return albedo; }
+
+  // past a little fuzz the reflection is too blurred to be worth following
+  bool isSpecular() const override { return fuzz < Real(0.25); }
+
 private:
   Colour albedo;
-  double fuzz; // the scaling factor of the fuzz unit sphere radius
+  Real fuzz; // the scaling factor of the fuzz unit sphere radius
 };
 
-class Dielectric : public Material {
+class Dielectric final : public Material {
 public:
-  Dielectric(double refractionIndex) : refractionIndex{refractionIndex} {}
+  Dielectric(Real refractionIndex)
+      : Material(MaterialKind::Dielectric), refractionIndex{refractionIndex} {}
 
   // always refracts
   bool scatter(const Ray &rIn, const HitRecord &rec, Colour &attenuation,
                Ray &scattered) const override {
+    RT_STAT(scatters[SCATTER_DIELECTRIC], 1);
     attenuation = Colour(1.0, 1.0, 1.0);
-    double ri =
+    Real ri =
         rec.frontFace
             ? (1.0 / refractionIndex)
             : refractionIndex; // numerator in refractionIndex ratio needs to be
                                // refractive index of incoming material
 
     Vec3 unitDirection = unitVector(rIn.direction());
-    double cosTheta =
+    Real cosTheta =
         fmin(dot(-unitDirection, rec.normal),
              1.0); // cos(theta) between 2 unit vector are their dot product
-    double sinTheta =
+    Real sinTheta =
         sqrt(1.0 - cosTheta * cosTheta); // follows from pythagorean identity
 
     bool cannotRefract =
@@ -108,17 +173,22 @@ public:
     else
       direction = refract(unitDirection, rec.normal, ri);
 
-    scattered = Ray(rec.p, direction);
+    scattered = Ray(rec.p, direction, rIn.time());
 
     return true;
   }
 
+  // clear glass lets everything through
+  Colour surfaceAlbedo() const override { return Colour(1, 1, 1); }
+
+  bool isSpecular() const override { return true; }
+
 private:
-  double
+  Real
       refractionIndex; // ratio of material's index / index of enclosing media
 
   // reflectance varies with angle
-  static double reflectance(double cosine, double refractionIndex) {
+  static Real reflectance(Real cosine, Real refractionIndex) {
     // use the Schlick Approximation
     auto r0 = (1 - refractionIndex) / (1 + refractionIndex);
     r0 = r0 * r0;
@@ -126,4 +196,117 @@ private:
   }
 };
 
+// a surface that gives off light and reflects none. only its outside
+// glows, so a light sphere seen from within is dark
+class DiffuseLight final : public Material {
+public:
+  DiffuseLight(const Colour &radiance)
+      : Material(MaterialKind::Light), radiance{radiance} {}
+
+  Colour emitted(const HitRecord &rec) const override {
+    return rec.frontFace ? radiance : Colour(0, 0, 0);
+  }
+
+  // lights are too bright to demodulate by; they're left as they are
+  Colour surfaceAlbedo() const override { return Colour(1, 1, 1); }
+
+private:
+  Colour radiance;
+};
+
+// the Material calls the integrators make per bounce, dispatched over the
+// closed set of built-in materials: a switch on the kind, then a call on the
+// final class, which the compiler makes direct and can inline. other
+// materials still go through the vtable, and Devirt = false sends every
+// material there (the dispatch bench compares the two)
+namespace dispatch {
+
+// calls f with mat cast to its own class when it's a built-in one
+template <bool Devirt, typename F>
+inline auto visit(const Material &mat, const F &f) -> decltype(f(mat)) {
+  if (Devirt) {
+    switch (mat.kind) {
+    case MaterialKind::Lambertian:
+      return f(static_cast<const Lambertian &>(mat));
+    case MaterialKind::Metal:
+      return f(static_cast<const Metal &>(mat));
+    case MaterialKind::Dielectric:
+      return f(static_cast<const Dielectric &>(mat));
+    case MaterialKind::Light:
+      return f(static_cast<const DiffuseLight &>(mat));
+    case MaterialKind::Other:
+      break;
+    }
+  }
+  return f(mat);
+}
+
+struct Scatter {
+  const Ray &rIn;
+  const HitRecord &rec;
+  Colour &attenuation;
+  Ray &scattered;
+  template <typename M> bool operator()(const M &m) const {
+    return m.scatter(rIn, rec, attenuation, scattered);
+  }
+};
+
+struct Emitted {
+  const HitRecord &rec;
+  template <typename M> Colour operator()(const M &m) const {
+    return m.emitted(rec);
+  }
+};
+
+struct SamplesLights {
+  template <typename M> bool operator()(const M &m) const {
+    return m.samplesLights();
+  }
+};
+
+struct Brdf {
+  const HitRecord &rec;
+  const Vec3 &wi;
+  template <typename M> Colour operator()(const M &m) const {
+    return m.brdf(rec, wi);
+  }
+};
+
+struct ScatterPdf {
+  const HitRecord &rec;
+  const Vec3 &wi;
+  template <typename M> double operator()(const M &m) const {
+    return m.scatterPdf(rec, wi);
+  }
+};
+
+template <bool Devirt = DEVIRTUALIZE>
+inline bool scatter(const Material &mat, const Ray &rIn, const HitRecord &rec,
+                    Colour &attenuation, Ray &scattered) {
+  return visit<Devirt>(mat, Scatter{rIn, rec, attenuation, scattered});
+}
+
+template <bool Devirt = DEVIRTUALIZE>
+inline Colour emitted(const Material &mat, const HitRecord &rec) {
+  return visit<Devirt>(mat, Emitted{rec});
+}
+
+template <bool Devirt = DEVIRTUALIZE>
+inline bool samplesLights(const Material &mat) {
+  return visit<Devirt>(mat, SamplesLights());
+}
+
+template <bool Devirt = DEVIRTUALIZE>
+inline Colour brdf(const Material &mat, const HitRecord &rec, const Vec3 &wi) {
+  return visit<Devirt>(mat, Brdf{rec, wi});
+}
+
+template <bool Devirt = DEVIRTUALIZE>
+inline double scatterPdf(const Material &mat, const HitRecord &rec,
+                         const Vec3 &wi) {
+  return visit<Devirt>(mat, ScatterPdf{rec, wi});
+}
+
+} // namespace dispatch
+
 #endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef MATERIAL_TABLE_HPP
+#define MATERIAL_TABLE_HPP
+
+#include "rtweekend.hpp"
+
+#include "arena.hpp"
+#include "material.hpp"
+
+#include <utility>
+#include <vector>
+
+// owns every material in a scene. primitives and hit records only hold raw
+// pointers into the table, so it has to outlive any render that uses them
+class MaterialTable {
+public:
+  template <typename T, typename... Args> const T *add(Args &&...args) {
+    T *mat = arena.make<T>(std::forward<Args>(args)...);
+    materials.push_back(mat);
+    return mat;
+  }
+
+  size_t size() const { return materials.size(); }
+
+  // materials are numbered in the order they were added
+  const Material *operator[](size_t id) const { return materials[id]; }
+
+private:
+  Arena arena;
+  std::vector<const Material *> materials;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// number of threads to use when the caller asks for "all of them" (0)
+inline int resolveThreadCount(int requested) {
+  if (requested > 0)
+    return requested;
+  int hw = int(std::thread::hardware_concurrency());
+  return hw > 0 ? hw : 1;
+}
+
+// a deque of task indices owned by one worker. the owner pops from the front,
+// idle workers steal from the back so they take the work the owner would get
+// to last (keeps the owner walking its block in order)
+class WorkQueue {
+public:
+  void push(int task) { tasks.push_back(task); }
+
+  bool pop(int &task) {
+    std::lock_guard<std::mutex> lock(m);
+    if (tasks.empty())
+      return false;
+    task = tasks.front();
+    tasks.pop_front();
+    return true;
+  }
+
+  bool steal(int &task) {
+    std::lock_guard<std::mutex> lock(m);
+    if (tasks.empty())
+      return false;
+    task = tasks.back();
+    tasks.pop_back();
+    return true;
+  }
+
+private:
+  std::mutex m;
+  std::deque<int> tasks;
+};
+
+// runs fn(task, threadIndex) for every task in [0, taskCount) on up to
+// threadCount threads. tasks are dealt out in contiguous blocks and
+// re-balanced by work stealing, so this is meant for coarse tasks (tiles,
+// subtrees), not per-pixel work
+template <typename Fn>
+void parallelFor(int taskCount, int threadCount, const Fn &fn) {
+  threadCount = resolveThreadCount(threadCount);
+  if (threadCount > taskCount)
+    threadCount = taskCount;
+
+  if (threadCount <= 1) {
+    for (int task = 0; task < taskCount; ++task)
+      fn(task, 0);
+    return;
+  }
+
+  std::vector<WorkQueue> queues(threadCount);
+  for (int t = 0; t < threadCount; ++t) {
+    int begin = int((long long)taskCount * t / threadCount);
+    int end = int((long long)taskCount * (t + 1) / threadCount);
+    for (int task = begin; task < end; ++task)
+      queues[t].push(task);
+  }
+
+  auto worker = [&](int self) {
+    int task;
+    while (true) {
+      if (queues[self].pop(task)) {
+        fn(task, self);
+        continue;
+      }
+
+      // own queue is dry, go looking for someone else's work
+      bool stole = false;
+      for (int i = 1; i < threadCount && !stole; ++i)
+        stole = queues[(self + i) % threadCount].steal(task);
+      if (!stole)
+        return; // tasks never get added after start, so everyone is done
+      fn(task, self);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int t = 1; t < threadCount; ++t)
+    threads.emplace_back(worker, t);
+  worker(0);
+  for (auto &thread : threads)
+    thread.join();
+}
+
+#endif
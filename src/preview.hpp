@@ -0,0 +1,346 @@
+#ifndef PREVIEW_HPP
+#define PREVIEW_HPP
+
+#include "rtweekend.hpp"
+
+#include "camera.hpp"
+#include "denoise.hpp"
+#include "image.hpp"
+#include "sceneFile.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Interactive preview: a long-running process that keeps the scene and its
+// BVHs loaded and renders progressively, passSamples samples per pixel a
+// pass, until the camera's SAMPLES_PER_PIXEL. Clients connect to a Unix
+// socket and send commands, one per line; any change to the camera throws
+// the accumulated samples away and starts again from the next pass, so a
+// new view shows up after one low-sample pass instead of a whole render.
+//
+// Commands, each answered with a line "ok ..." or "error <reason>":
+//   camera <setting> <values>  a camera statement as in a text scene file
+//                              ("camera vfov 30", "camera lookfrom 1 2 3")
+//   pass <n>                   samples per pixel per pass (restarts)
+//   watch                      send a frame after every pass from now on
+//   frame                      send the current frame once
+//   save <path>                write the current image in IMAGE_FORMAT
+//   status                     "ok <samples> <target> <width> <height>
+//                              <seconds since the last change>"
+//   quit                       stop the server
+// A frame is a line "frame <samples> <seconds> <bytes>" followed by a binary
+// PPM of that many bytes. A watching client gets frames in between its
+// replies, so it tells the two apart by the first word. Clients never hold
+// up the render: what they haven't read yet waits in a per-client outbox,
+// a watching client that is still behind skips frames until it catches up,
+// and one whose outbox outgrows MAX_OUTBOX is dropped. With
+// Camera::PREVIEW_PATH set every pass is also written there, for viewers
+// that reload a file, and with Camera::DENOISE the frames are denoised
+class PreviewServer {
+public:
+  int passSamples = 1;
+
+  // file is the scene the world was built from; its camera records take the
+  // updates before they're applied to cam
+  PreviewServer(SceneFile &file, const Hittable &world, Camera &cam)
+      : file{file}, world{world}, cam{cam} {}
+
+  ~PreviewServer() {
+    for (const auto &client : clients)
+      ::close(client.fd);
+    if (listenFd >= 0) {
+      ::close(listenFd);
+      ::unlink(socketPath.c_str());
+    }
+  }
+
+  // binds the socket at path, replacing whatever was there. false if it
+  // can't
+  bool listen(const std::string &path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+      std::cerr << "socket path too long: " << path << '\n';
+      return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    ::unlink(path.c_str());
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 ||
+        ::bind(listenFd, reinterpret_cast<sockaddr *>(&address),
+               sizeof(address)) != 0 ||
+        ::listen(listenFd, 8) != 0) {
+      std::cerr << "could not listen on " << path << ": "
+                << std::strerror(errno) << '\n';
+      return false;
+    }
+    socketPath = path;
+    return true;
+  }
+
+  // renders and serves until a client sends quit
+  void run() {
+    restart();
+    while (!quit) {
+      // block only once the image has every sample it's going to get
+      poll(rendering() ? 0 : -1);
+      if (restartPending)
+        restart();
+      if (!quit && rendering())
+        renderPass();
+    }
+  }
+
+private:
+  // the most a client may leave unread before it's dropped: a few frames
+  // at the largest preview sizes
+  static const size_t MAX_OUTBOX = 64 << 20;
+
+  struct Client {
+    int fd;
+    std::string inbox;  // bytes received past the last full line
+    std::string outbox; // bytes the socket hasn't taken yet
+    bool watching = false;
+
+    explicit Client(int fd) : fd{fd} {}
+  };
+
+  SceneFile &file;
+  const Hittable &world;
+  Camera &cam;
+
+  std::string socketPath;
+  int listenFd = -1;
+  std::vector<Client> clients;
+  bool quit = false;
+  bool restartPending = false;
+
+  // the accumulation, as Camera::render keeps it: radiance sums and the
+  // samples each pixel has taken
+  Image sums;
+  std::vector<int> sampleCounts;
+  std::vector<Camera::PixelVariance> variances;
+  int samplesDone = 0;
+  std::chrono::steady_clock::time_point changed;
+
+  bool rendering() const { return samplesDone < cam.SAMPLES_PER_PIXEL; }
+
+  void restart() {
+    restartPending = false;
+    // the sampler stratifies over one pass at a time
+    cam.PASS_SAMPLES = std::max(passSamples, 1);
+    cam.beginRender();
+    sums = Image(cam.IMAGE_WIDTH, cam.imageHeight());
+    sampleCounts.assign(sums.pixels.size(), 0);
+    variances.assign(sums.pixels.size(), Camera::PixelVariance());
+    samplesDone = 0;
+    changed = std::chrono::steady_clock::now();
+  }
+
+  void renderPass() {
+    samplesDone =
+        std::min(samplesDone + cam.PASS_SAMPLES, cam.SAMPLES_PER_PIXEL);
+    cam.renderPass(world, samplesDone, sums, sampleCounts, variances);
+
+    Image image = current();
+    if (!cam.PREVIEW_PATH.empty())
+      writeImage(image, cam.IMAGE_FORMAT, cam.PREVIEW_PATH);
+    std::string frame;
+    for (auto &client : clients) {
+      // a client still reading the last frame gets the next one instead
+      if (!client.watching || !client.outbox.empty())
+        continue;
+      if (frame.empty())
+        frame = encodeFrame(image);
+      send(client, frame);
+    }
+    dropClosed();
+  }
+
+  // the per-pixel averages so far, denoised if the camera asks for it
+  Image current() const {
+    Image image(sums.width, sums.height);
+    for (size_t i = 0; i < image.pixels.size(); ++i)
+      image.pixels[i] = sums.pixels[i] / Real(std::max(sampleCounts[i], 1));
+    if (!cam.DENOISE || samplesDone == 0)
+      return image;
+    ATrousDenoiser denoiser;
+    denoiser.threads = cam.THREADS;
+    return denoiser.denoise(image, cam.features(), sampleCounts);
+  }
+
+  std::string encodeFrame(const Image &image) const {
+    std::ostringstream ppm;
+    PpmBinaryWriter().write(ppm, image);
+    std::string body = ppm.str();
+    char header[96];
+    std::snprintf(header, sizeof(header), "frame %d %.3f %zu\n", samplesDone,
+                  secondsSinceChange(), body.size());
+    return header + body;
+  }
+
+  double secondsSinceChange() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         changed)
+        .count();
+  }
+
+  // waits up to timeout ms (-1 = forever) for connections and commands, and
+  // handles whatever arrived
+  void poll(int timeout) {
+    std::vector<pollfd> fds(1 + clients.size());
+    fds[0] = {listenFd, POLLIN, 0};
+    for (size_t i = 0; i < clients.size(); ++i) {
+      short events = POLLIN;
+      if (!clients[i].outbox.empty())
+        events |= POLLOUT;
+      fds[i + 1] = {clients[i].fd, events, 0};
+    }
+    if (::poll(fds.data(), fds.size(), timeout) <= 0)
+      return;
+
+    for (size_t i = 0; i < clients.size(); ++i) {
+      if (fds[i + 1].revents & POLLOUT)
+        flush(clients[i]);
+      if (fds[i + 1].revents & ~POLLOUT)
+        receive(clients[i]);
+    }
+    if (fds[0].revents & POLLIN) {
+      // non-blocking, so a client that stops reading can't stall a send
+      int fd = ::accept4(listenFd, nullptr, nullptr,
+                         SOCK_CLOEXEC | SOCK_NONBLOCK);
+      if (fd >= 0)
+        clients.emplace_back(fd);
+    }
+    dropClosed();
+  }
+
+  void receive(Client &client) {
+    char buffer[4096];
+    ssize_t n = ::read(client.fd, buffer, sizeof(buffer));
+    if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+      return;
+    if (n <= 0) {
+      close(client);
+      return;
+    }
+    client.inbox.append(buffer, size_t(n));
+    size_t lineEnd;
+    while (client.fd >= 0 &&
+           (lineEnd = client.inbox.find('\n')) != std::string::npos) {
+      std::string line = client.inbox.substr(0, lineEnd);
+      client.inbox.erase(0, lineEnd + 1);
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      if (!line.empty())
+        handle(client, line);
+    }
+  }
+
+  void handle(Client &client, const std::string &line) {
+    std::istringstream words(line);
+    std::string command;
+    words >> command;
+
+    if (command == "camera") {
+      std::string error;
+      if (!file.parseCameraStatement(line, error)) {
+        send(client, "error " + error + '\n');
+        return;
+      }
+      file.applyCamera(cam);
+      restartPending = true;
+    } else if (command == "pass") {
+      int samples = 0;
+      if (!(words >> samples) || samples < 1) {
+        send(client, "error pass needs a sample count of 1 or more\n");
+        return;
+      }
+      passSamples = samples;
+      restartPending = true;
+    } else if (command == "watch") {
+      client.watching = true;
+    } else if (command == "frame") {
+      send(client, "ok\n");
+      send(client, encodeFrame(current()));
+      return;
+    } else if (command == "save") {
+      std::string path;
+      words >> path;
+      if (path.empty() || !writeImage(current(), cam.IMAGE_FORMAT, path)) {
+        send(client, "error could not save '" + path + "'\n");
+        return;
+      }
+    } else if (command == "status") {
+      char status[128];
+      std::snprintf(status, sizeof(status), "ok %d %d %d %d %.3f\n",
+                    samplesDone, cam.SAMPLES_PER_PIXEL, sums.width,
+                    sums.height, secondsSinceChange());
+      send(client, status);
+      return;
+    } else if (command == "quit") {
+      quit = true;
+    } else {
+      send(client, "error unknown command '" + command + "'\n");
+      return;
+    }
+    send(client, "ok\n");
+  }
+
+  // queues data for the client and sends what its socket will take now.
+  // a client that lets too much pile up is dropped
+  void send(Client &client, const std::string &data) {
+    if (client.fd < 0)
+      return;
+    if (client.outbox.size() + data.size() > MAX_OUTBOX) {
+      close(client);
+      return;
+    }
+    client.outbox += data;
+    flush(client);
+  }
+
+  // writes as much of the outbox as the socket takes without blocking
+  void flush(Client &client) {
+    size_t sent = 0;
+    while (client.fd >= 0 && sent < client.outbox.size()) {
+      // MSG_NOSIGNAL: a client that went away is an error here, not SIGPIPE
+      ssize_t n = ::send(client.fd, client.outbox.data() + sent,
+                         client.outbox.size() - sent, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+      if (n <= 0)
+        close(client);
+      else
+        sent += size_t(n);
+    }
+    client.outbox.erase(0, sent);
+  }
+
+  void close(Client &client) {
+    if (client.fd >= 0)
+      ::close(client.fd);
+    client.fd = -1;
+  }
+
+  void dropClosed() {
+    clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                 [](const Client &c) { return c.fd < 0; }),
+                  clients.end());
+  }
+};
+
+#endif
@@ -3,21 +3,27 @@
 
 #include "vec3.hpp"
 
-class Ray {
+template <typename T> class RayT {
 private:
-  Point3 orig;
-  Vec3 dir;
+  Vec3T<T> orig;
+  Vec3T<T> dir;
+  T tm = 0;
 
 public:
-  Ray() {}
+  RayT() {}
 
-  Ray(const Point3 &origin, const Vec3 &direction)
-      : orig{origin}, dir{direction} {}
+  // time is where in the shutter interval the ray was sent, from 0 (open) to
+  // 1 (close). only moving geometry looks at it
+  RayT(const Vec3T<T> &origin, const Vec3T<T> &direction, T time = 0)
+      : orig{origin}, dir{direction}, tm{time} {}
 
-  const Point3 &origin() const { return orig; }
-  const Vec3 &direction() const { return dir; }
+  const Vec3T<T> &origin() const { return orig; }
+  const Vec3T<T> &direction() const { return dir; }
+  T time() const { return tm; }
 
-  Point3 at(double t) const { return orig + t * dir; }
+  Vec3T<T> at(T t) const { return orig + t * dir; }
 };
 
+using Ray = RayT<Real>;
+
 #endif
\ No newline at end of file
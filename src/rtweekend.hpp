@@ -2,10 +2,10 @@
 #define RTWEEKEND_HPP
 
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <limits>
 #include <memory>
-#include <random>
 
 // C++ Std Usings
 
@@ -14,21 +14,89 @@ using std::make_shared;
 using std::shared_ptr;
 using std::sqrt;
 
+// Scalar type of the math core (Vec3, Ray, Interval and everything built on
+// them). configure with -DRT_FLOAT=ON to build in single precision
+
+#ifdef RT_USE_FLOAT
+using Real = float;
+#else
+using Real = double;
+#endif
+
 // Constants
 
-const double infinity = std::numeric_limits<double>::infinity();
-const double pi = 3.1415926535897932385;
+const Real infinity = std::numeric_limits<Real>::infinity();
+const Real pi = Real(3.1415926535897932385);
+
+// whether the hot loops switch on the kind of the built-in materials and
+// primitives and call them directly, rather than through their virtual
+// functions (see dispatch in material.hpp, ScenePrimitive). configure with
+// -DRT_VIRTUAL_DISPATCH=ON to send everything through the vtable instead
+#ifdef RT_VIRTUAL_DISPATCH
+const bool DEVIRTUALIZE = false;
+#else
+const bool DEVIRTUALIZE = true;
+#endif
 
 // Utility Functions
 
 inline double degreesToRadians(double degrees) { return degrees * pi / 180.0; }
 
-inline double randomDouble() {
-  static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-  static std::mt19937 generator;
-  return distribution(generator);
+// splitmix64 finalizer, used to turn (seed, index) pairs into well-spread
+// seeds for independent random streams
+inline unsigned long long mixBits(unsigned long long x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
 }
 
+// PCG32 (O'Neill): 16 bytes of state, a few instructions per number and
+// seeding is just two steps, so it's cheap to restart per pixel sample
+class Pcg32 {
+public:
+  Pcg32() : state{0x853c49e6748fea9bULL}, inc{0xda3e39cb94b95bdbULL} {}
+
+  // sequence picks one of 2^63 independent streams, state the start point
+  void seed(unsigned long long initState, unsigned long long sequence) {
+    state = 0;
+    inc = (sequence << 1) | 1;
+    nextUint();
+    state += initState;
+    nextUint();
+  }
+
+  uint32_t nextUint() {
+    unsigned long long old = state;
+    state = old * 6364136223846793005ULL + inc;
+    uint32_t xorshifted = uint32_t(((old >> 18) ^ old) >> 27);
+    uint32_t rot = uint32_t(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((~rot + 1) & 31));
+  }
+
+  // uniform in [0, 1)
+  double nextDouble() { return nextUint() * (1.0 / 4294967296.0); }
+
+private:
+  unsigned long long state;
+  unsigned long long inc;
+};
+
+// each thread gets its own generator, so render threads never share state.
+// the main thread keeps the default seed, so scenes built in main() come out
+// the same on every run
+inline Pcg32 &randomGenerator() {
+  static thread_local Pcg32 generator;
+  return generator;
+}
+
+// reseed the calling thread's generator for stream `stream` of `seed`
+inline void seedRandom(unsigned long long seed, unsigned long long stream) {
+  randomGenerator().seed(mixBits(seed ^ mixBits(stream)), mixBits(stream));
+}
+
+inline double randomDouble() { return randomGenerator().nextDouble(); }
+
 inline double randomDouble(double min, double max) {
   return (max - min) * randomDouble() + min;
 }
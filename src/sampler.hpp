@@ -0,0 +1,207 @@
+#ifndef SAMPLER_HPP
+#define SAMPLER_HPP
+
+#include "rtweekend.hpp"
+
+#include <cstdint>
+#include <memory>
+
+enum class SamplerType {
+  Independent, // counter-based random numbers, no stratification
+  Halton,      // Halton sequence, rotated per pixel
+  Sobol,       // 2D Sobol points, scrambled and shuffled per pixel
+};
+
+// hands out the sample values for one (pixel, sample) at a time. every value
+// is a pure function of (seed, pixel, sample, dimension), so it doesn't
+// matter which thread or tile renders a pixel, or in which order
+class Sampler {
+public:
+  explicit Sampler(unsigned long long seed) : seed{seed} {}
+  virtual ~Sampler() = default;
+
+  void startPixelSample(uint64_t pixelIndex, uint64_t sampleIndex) {
+    pixel = pixelIndex;
+    sample = sampleIndex;
+    dimension = 0;
+  }
+
+  virtual double get1D() = 0;
+
+  // two correlated dimensions, returned as (u, v, 0)
+  virtual Vec3 get2D() = 0;
+
+protected:
+  unsigned long long seed;
+  uint64_t pixel = 0;
+  uint64_t sample = 0;
+  uint32_t dimension = 0; // next dimension to hand out
+
+  // 64 well-mixed bits keyed by the current pixel, the given dimension and
+  // (optionally) the sample. stands in for a counter-based generator like
+  // Philox: no state, so any value can be computed on its own
+  uint64_t hash(uint64_t dim, uint64_t sampleKey) const {
+    return mixBits(seed ^ mixBits(pixel ^ mixBits(dim ^ mixBits(sampleKey))));
+  }
+
+  static double toUnit(uint32_t bits) { return bits * (1.0 / 4294967296.0); }
+};
+
+class IndependentSampler : public Sampler {
+public:
+  using Sampler::Sampler;
+
+  double get1D() override {
+    return toUnit(uint32_t(hash(dimension++, sample) >> 32));
+  }
+
+  Vec3 get2D() override {
+    uint64_t bits = hash(dimension, sample);
+    dimension += 2;
+    return Vec3(toUnit(uint32_t(bits >> 32)), toUnit(uint32_t(bits)), 0);
+  }
+};
+
+// dimension d uses the radical inverse in the d-th prime base. each pixel gets
+// its own random toroidal shift (Cranley-Patterson rotation) per dimension so
+// neighbouring pixels don't share the exact same pattern
+class HaltonSampler : public Sampler {
+public:
+  using Sampler::Sampler;
+
+  double get1D() override { return next(); }
+
+  Vec3 get2D() override {
+    double u = next();
+    double v = next();
+    return Vec3(u, v, 0);
+  }
+
+private:
+  static const int PRIME_COUNT = 16;
+
+  double next() {
+    uint32_t dim = dimension++;
+    if (dim >= PRIME_COUNT) // ran out of bases, go independent
+      return toUnit(uint32_t(hash(dim, sample) >> 32));
+
+    static const uint32_t primes[PRIME_COUNT] = {
+        2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53};
+    double x = radicalInverse(primes[dim], sample) +
+               toUnit(uint32_t(hash(dim, 0) >> 32));
+    return x < 1 ? x : x - 1;
+  }
+
+  static double radicalInverse(uint32_t base, uint64_t a) {
+    double invBase = 1.0 / base;
+    double invBaseN = 1;
+    uint64_t reversed = 0;
+    while (a) {
+      uint64_t next = a / base;
+      reversed = reversed * base + (a - next * base);
+      invBaseN *= invBase;
+      a = next;
+    }
+    double x = reversed * invBaseN;
+    return x < 1 ? x : std::nextafter(1.0, 0.0);
+  }
+};
+
+// every 2D request is a point of the first two Sobol dimensions, which form a
+// (0,2)-sequence: any power-of-two prefix is perfectly stratified. to keep
+// different 2D requests (pixel position, lens position) from lining up, each
+// one shuffles the sample index and xor-scrambles the digits with its own
+// per-pixel keys; both preserve the stratification
+class SobolSampler : public Sampler {
+public:
+  // the shuffle permutes indices within [0, samplesPerPixel)
+  SobolSampler(unsigned long long seed, uint32_t samplesPerPixel)
+      : Sampler(seed), samplesPerPixel{samplesPerPixel ? samplesPerPixel : 1} {}
+
+  double get1D() override { return get2D().x(); }
+
+  Vec3 get2D() override {
+    uint32_t dim = dimension;
+    dimension += 2;
+
+    uint64_t key = hash(dim, 0);
+    uint32_t index = permutationElement(uint32_t(sample % samplesPerPixel),
+                                        samplesPerPixel, uint32_t(key));
+    // indices past the last full permutation just continue the sequence
+    index += uint32_t(sample - sample % samplesPerPixel);
+
+    uint32_t u = vanDerCorput(index) ^ uint32_t(key >> 32);
+    uint32_t v = sobolSecond(index) ^ uint32_t(mixBits(key) >> 32);
+    return Vec3(toUnit(u), toUnit(v), 0);
+  }
+
+private:
+  uint32_t samplesPerPixel;
+
+  // first Sobol dimension: the bits of i mirrored about the binary point
+  static uint32_t vanDerCorput(uint32_t i) {
+    i = (i << 16) | (i >> 16);
+    i = ((i & 0x00ff00ff) << 8) | ((i & 0xff00ff00) >> 8);
+    i = ((i & 0x0f0f0f0f) << 4) | ((i & 0xf0f0f0f0) >> 4);
+    i = ((i & 0x33333333) << 2) | ((i & 0xcccccccc) >> 2);
+    i = ((i & 0x55555555) << 1) | ((i & 0xaaaaaaaa) >> 1);
+    return i;
+  }
+
+  // second Sobol dimension (direction numbers v_k = v_{k-1} ^ v_{k-1} >> 1)
+  static uint32_t sobolSecond(uint32_t i) {
+    uint32_t result = 0;
+    for (uint32_t v = 1u << 31; i; i >>= 1, v ^= v >> 1)
+      if (i & 1)
+        result ^= v;
+    return result;
+  }
+
+  // Kensler's hashed permutation: element i of a random permutation of
+  // [0, n), without storing the permutation
+  static uint32_t permutationElement(uint32_t i, uint32_t n, uint32_t p) {
+    uint32_t w = n - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do {
+      i ^= p;
+      i *= 0xe170893d;
+      i ^= p >> 16;
+      i ^= (i & w) >> 4;
+      i ^= p >> 8;
+      i *= 0x0929eb3f;
+      i ^= p >> 23;
+      i ^= (i & w) >> 1;
+      i *= 1 | p >> 27;
+      i *= 0x6935fa69;
+      i ^= (i & w) >> 11;
+      i *= 0x74dcb303;
+      i ^= (i & w) >> 2;
+      i *= 0x9e501cc3;
+      i ^= (i & w) >> 2;
+      i *= 0xc860a3df;
+      i &= w;
+      i ^= i >> 5;
+    } while (i >= n);
+    return (i + p) % n;
+  }
+};
+
+inline std::unique_ptr<Sampler>
+makeSampler(SamplerType type, unsigned long long seed,
+            uint32_t samplesPerPixel) {
+  switch (type) {
+  case SamplerType::Halton:
+    return std::unique_ptr<Sampler>(new HaltonSampler(seed));
+  case SamplerType::Sobol:
+    return std::unique_ptr<Sampler>(new SobolSampler(seed, samplesPerPixel));
+  case SamplerType::Independent:
+  default:
+    return std::unique_ptr<Sampler>(new IndependentSampler(seed));
+  }
+}
+
+#endif
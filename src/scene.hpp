@@ -0,0 +1,233 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include "rtweekend.hpp"
+
+#include "hittableList.hpp"
+#include "instance.hpp"
+#include "light.hpp"
+#include "linearBvh.hpp"
+#include "material.hpp"
+#include "materialTable.hpp"
+#include "sceneFile.hpp"
+#include "sphere.hpp"
+#include "sphereSet.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// an entry of a Scene's top-level BVH. the top level only ever holds these
+// three types, so an entry is a pointer tagged with which, and the BVH's
+// calls switch on the tag to call the (final) class directly. without
+// DEVIRTUALIZE they go through the vtable as for any Hittable
+class ScenePrimitive {
+public:
+  enum class Kind : uint8_t { Sphere, SphereSet, InstanceSet };
+
+  ScenePrimitive(const Sphere *s) : kind{Kind::Sphere}, object{s} {}
+  ScenePrimitive(const SphereSet *s) : kind{Kind::SphereSet}, object{s} {}
+  ScenePrimitive(const InstanceSet *s) : kind{Kind::InstanceSet}, object{s} {}
+
+  bool hit(const Ray &r, Interval rayT, HitRecord &rec) const {
+    if (DEVIRTUALIZE) {
+      switch (kind) {
+      case Kind::Sphere:
+        return as<Sphere>().hit(r, rayT, rec);
+      case Kind::SphereSet:
+        return as<SphereSet>().hit(r, rayT, rec);
+      case Kind::InstanceSet:
+        return as<InstanceSet>().hit(r, rayT, rec);
+      }
+    }
+    return object->hit(r, rayT, rec);
+  }
+
+  bool occluded(const Ray &r, Interval rayT) const {
+    if (DEVIRTUALIZE) {
+      switch (kind) {
+      case Kind::Sphere:
+        return as<Sphere>().occluded(r, rayT);
+      case Kind::SphereSet:
+        return as<SphereSet>().occluded(r, rayT);
+      case Kind::InstanceSet:
+        return as<InstanceSet>().occluded(r, rayT);
+      }
+    }
+    return object->occluded(r, rayT);
+  }
+
+  void hitPacket(RayPacket &packet, uint64_t mask) const {
+    if (DEVIRTUALIZE) {
+      switch (kind) {
+      case Kind::Sphere:
+        return as<Sphere>().hitPacket(packet, mask);
+      case Kind::SphereSet:
+        return as<SphereSet>().hitPacket(packet, mask);
+      case Kind::InstanceSet:
+        return as<InstanceSet>().hitPacket(packet, mask);
+      }
+    }
+    object->hitPacket(packet, mask);
+  }
+
+  // only read while building and refitting, so left virtual
+  AABB boundingBox() const { return object->boundingBox(); }
+
+private:
+  Kind kind;
+  const Hittable *object;
+
+  template <typename T> const T &as() const {
+    return static_cast<const T &>(*object);
+  }
+};
+
+// the materials and primitives of a SceneFile, ready to render. spheres go
+// into one SphereSet, except ones far bigger than the typical sphere (a
+// ground sphere, say), which would blow up the bounds of whichever packet
+// they landed in and become standalone Spheres instead. both live in arrays
+// owned by the scene, so building it allocates nothing per object.
+// each instanced object gets a SphereSet of its own, and all the instances
+// go into one InstanceSet over them (a two-level BVH)
+class Scene {
+public:
+  MaterialTable materials;
+  HittableList world; // render this
+  LightList lights;   // the emissive spheres outside objects, for the camera
+
+  Scene() {}
+  Scene(const Scene &) = delete;
+  Scene &operator=(const Scene &) = delete;
+
+  void build(const SceneFile &file) {
+    std::vector<const Material *> mats;
+    mats.reserve(file.materials.size());
+    for (const auto &m : file.materials) {
+      const float *p = m.params;
+      switch (m.kind) {
+      case SceneMaterialKind::Metal:
+        mats.push_back(materials.add<Metal>(Colour(p[0], p[1], p[2]), p[3]));
+        break;
+      case SceneMaterialKind::Dielectric:
+        mats.push_back(materials.add<Dielectric>(p[0]));
+        break;
+      case SceneMaterialKind::Light:
+        mats.push_back(materials.add<DiffuseLight>(Colour(p[0], p[1], p[2])));
+        break;
+      case SceneMaterialKind::Lambertian:
+      default:
+        mats.push_back(materials.add<Lambertian>(Colour(p[0], p[1], p[2])));
+        break;
+      }
+    }
+
+    const SceneSphereRecord *records = file.spheres();
+    size_t count = file.sphereCount();
+    std::vector<bool> inObject(count);
+    for (const auto &o : file.objects) {
+      objects.emplace_back(new SphereSet);
+      for (uint32_t i = o.firstSphere; i < o.firstSphere + o.sphereCount;
+           ++i) {
+        const SceneSphereRecord &s = records[i];
+        objects.back()->add(Point3(s.centre[0], s.centre[1], s.centre[2]),
+                            s.radius, mats[s.material]);
+        inObject[i] = true;
+      }
+      objects.back()->build();
+    }
+
+    float largeRadius = LARGE_SPHERE_FACTOR * medianRadius(records, count);
+    for (size_t i = 0; i < count; ++i) {
+      if (inObject[i])
+        continue;
+      const SceneSphereRecord &s = records[i];
+      Point3 centre(s.centre[0], s.centre[1], s.centre[2]);
+      if (file.materials[s.material].kind == SceneMaterialKind::Light)
+        lights.add(centre, s.radius, mats[s.material]);
+      if (s.radius > largeRadius)
+        largeSpheres.emplace_back(centre, s.radius, mats[s.material]);
+      else
+        spheres.add(centre, s.radius, mats[s.material]);
+    }
+    spheres.build();
+
+    instances.reserve(file.instanceCount());
+    instanceSlots.assign(file.instanceCount(), -1);
+    for (size_t i = 0; i < file.instanceCount(); ++i) {
+      const SceneInstanceRecord &r = file.instances()[i];
+      if (objects[r.object]->size() > 0) {
+        instanceSlots[i] = int(instances.size());
+        instances.add(objects[r.object].get(), SceneFile::transform(r));
+      }
+    }
+    instances.build();
+
+    // every entry is in place before the BVH takes pointers to them
+    topLevel.reserve(largeSpheres.size() + 2);
+    for (const auto &s : largeSpheres)
+      topLevel.emplace_back(&s);
+    if (spheres.size() > 0)
+      topLevel.emplace_back(&spheres);
+    if (instances.size() > 0)
+      topLevel.emplace_back(&instances);
+    std::vector<const ScenePrimitive *> top(topLevel.size());
+    for (size_t i = 0; i < topLevel.size(); ++i)
+      top[i] = &topLevel[i];
+    auto bvh = make_shared<LinearBvhT<ScenePrimitive>>(top);
+    topBvh = bvh.get();
+    world.add(bvh);
+  }
+
+  // moves instance i of the scene file (see InstanceSet::place), for the
+  // next frame of a sequence. call refit() once the frame's moves are done
+  void placeInstance(size_t i, const Affine &open, const Affine &close) {
+    if (instanceSlots[i] >= 0)
+      instances.place(size_t(instanceSlots[i]), open, close);
+  }
+
+  // brings the BVHs up to date after placeInstance() without rebuilding
+  // them, unless refitting has let the instance BVH degrade too far (see
+  // InstanceSet::refit). returns whether it was rebuilt
+  bool refit(bool forceRebuild = false) {
+    bool rebuilt = instances.refit(forceRebuild);
+    if (topBvh)
+      topBvh->refit();
+    return rebuilt;
+  }
+
+  // bytes held by the acceleration structures and primitives (not the
+  // materials or the HittableList)
+  size_t memoryBytes() const {
+    size_t bytes = largeSpheres.capacity() * sizeof(Sphere) +
+                   spheres.memoryBytes() + instances.memoryBytes();
+    for (const auto &o : objects)
+      bytes += sizeof(SphereSet) + o->memoryBytes();
+    return bytes;
+  }
+
+private:
+  // how many times the median radius a sphere has to be to stay out of the
+  // SphereSet
+  static constexpr float LARGE_SPHERE_FACTOR = 8;
+
+  std::vector<Sphere> largeSpheres;
+  SphereSet spheres;
+  std::vector<std::unique_ptr<SphereSet>> objects; // instanced geometry
+  InstanceSet instances;
+  std::vector<int> instanceSlots; // file instance to InstanceSet index, or -1
+  std::vector<ScenePrimitive> topLevel;
+  LinearBvhT<ScenePrimitive> *topBvh = nullptr; // owned by world
+
+  static float medianRadius(const SceneSphereRecord *records, size_t count) {
+    if (count == 0)
+      return 0;
+    std::vector<float> radii(count);
+    for (size_t i = 0; i < count; ++i)
+      radii[i] = records[i].radius;
+    std::nth_element(radii.begin(), radii.begin() + count / 2, radii.end());
+    return radii[count / 2];
+  }
+};
+
+#endif
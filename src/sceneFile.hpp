@@ -0,0 +1,961 @@
+#ifndef SCENE_FILE_HPP
+#define SCENE_FILE_HPP
+
+#include "rtweekend.hpp"
+
+#include "camera.hpp"
+#include "transform.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SCENE_FILE_MMAP
+#endif
+
+// Scene files come in two forms with the same content:
+//
+// text, for writing by hand. one statement per line, '#' starts a comment:
+//   camera width 1200            camera samples 100     camera depth 50
+//   camera aspect 16/9           camera vfov 20         camera seed 0
+//   camera lookfrom 13 2 3       camera lookat 0 0 -1   camera vup 0 1 0
+//   camera defocus 0.6           camera focus 10
+//   material <name> lambertian <r> <g> <b>
+//   material <name> metal <r> <g> <b> <fuzz>
+//   material <name> dielectric <refraction index>
+//   material <name> light <r> <g> <b>   emits radiance r g b (see light.hpp)
+//   sphere <x> <y> <z> <radius> <material name>
+//   object <name>                  spheres up to the matching 'end' make a
+//   end                            reusable object, not rendered on its own
+//   instance <object> <op>...      the object placed by a list of transforms,
+//                                  applied left to right:
+//     translate <x> <y> <z> | scale <s> | scale <x> <y> <z> |
+//     rotate <axis x> <y> <z> <degrees> | matrix <3x4 row-major, 12 numbers>
+// and, for an animated sequence (see animation.hpp):
+//   camera frames 48               camera shutter 0.5
+//   key camera <frame> <lookfrom x y z> <lookat x y z> <vfov>
+//   key instance <frame> <op>...   moves the instance on the line before; ops
+//     are translate <x> <y> <z> | rotate <axis x> <y> <z> <degrees> |
+//     scale <s>. rotate and scale act in object space (about the object's
+//     origin, before the instance transform), translate in world space
+// and for lit scenes, a scale on the sky's radiance (0 for a dark scene):
+//   camera sky 0.1
+//
+// binary, for large generated scenes. the records below written back to back,
+// little-endian: "RTSC" | u32 version (1) | u32 material count | u32 0 |
+// u64 sphere count | SceneCameraRecord | SceneMaterialRecords |
+// SceneSphereRecords | u32 object count | u32 instance count |
+// SceneObjectRecords | SceneInstanceRecords | SceneAnimationRecord |
+// u32 camera key count | u32 motion key count | SceneCameraKeyRecords |
+// SceneMotionKeyRecords | SceneEnvironmentRecord. every section stays
+// 4-byte aligned, so a mapped file is used in place: loading a binary scene
+// doesn't copy the spheres or instances
+
+struct SceneCameraRecord {
+  int32_t imageWidth = 100;
+  int32_t samplesPerPixel = 10;
+  int32_t maxDepth = 10;
+  int32_t seed = 0;
+  double aspectRatio = 1.0;
+  double vfov = 90;
+  double lookfrom[3] = {0, 0, 0};
+  double lookat[3] = {0, 0, -1};
+  double vup[3] = {0, 1, 0};
+  double defocusAngle = 0;
+  double focusDistance = 10;
+};
+
+enum class SceneMaterialKind : uint32_t {
+  Lambertian,
+  Metal,
+  Dielectric,
+  Light
+};
+
+struct SceneMaterialRecord {
+  SceneMaterialKind kind;
+  float params[4]; // albedo rgb and fuzz, the refraction index, or radiance
+};
+
+struct SceneSphereRecord {
+  float centre[3];
+  float radius;
+  uint32_t material; // index into the material records
+};
+
+// a run of sphere records that form one instanced object
+struct SceneObjectRecord {
+  uint32_t firstSphere;
+  uint32_t sphereCount;
+};
+
+struct SceneInstanceRecord {
+  uint32_t object;    // index into the object records
+  float transform[12]; // object to world, 3x4 row-major (see Affine)
+};
+
+// how many frames a sequence has and how long the shutter stays open in each
+struct SceneAnimationRecord {
+  int32_t frames = 1;
+  float shutter = 0; // fraction of a frame, 0 = no motion blur
+};
+
+// where the camera is at one frame. between keys it's interpolated
+struct SceneCameraKeyRecord {
+  float frame;
+  float lookfrom[3];
+  float lookat[3];
+  float vfov;
+};
+
+// how far one instance has moved at one frame: a rotation and scale about
+// the object's origin, and a translation in world space (see animation.hpp)
+struct SceneMotionKeyRecord {
+  uint32_t instance; // index into the instance records
+  float frame;
+  float translate[3];
+  float axis[3];
+  float degrees;
+  float scale;
+};
+
+// what lights the scene besides its emissive spheres
+struct SceneEnvironmentRecord {
+  float skyScale = 1; // times the sky's radiance
+};
+
+static_assert(sizeof(SceneCameraRecord) == 120, "camera record layout");
+static_assert(sizeof(SceneMaterialRecord) == 20, "material record layout");
+static_assert(sizeof(SceneSphereRecord) == 20, "sphere record layout");
+static_assert(sizeof(SceneObjectRecord) == 8, "object record layout");
+static_assert(sizeof(SceneInstanceRecord) == 52, "instance record layout");
+static_assert(sizeof(SceneAnimationRecord) == 8, "animation record layout");
+static_assert(sizeof(SceneCameraKeyRecord) == 32, "camera key record layout");
+static_assert(sizeof(SceneMotionKeyRecord) == 40, "motion key record layout");
+static_assert(sizeof(SceneEnvironmentRecord) == 4, "environment record layout");
+
+// read-only view of a whole file: mapped where the platform allows it, read
+// into memory otherwise
+class MappedFile {
+public:
+  MappedFile() {}
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() { close(); }
+
+  bool open(const std::string &path) {
+    close();
+#ifdef SCENE_FILE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+    void *mapped =
+        mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+      return false;
+    bytes = static_cast<const char *>(mapped);
+    length = size_t(info.st_size);
+    return true;
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+      return false;
+    buffer.assign(std::istreambuf_iterator<char>(file),
+                  std::istreambuf_iterator<char>());
+    bytes = buffer.data();
+    length = buffer.size();
+    return true;
+#endif
+  }
+
+  const char *data() const { return bytes; }
+  size_t size() const { return length; }
+
+private:
+  const char *bytes = nullptr;
+  size_t length = 0;
+#ifndef SCENE_FILE_MMAP
+  std::vector<char> buffer;
+#endif
+
+  void close() {
+#ifdef SCENE_FILE_MMAP
+    if (bytes)
+      munmap(const_cast<char *>(bytes), length);
+#endif
+    bytes = nullptr;
+    length = 0;
+  }
+};
+
+// a scene as plain records, either parsed from text, mapped from a binary
+// file or generated in code
+class SceneFile {
+public:
+  SceneCameraRecord camera;
+  std::vector<SceneMaterialRecord> materials;
+  std::vector<SceneObjectRecord> objects;
+  SceneAnimationRecord animation;
+  std::vector<SceneCameraKeyRecord> cameraKeys; // sorted by frame
+  std::vector<SceneMotionKeyRecord> motionKeys; // by instance, then frame
+  SceneEnvironmentRecord environment;
+
+  SceneFile() {}
+  SceneFile(const SceneFile &) = delete;
+  SceneFile &operator=(const SceneFile &) = delete;
+
+  const SceneSphereRecord *spheres() const {
+    return mappedSpheres ? mappedSpheres : ownedSpheres.data();
+  }
+
+  size_t sphereCount() const {
+    return mappedSpheres ? mappedSphereCount : ownedSpheres.size();
+  }
+
+  const SceneInstanceRecord *instances() const {
+    return mappedInstances ? mappedInstances : ownedInstances.data();
+  }
+
+  size_t instanceCount() const {
+    return mappedInstances ? mappedInstanceCount : ownedInstances.size();
+  }
+
+  // a material identical to one added before gets the earlier one's id, so
+  // scenes that repeat a material (every glass sphere, say) store it once
+  uint32_t addMaterial(SceneMaterialKind kind, float p0, float p1 = 0,
+                       float p2 = 0, float p3 = 0) {
+    SceneMaterialRecord record{kind, {p0, p1, p2, p3}};
+    std::string key(reinterpret_cast<const char *>(&record), sizeof(record));
+    auto found = materialIds.find(key);
+    if (found != materialIds.end())
+      return found->second;
+    materials.push_back(record);
+    uint32_t id = uint32_t(materials.size() - 1);
+    materialIds.emplace(key, id);
+    return id;
+  }
+
+  void addSphere(const Point3 &centre, Real radius, uint32_t material) {
+    ownedSpheres.push_back(SceneSphereRecord{
+        {float(centre.x()), float(centre.y()), float(centre.z())},
+        float(radius),
+        material});
+  }
+
+  // spheres added between beginObject() and endObject() form the object
+  // (numbered in order) instead of being part of the scene directly
+  uint32_t beginObject() {
+    objects.push_back(SceneObjectRecord{uint32_t(sphereCount()), 0});
+    return uint32_t(objects.size() - 1);
+  }
+
+  void endObject() {
+    objects.back().sphereCount =
+        uint32_t(sphereCount()) - objects.back().firstSphere;
+  }
+
+  void addInstance(uint32_t object, const Affine &toWorld) {
+    SceneInstanceRecord record;
+    record.object = object;
+    for (int i = 0; i < 12; ++i)
+      record.transform[i] = float(toWorld.m[i / 4][i % 4]);
+    ownedInstances.push_back(record);
+  }
+
+  // keys go in at their place in the sort order, after any key with the same
+  // frame
+  void addCameraKey(double frame, const Point3 &lookfrom, const Point3 &lookat,
+                    double vfov) {
+    SceneCameraKeyRecord key{
+        float(frame),
+        {float(lookfrom.x()), float(lookfrom.y()), float(lookfrom.z())},
+        {float(lookat.x()), float(lookat.y()), float(lookat.z())},
+        float(vfov)};
+    cameraKeys.insert(std::upper_bound(cameraKeys.begin(), cameraKeys.end(),
+                                       key, cameraKeyBefore),
+                      key);
+  }
+
+  void addMotionKey(uint32_t instance, double frame, const Vec3 &translate,
+                    const Vec3 &axis = Vec3(0, 1, 0), double degrees = 0,
+                    double scale = 1) {
+    SceneMotionKeyRecord key{
+        instance,
+        float(frame),
+        {float(translate.x()), float(translate.y()), float(translate.z())},
+        {float(axis.x()), float(axis.y()), float(axis.z())},
+        float(degrees),
+        float(scale)};
+    motionKeys.insert(std::upper_bound(motionKeys.begin(), motionKeys.end(),
+                                       key, motionKeyBefore),
+                      key);
+  }
+
+  static Affine transform(const SceneInstanceRecord &record) {
+    const float *t = record.transform;
+    return Affine(t[0], t[1], t[2], t[3], t[4], t[5], t[6], t[7], t[8], t[9],
+                  t[10], t[11]);
+  }
+
+  // picks the format from the first bytes of the file. errors go to stderr
+  bool load(const std::string &path) {
+    camera = SceneCameraRecord();
+    materials.clear();
+    materialIds.clear();
+    objects.clear();
+    animation = SceneAnimationRecord();
+    cameraKeys.clear();
+    motionKeys.clear();
+    environment = SceneEnvironmentRecord();
+    ownedSpheres.clear();
+    ownedInstances.clear();
+    mappedSpheres = nullptr;
+    mappedSphereCount = 0;
+    mappedInstances = nullptr;
+    mappedInstanceCount = 0;
+    if (!file.open(path)) {
+      std::cerr << "could not read scene " << path << '\n';
+      return false;
+    }
+    if (file.size() >= 4 && std::memcmp(file.data(), "RTSC", 4) == 0)
+      return loadBinary(path);
+    return loadText(path);
+  }
+
+  bool saveBinary(const std::string &path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+      std::cerr << "could not open " << path << " for writing\n";
+      return false;
+    }
+    uint32_t header[4] = {0, VERSION, uint32_t(materials.size()), 0};
+    std::memcpy(header, "RTSC", 4);
+    uint64_t count = sphereCount();
+    out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char *>(&camera), sizeof(camera));
+    out.write(reinterpret_cast<const char *>(materials.data()),
+              std::streamsize(materials.size() * sizeof(SceneMaterialRecord)));
+    out.write(reinterpret_cast<const char *>(spheres()),
+              std::streamsize(count * sizeof(SceneSphereRecord)));
+    uint32_t counts[2] = {uint32_t(objects.size()), uint32_t(instanceCount())};
+    out.write(reinterpret_cast<const char *>(counts), sizeof(counts));
+    out.write(reinterpret_cast<const char *>(objects.data()),
+              std::streamsize(objects.size() * sizeof(SceneObjectRecord)));
+    out.write(reinterpret_cast<const char *>(instances()),
+              std::streamsize(counts[1] * sizeof(SceneInstanceRecord)));
+    uint32_t keyCounts[2] = {uint32_t(cameraKeys.size()),
+                             uint32_t(motionKeys.size())};
+    out.write(reinterpret_cast<const char *>(&animation), sizeof(animation));
+    out.write(reinterpret_cast<const char *>(keyCounts), sizeof(keyCounts));
+    out.write(reinterpret_cast<const char *>(cameraKeys.data()),
+              std::streamsize(keyCounts[0] * sizeof(SceneCameraKeyRecord)));
+    out.write(reinterpret_cast<const char *>(motionKeys.data()),
+              std::streamsize(keyCounts[1] * sizeof(SceneMotionKeyRecord)));
+    out.write(reinterpret_cast<const char *>(&environment),
+              sizeof(environment));
+    return bool(out);
+  }
+
+  bool saveText(const std::string &path) const {
+    std::ofstream out(path);
+    if (!out) {
+      std::cerr << "could not open " << path << " for writing\n";
+      return false;
+    }
+    char line[512];
+    const SceneCameraRecord &c = camera;
+    out << "camera width " << c.imageWidth << "\ncamera samples "
+        << c.samplesPerPixel << "\ncamera depth " << c.maxDepth
+        << "\ncamera seed " << c.seed << '\n';
+    std::snprintf(line, sizeof(line),
+                  "camera aspect %.17g\ncamera vfov %.17g\n"
+                  "camera lookfrom %.17g %.17g %.17g\n"
+                  "camera lookat %.17g %.17g %.17g\n"
+                  "camera vup %.17g %.17g %.17g\n"
+                  "camera defocus %.17g\ncamera focus %.17g\n",
+                  c.aspectRatio, c.vfov, c.lookfrom[0], c.lookfrom[1],
+                  c.lookfrom[2], c.lookat[0], c.lookat[1], c.lookat[2],
+                  c.vup[0], c.vup[1], c.vup[2], c.defocusAngle,
+                  c.focusDistance);
+    out << line;
+    if (animation.frames != 1)
+      out << "camera frames " << animation.frames << '\n';
+    if (animation.shutter != 0) {
+      std::snprintf(line, sizeof(line), "camera shutter %.9g\n",
+                    animation.shutter);
+      out << line;
+    }
+    if (environment.skyScale != 1) {
+      std::snprintf(line, sizeof(line), "camera sky %.9g\n",
+                    environment.skyScale);
+      out << line;
+    }
+    for (const auto &k : cameraKeys) {
+      std::snprintf(line, sizeof(line),
+                    "key camera %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n",
+                    k.frame, k.lookfrom[0], k.lookfrom[1], k.lookfrom[2],
+                    k.lookat[0], k.lookat[1], k.lookat[2], k.vfov);
+      out << line;
+    }
+
+    // materials are named by their index
+    for (size_t i = 0; i < materials.size(); ++i) {
+      const float *p = materials[i].params;
+      switch (materials[i].kind) {
+      case SceneMaterialKind::Lambertian:
+        std::snprintf(line, sizeof(line),
+                      "material m%zu lambertian %.9g %.9g %.9g\n", i, p[0],
+                      p[1], p[2]);
+        break;
+      case SceneMaterialKind::Metal:
+        std::snprintf(line, sizeof(line),
+                      "material m%zu metal %.9g %.9g %.9g %.9g\n", i, p[0],
+                      p[1], p[2], p[3]);
+        break;
+      case SceneMaterialKind::Dielectric:
+        std::snprintf(line, sizeof(line), "material m%zu dielectric %.9g\n",
+                      i, p[0]);
+        break;
+      case SceneMaterialKind::Light:
+        std::snprintf(line, sizeof(line),
+                      "material m%zu light %.9g %.9g %.9g\n", i, p[0], p[1],
+                      p[2]);
+        break;
+      }
+      out << line;
+    }
+
+    // scene spheres first, then each object's spheres inside its block
+    std::vector<bool> inObject(sphereCount());
+    for (const auto &o : objects)
+      std::fill(inObject.begin() + o.firstSphere,
+                inObject.begin() + o.firstSphere + o.sphereCount, true);
+    std::string buffer;
+    auto appendSphere = [&](size_t i) {
+      const SceneSphereRecord &s = spheres()[i];
+      int len = std::snprintf(line, sizeof(line),
+                              "sphere %.9g %.9g %.9g %.9g m%u\n", s.centre[0],
+                              s.centre[1], s.centre[2], s.radius, s.material);
+      buffer.append(line, size_t(len));
+    };
+    for (size_t i = 0; i < sphereCount(); ++i)
+      if (!inObject[i])
+        appendSphere(i);
+    for (size_t o = 0; o < objects.size(); ++o) {
+      buffer += "object o" + std::to_string(o) + '\n';
+      for (uint32_t i = 0; i < objects[o].sphereCount; ++i)
+        appendSphere(objects[o].firstSphere + i);
+      buffer += "end\n";
+    }
+
+    // each instance's motion keys follow it, as the parser expects
+    size_t key = 0;
+    for (size_t i = 0; i < instanceCount(); ++i) {
+      const SceneInstanceRecord &r = instances()[i];
+      const float *t = r.transform;
+      int len = std::snprintf(
+          line, sizeof(line),
+          "instance o%u matrix %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g "
+          "%.9g %.9g %.9g\n",
+          r.object, t[0], t[1], t[2], t[3], t[4], t[5], t[6], t[7], t[8], t[9],
+          t[10], t[11]);
+      buffer.append(line, size_t(len));
+      for (; key < motionKeys.size() && motionKeys[key].instance == i; ++key) {
+        const SceneMotionKeyRecord &k = motionKeys[key];
+        len = std::snprintf(line, sizeof(line),
+                            "key instance %.9g translate %.9g %.9g %.9g "
+                            "rotate %.9g %.9g %.9g %.9g scale %.9g\n",
+                            k.frame, k.translate[0], k.translate[1],
+                            k.translate[2], k.axis[0], k.axis[1], k.axis[2],
+                            k.degrees, k.scale);
+        buffer.append(line, size_t(len));
+      }
+    }
+    out.write(buffer.data(), std::streamsize(buffer.size()));
+    return bool(out);
+  }
+
+  // parses one camera statement of the text format ("camera vfov 30") into
+  // the camera records, as if it came last in the file. false, with the
+  // reason in error, if it isn't one
+  bool parseCameraStatement(const std::string &statement, std::string &error) {
+    Tokens tokens(statement);
+    if (tokens.word() != "camera" || !parseCamera(tokens) ||
+        !tokens.atEnd()) {
+      error = tokens.error.empty() ? "can't parse '" + statement + "'"
+                                   : tokens.error;
+      return false;
+    }
+    return true;
+  }
+
+  // copies the camera statements onto cam, leaving its other settings alone
+  void applyCamera(Camera &cam) const {
+    cam.IMAGE_WIDTH = camera.imageWidth;
+    cam.SAMPLES_PER_PIXEL = camera.samplesPerPixel;
+    cam.MAX_DEPTH = camera.maxDepth;
+    cam.SEED = (unsigned long long)(camera.seed);
+    cam.ASPECT_RATIO = camera.aspectRatio;
+    cam.VFOV = camera.vfov;
+    cam.lookfrom =
+        Point3(camera.lookfrom[0], camera.lookfrom[1], camera.lookfrom[2]);
+    cam.lookat = Point3(camera.lookat[0], camera.lookat[1], camera.lookat[2]);
+    cam.vup = Vec3(camera.vup[0], camera.vup[1], camera.vup[2]);
+    cam.defocusAngle = camera.defocusAngle;
+    cam.focusDistance = camera.focusDistance;
+    cam.SHUTTER = animation.shutter;
+    cam.SKY_SCALE = environment.skyScale;
+  }
+
+private:
+  static const uint32_t VERSION = 1;
+
+  MappedFile file;
+  const SceneSphereRecord *mappedSpheres = nullptr;
+  size_t mappedSphereCount = 0;
+  std::vector<SceneSphereRecord> ownedSpheres;
+  const SceneInstanceRecord *mappedInstances = nullptr;
+  size_t mappedInstanceCount = 0;
+  std::vector<SceneInstanceRecord> ownedInstances;
+  std::unordered_map<std::string, uint32_t> materialIds; // record bytes to id
+
+  static bool cameraKeyBefore(const SceneCameraKeyRecord &a,
+                              const SceneCameraKeyRecord &b) {
+    return a.frame < b.frame;
+  }
+
+  static bool motionKeyBefore(const SceneMotionKeyRecord &a,
+                              const SceneMotionKeyRecord &b) {
+    return a.instance != b.instance ? a.instance < b.instance
+                                    : a.frame < b.frame;
+  }
+
+  // whether the camera record can be rendered: at least one pixel and one
+  // sample, a positive aspect ratio, and finite numbers throughout
+  bool cameraInRange() const {
+    const double values[] = {camera.aspectRatio, camera.vfov,
+                             camera.lookfrom[0], camera.lookfrom[1],
+                             camera.lookfrom[2], camera.lookat[0],
+                             camera.lookat[1], camera.lookat[2],
+                             camera.vup[0], camera.vup[1], camera.vup[2],
+                             camera.defocusAngle, camera.focusDistance};
+    for (double v : values)
+      if (!std::isfinite(v))
+        return false;
+    return camera.imageWidth >= 1 && camera.samplesPerPixel >= 1 &&
+           camera.aspectRatio > 0;
+  }
+
+  bool loadBinary(const std::string &path) {
+    const char *data = file.data();
+    size_t at = 0;
+    // points records at the next count records of recordSize bytes, false if
+    // the file ends first. the bound is checked before multiplying, so a
+    // corrupt count can't wrap round to a size that fits
+    auto take = [&](uint64_t count, size_t recordSize,
+                    const char *&records) {
+      if (count > (file.size() - at) / recordSize)
+        return false;
+      records = data + at;
+      at += size_t(count) * recordSize;
+      return true;
+    };
+    auto read = [&](void *out, size_t bytes) {
+      const char *from;
+      if (!take(1, bytes, from))
+        return false;
+      std::memcpy(out, from, bytes);
+      return true;
+    };
+
+    uint32_t header[4];
+    uint64_t count;
+    if (!read(header, sizeof(header)) || !read(&count, sizeof(count)))
+      return fail(path, "truncated header");
+    if (header[1] != VERSION)
+      return fail(path, "unsupported version");
+
+    uint32_t counts[2];    // objects, instances
+    uint32_t keyCounts[2]; // camera keys, motion keys
+    const char *materialData, *sphereData, *objectData, *instanceData;
+    const char *cameraKeyData, *motionKeyData;
+    if (!read(&camera, sizeof(camera)) ||
+        !take(header[2], sizeof(SceneMaterialRecord), materialData) ||
+        !take(count, sizeof(SceneSphereRecord), sphereData) ||
+        !read(counts, sizeof(counts)) ||
+        !take(counts[0], sizeof(SceneObjectRecord), objectData) ||
+        !take(counts[1], sizeof(SceneInstanceRecord), instanceData) ||
+        !read(&animation, sizeof(animation)) ||
+        !read(keyCounts, sizeof(keyCounts)) ||
+        !take(keyCounts[0], sizeof(SceneCameraKeyRecord), cameraKeyData) ||
+        !take(keyCounts[1], sizeof(SceneMotionKeyRecord), motionKeyData) ||
+        !read(&environment, sizeof(environment)) || at != file.size())
+      return fail(path, "size doesn't match its header");
+
+    materials.resize(header[2]);
+    std::memcpy(materials.data(), materialData,
+                header[2] * sizeof(SceneMaterialRecord));
+    mappedSpheres = reinterpret_cast<const SceneSphereRecord *>(sphereData);
+    mappedSphereCount = size_t(count);
+    objects.resize(counts[0]);
+    std::memcpy(objects.data(), objectData,
+                counts[0] * sizeof(SceneObjectRecord));
+    mappedInstances =
+        reinterpret_cast<const SceneInstanceRecord *>(instanceData);
+    mappedInstanceCount = counts[1];
+    // the keys are few, so they're copied and sorted rather than trusted
+    cameraKeys.resize(keyCounts[0]);
+    std::memcpy(cameraKeys.data(), cameraKeyData,
+                keyCounts[0] * sizeof(SceneCameraKeyRecord));
+    motionKeys.resize(keyCounts[1]);
+    std::memcpy(motionKeys.data(), motionKeyData,
+                keyCounts[1] * sizeof(SceneMotionKeyRecord));
+    std::stable_sort(cameraKeys.begin(), cameraKeys.end(), cameraKeyBefore);
+    std::stable_sort(motionKeys.begin(), motionKeys.end(), motionKeyBefore);
+
+    if (!cameraInRange())
+      return fail(path, "camera out of range");
+    for (const auto &m : materials)
+      if (m.kind > SceneMaterialKind::Light)
+        return fail(path, "unknown material kind");
+
+    for (size_t i = 0; i < mappedSphereCount; ++i)
+      if (mappedSpheres[i].material >= materials.size())
+        return fail(path, "sphere refers to a missing material");
+    for (const auto &o : objects)
+      if (size_t(o.firstSphere) + o.sphereCount > mappedSphereCount)
+        return fail(path, "object runs past the last sphere");
+    for (size_t i = 0; i < mappedInstanceCount; ++i)
+      if (mappedInstances[i].object >= objects.size() ||
+          transform(mappedInstances[i]).determinant() == 0)
+        return fail(path, "instance of a missing object or singular");
+    for (const auto &k : motionKeys)
+      if (k.instance >= mappedInstanceCount || k.scale == 0 ||
+          (k.axis[0] == 0 && k.axis[1] == 0 && k.axis[2] == 0))
+        return fail(path, "motion key for a missing instance or singular");
+    return true;
+  }
+
+  bool loadText(const std::string &path) {
+    const char *p = file.data();
+    const char *end = p + file.size();
+    std::unordered_map<std::string, uint32_t> materialByName;
+    std::unordered_map<std::string, uint32_t> objectIds;
+    bool inObject = false;
+    int lineNumber = 0;
+
+    while (p < end) {
+      const char *lineEnd =
+          static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+      if (!lineEnd)
+        lineEnd = end;
+      std::string line(p, lineEnd);
+      p = lineEnd + 1;
+      ++lineNumber;
+
+      size_t comment = line.find('#');
+      if (comment != std::string::npos)
+        line.resize(comment);
+      Tokens tokens(line);
+      std::string keyword = tokens.word();
+      if (keyword.empty())
+        continue;
+
+      bool ok;
+      if (keyword == "camera")
+        ok = parseCamera(tokens);
+      else if (keyword == "material")
+        ok = parseMaterial(tokens, materialByName);
+      else if (keyword == "sphere")
+        ok = parseSphere(tokens, materialByName);
+      else if (keyword == "object" && !inObject) {
+        std::string name = tokens.word();
+        ok = !name.empty();
+        objectIds[name] = beginObject();
+        inObject = true;
+      } else if (keyword == "end" && inObject) {
+        endObject();
+        inObject = false;
+        ok = true;
+      } else if (keyword == "instance")
+        ok = parseInstance(tokens, objectIds);
+      else if (keyword == "key")
+        ok = parseKey(tokens);
+      else
+        ok = false;
+
+      if (!ok || !tokens.atEnd())
+        return fail(path + ':' + std::to_string(lineNumber),
+                    tokens.error.empty() ? "can't parse '" + line + "'"
+                                         : tokens.error);
+    }
+    if (inObject)
+      return fail(path, "object without an 'end'");
+    if (!cameraInRange())
+      return fail(path, "camera out of range");
+    return true;
+  }
+
+  // whitespace-separated words and numbers of one line
+  struct Tokens {
+    const char *p;
+    std::string error;
+
+    explicit Tokens(const std::string &line) : p{line.c_str()} {}
+
+    void skipSpace() {
+      while (*p == ' ' || *p == '\t' || *p == '\r')
+        ++p;
+    }
+
+    bool atEnd() {
+      skipSpace();
+      return *p == '\0';
+    }
+
+    std::string word() {
+      skipSpace();
+      const char *start = p;
+      while (*p && *p != ' ' && *p != '\t' && *p != '\r')
+        ++p;
+      return std::string(start, p);
+    }
+
+    // a number, or a fraction like 16/9
+    bool number(double &value) {
+      skipSpace();
+      char *after;
+      value = std::strtod(p, &after);
+      if (after == p)
+        return false;
+      p = after;
+      if (*p == '/') {
+        double denominator = std::strtod(p + 1, &after);
+        if (after == p + 1 || denominator == 0)
+          return false;
+        value /= denominator;
+        p = after;
+      }
+      return true;
+    }
+
+    bool numbers(double *values, int count) {
+      for (int i = 0; i < count; ++i)
+        if (!number(values[i]))
+          return false;
+      return true;
+    }
+  };
+
+  bool parseCamera(Tokens &tokens) {
+    std::string key = tokens.word();
+    double v[3] = {0, 0, 0};
+    bool ok = tokens.numbers(v, key == "lookfrom" || key == "lookat" ||
+                                        key == "vup"
+                                    ? 3
+                                    : 1);
+    if (!ok)
+      return false;
+    // the whole camera is checked once the file is read (cameraInRange),
+    // but the integer settings have to fit before they're converted
+    bool integer = key == "width" || key == "samples" || key == "depth" ||
+                   key == "seed";
+    if (!std::isfinite(v[0]) || !std::isfinite(v[1]) ||
+        !std::isfinite(v[2]) ||
+        (integer && (v[0] < INT32_MIN || v[0] > INT32_MAX))) {
+      tokens.error = "camera " + key + " out of range";
+      return false;
+    }
+
+    if (key == "width")
+      camera.imageWidth = int32_t(v[0]);
+    else if (key == "samples")
+      camera.samplesPerPixel = int32_t(v[0]);
+    else if (key == "depth")
+      camera.maxDepth = int32_t(v[0]);
+    else if (key == "seed")
+      camera.seed = int32_t(v[0]);
+    else if (key == "aspect")
+      camera.aspectRatio = v[0];
+    else if (key == "vfov")
+      camera.vfov = v[0];
+    else if (key == "defocus")
+      camera.defocusAngle = v[0];
+    else if (key == "focus")
+      camera.focusDistance = v[0];
+    else if (key == "lookfrom")
+      std::memcpy(camera.lookfrom, v, sizeof(v));
+    else if (key == "lookat")
+      std::memcpy(camera.lookat, v, sizeof(v));
+    else if (key == "vup")
+      std::memcpy(camera.vup, v, sizeof(v));
+    else if (key == "sky") {
+      if (v[0] < 0) {
+        tokens.error = "camera sky out of range";
+        return false;
+      }
+      environment.skyScale = float(v[0]);
+    } else if (key == "frames" || key == "shutter") {
+      if (key == "frames" ? v[0] < 1 : v[0] < 0 || v[0] > 1) {
+        tokens.error = "camera " + key + " out of range";
+        return false;
+      }
+      if (key == "frames")
+        animation.frames = int32_t(v[0]);
+      else
+        animation.shutter = float(v[0]);
+    } else {
+      tokens.error = "unknown camera setting '" + key + "'";
+      return false;
+    }
+    return true;
+  }
+
+  bool parseMaterial(Tokens &tokens,
+                     std::unordered_map<std::string, uint32_t> &ids) {
+    std::string name = tokens.word();
+    std::string kind = tokens.word();
+    double v[4] = {0, 0, 0, 0};
+    if (name.empty())
+      return false;
+
+    if (kind == "lambertian" && tokens.numbers(v, 3))
+      ids[name] = addMaterial(SceneMaterialKind::Lambertian, float(v[0]),
+                              float(v[1]), float(v[2]));
+    else if (kind == "metal" && tokens.numbers(v, 4))
+      ids[name] = addMaterial(SceneMaterialKind::Metal, float(v[0]),
+                              float(v[1]), float(v[2]), float(v[3]));
+    else if (kind == "dielectric" && tokens.numbers(v, 1))
+      ids[name] = addMaterial(SceneMaterialKind::Dielectric, float(v[0]));
+    else if (kind == "light" && tokens.numbers(v, 3))
+      ids[name] = addMaterial(SceneMaterialKind::Light, float(v[0]),
+                              float(v[1]), float(v[2]));
+    else
+      return false;
+    return true;
+  }
+
+  bool parseSphere(Tokens &tokens,
+                   const std::unordered_map<std::string, uint32_t> &ids) {
+    double v[4];
+    if (!tokens.numbers(v, 4))
+      return false;
+    std::string name = tokens.word();
+    auto it = ids.find(name);
+    if (it == ids.end()) {
+      tokens.error = "unknown material '" + name + "'";
+      return false;
+    }
+    addSphere(Point3(v[0], v[1], v[2]), v[3], it->second);
+    return true;
+  }
+
+  bool parseInstance(Tokens &tokens,
+                     const std::unordered_map<std::string, uint32_t> &ids) {
+    std::string name = tokens.word();
+    auto it = ids.find(name);
+    if (it == ids.end()) {
+      tokens.error = "unknown object '" + name + "'";
+      return false;
+    }
+
+    Affine toWorld;
+    while (!tokens.atEnd()) {
+      std::string op = tokens.word();
+      double v[12];
+      if (op == "translate" && tokens.numbers(v, 3)) {
+        toWorld = Affine::translate(Vec3(v[0], v[1], v[2])) * toWorld;
+      } else if (op == "scale" && tokens.number(v[0])) {
+        // one factor, or one per axis
+        const char *afterOne = tokens.p;
+        if (!tokens.numbers(v + 1, 2)) {
+          tokens.p = afterOne;
+          v[1] = v[2] = v[0];
+        }
+        toWorld = Affine::scale(Vec3(v[0], v[1], v[2])) * toWorld;
+      } else if (op == "rotate" && tokens.numbers(v, 4)) {
+        toWorld = Affine::rotate(Vec3(v[0], v[1], v[2]), v[3]) * toWorld;
+      } else if (op == "matrix" && tokens.numbers(v, 12)) {
+        toWorld = Affine(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8],
+                         v[9], v[10], v[11]) *
+                  toWorld;
+      } else {
+        return false;
+      }
+    }
+    if (toWorld.determinant() == 0) {
+      tokens.error = "singular instance transform";
+      return false;
+    }
+    addInstance(it->second, toWorld);
+    return true;
+  }
+
+  bool parseKey(Tokens &tokens) {
+    std::string kind = tokens.word();
+    double frame;
+    if (!tokens.number(frame))
+      return false;
+
+    if (kind == "camera") {
+      double v[7];
+      if (!tokens.numbers(v, 7))
+        return false;
+      addCameraKey(frame, Point3(v[0], v[1], v[2]), Point3(v[3], v[4], v[5]),
+                   v[6]);
+      return true;
+    }
+    if (kind != "instance")
+      return false;
+    if (instanceCount() == 0) {
+      tokens.error = "instance key before any instance";
+      return false;
+    }
+
+    double translate[3] = {0, 0, 0};
+    double rotate[4] = {0, 1, 0, 0};
+    double scale = 1;
+    while (!tokens.atEnd()) {
+      std::string op = tokens.word();
+      if (!(op == "translate" && tokens.numbers(translate, 3)) &&
+          !(op == "rotate" && tokens.numbers(rotate, 4)) &&
+          !(op == "scale" && tokens.number(scale)))
+        return false;
+    }
+    if (scale == 0 || (rotate[0] == 0 && rotate[1] == 0 && rotate[2] == 0)) {
+      tokens.error = "singular instance key";
+      return false;
+    }
+    addMotionKey(uint32_t(instanceCount() - 1), frame,
+                 Vec3(translate[0], translate[1], translate[2]),
+                 Vec3(rotate[0], rotate[1], rotate[2]), rotate[3], scale);
+    return true;
+  }
+
+  static bool fail(const std::string &where, const std::string &message) {
+    std::cerr << where << ": " << message << '\n';
+    return false;
+  }
+};
+
+#endif
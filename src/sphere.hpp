@@ -4,37 +4,56 @@
 #include "hittable.hpp"
 #include "material.hpp"
 
-class Sphere : public Hittable {
-private:
-  Point3 centre;
-  double radius;
-  shared_ptr<Material> mat;
+// nearest root of |origin + t * direction - centre| = radius inside rayT.
+// written over the scalar type so the same quadratic can be run (and
+// compared) in float and in double whatever Real is
+template <typename T>
+inline bool hitSphere(const Vec3T<T> &centre, T radius, const RayT<T> &r,
+                      const IntervalT<T> &rayT, T &root) {
+  Vec3T<T> oc = centre - r.origin();
+  auto a = r.direction().lengthSquared();
+  auto h = dot(r.direction(), oc);
+  auto c = oc.lengthSquared() - radius * radius;
 
-public:
-  Sphere(const Point3 &centre, double radius, shared_ptr<Material> mat)
-      : centre{centre}, radius{radius}, mat{mat} {}
+  auto discriminant = h * h - a * c;
+  if (discriminant < 0) {
+    return false;
+  }
 
-  bool hit(const Ray &r, Interval rayT, HitRecord &rec) const override {
-    Vec3 oc = centre - r.origin();
-    auto a = r.direction().lengthSquared();
-    auto h = dot(r.direction(), oc);
-    auto c = oc.lengthSquared() - radius * radius;
+  auto sqrtd = sqrt(discriminant);
 
-    auto discriminant = h * h - a * c;
-    if (discriminant < 0) {
+  // find the closest root that is within bounds
+  root = (h - sqrtd) / a;
+  if (!rayT.surrounds(root)) {
+    root = (h + sqrtd) / a;
+    if (!rayT.surrounds(root)) {
       return false;
     }
+  }
+  return true;
+}
 
-    auto sqrtd = sqrt(discriminant);
+class Sphere final : public Hittable {
+private:
+  Point3 centre;
+  Real radius;
+  const Material *mat; // owned by the scene's MaterialTable
+  AABB bbox;
 
-    // find the closest root that is within bounds
-    auto root = (h - sqrtd) / a;
-    if (!rayT.surrounds(root)) {
-      root = (h + sqrtd) / a;
-      if (!rayT.surrounds(root)) {
-        return false;
-      }
-    }
+public:
+  Sphere(const Point3 &centre, Real radius, const Material *mat)
+      : centre{centre}, radius{radius}, mat{mat} {
+    auto rvec = Vec3(radius, radius, radius);
+    bbox = AABB(centre - rvec, centre + rvec);
+  }
+
+  bool hit(const Ray &r, Interval rayT, HitRecord &rec) const override {
+    RT_STAT(hitCalls, 1);
+    RT_STAT(primitiveTests, 1);
+    Real root;
+    if (!hitSphere(centre, radius, r, rayT, root))
+      return false;
+    RT_STAT(primitiveHits, 1);
 
     rec.t = root;
     rec.p = r.at(rec.t);
@@ -43,6 +62,15 @@ public:
     rec.mat = mat;
     return true;
   }
+
+  bool occluded(const Ray &r, Interval rayT) const override {
+    RT_STAT(hitCalls, 1);
+    RT_STAT(primitiveTests, 1);
+    Real root;
+    return hitSphere(centre, radius, r, rayT, root);
+  }
+
+  AABB boundingBox() const override { return bbox; }
 };
 
 #endif
\ No newline at end of file
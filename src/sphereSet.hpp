@@ -0,0 +1,504 @@
+#ifndef SPHERE_SET_HPP
+#define SPHERE_SET_HPP
+
+#include "rtweekend.hpp"
+
+#include "hittable.hpp"
+#include "linearBvh.hpp"
+#include "material.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// the intersection kernel is picked at build time (see RT_SIMD in
+// CMakeLists.txt). RT_SIMD_SCALAR forces the plain loop even when the compiler
+// could emit vector code
+#if !defined(RT_SIMD_SCALAR) && defined(__AVX2__)
+#include <immintrin.h>
+#define SPHERE_SET_AVX2
+#elif !defined(RT_SIMD_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define SPHERE_SET_SSE2
+#endif
+
+inline const char *sphereSetKernelName() {
+#if defined(SPHERE_SET_AVX2)
+  return "avx2";
+#elif defined(SPHERE_SET_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+// lane-wise sphere kernels: for each of the first `width` lanes, the nearest
+// root inside rayT (infinity on a miss). this is the same quadratic as
+// hitSphere, evaluated lane-wise. tHit must be 32-byte aligned; the sphere
+// arrays need not be
+template <typename T>
+inline void sphereLanesScalar(const T *cx, const T *cy, const T *cz,
+                              const T *radiusSquared, int width,
+                              const RayT<T> &r, const IntervalT<T> &rayT,
+                              T *tHit) {
+  const Vec3T<T> &o = r.origin();
+  const Vec3T<T> &d = r.direction();
+  T a = d.lengthSquared();
+
+  for (int i = 0; i < width; ++i) {
+    T ocx = cx[i] - o.x(), ocy = cy[i] - o.y(), ocz = cz[i] - o.z();
+    T h = d.x() * ocx + d.y() * ocy + d.z() * ocz;
+    T c = ocx * ocx + ocy * ocy + ocz * ocz - radiusSquared[i];
+    T disc = h * h - a * c;
+
+    tHit[i] = std::numeric_limits<T>::infinity();
+    if (!(disc >= 0)) // also rejects the NaN padding lanes
+      continue;
+
+    T sqrtd = sqrt(disc);
+    T root = (h - sqrtd) / a;
+    if (!rayT.surrounds(root)) {
+      root = (h + sqrtd) / a;
+      if (!rayT.surrounds(root))
+        continue;
+    }
+    tHit[i] = root;
+  }
+}
+
+inline void sphereLanes(const double *cx, const double *cy, const double *cz,
+                        const double *radiusSquared, int width,
+                        const RayT<double> &r, const IntervalT<double> &rayT,
+                        double *tHit) {
+  // the scalar kernel works these out for itself
+#if defined(SPHERE_SET_AVX2) || defined(SPHERE_SET_SSE2)
+  const Vec3T<double> &o = r.origin();
+  const Vec3T<double> &d = r.direction();
+  double a = d.lengthSquared();
+#endif
+
+#if defined(SPHERE_SET_AVX2)
+  const __m256d ox = _mm256_set1_pd(o.x()), oy = _mm256_set1_pd(o.y()),
+                oz = _mm256_set1_pd(o.z());
+  const __m256d dx = _mm256_set1_pd(d.x()), dy = _mm256_set1_pd(d.y()),
+                dz = _mm256_set1_pd(d.z());
+  const __m256d va = _mm256_set1_pd(a);
+  const __m256d tMin = _mm256_set1_pd(rayT.min);
+  const __m256d tMax = _mm256_set1_pd(rayT.max);
+  const __m256d inf =
+      _mm256_set1_pd(std::numeric_limits<double>::infinity());
+  const __m256d zero = _mm256_setzero_pd();
+
+  for (int i = 0; i < width; i += 4) {
+    __m256d ocx = _mm256_sub_pd(_mm256_loadu_pd(cx + i), ox);
+    __m256d ocy = _mm256_sub_pd(_mm256_loadu_pd(cy + i), oy);
+    __m256d ocz = _mm256_sub_pd(_mm256_loadu_pd(cz + i), oz);
+
+    __m256d h = _mm256_add_pd(
+        _mm256_add_pd(_mm256_mul_pd(dx, ocx), _mm256_mul_pd(dy, ocy)),
+        _mm256_mul_pd(dz, ocz));
+    __m256d c = _mm256_sub_pd(
+        _mm256_add_pd(
+            _mm256_add_pd(_mm256_mul_pd(ocx, ocx), _mm256_mul_pd(ocy, ocy)),
+            _mm256_mul_pd(ocz, ocz)),
+        _mm256_loadu_pd(radiusSquared + i));
+    __m256d disc = _mm256_sub_pd(_mm256_mul_pd(h, h), _mm256_mul_pd(va, c));
+
+    __m256d valid = _mm256_cmp_pd(disc, zero, _CMP_GE_OQ);
+    __m256d sqrtd = _mm256_sqrt_pd(_mm256_max_pd(disc, zero));
+    __m256d t0 = _mm256_div_pd(_mm256_sub_pd(h, sqrtd), va);
+    __m256d t1 = _mm256_div_pd(_mm256_add_pd(h, sqrtd), va);
+
+    __m256d ok0 = _mm256_and_pd(_mm256_cmp_pd(t0, tMin, _CMP_GT_OQ),
+                                _mm256_cmp_pd(t0, tMax, _CMP_LT_OQ));
+    __m256d ok1 = _mm256_and_pd(_mm256_cmp_pd(t1, tMin, _CMP_GT_OQ),
+                                _mm256_cmp_pd(t1, tMax, _CMP_LT_OQ));
+
+    __m256d t = _mm256_blendv_pd(t1, t0, ok0);
+    __m256d ok = _mm256_and_pd(valid, _mm256_or_pd(ok0, ok1));
+    _mm256_store_pd(tHit + i, _mm256_blendv_pd(inf, t, ok));
+  }
+#elif defined(SPHERE_SET_SSE2)
+  const __m128d ox = _mm_set1_pd(o.x()), oy = _mm_set1_pd(o.y()),
+                oz = _mm_set1_pd(o.z());
+  const __m128d dx = _mm_set1_pd(d.x()), dy = _mm_set1_pd(d.y()),
+                dz = _mm_set1_pd(d.z());
+  const __m128d va = _mm_set1_pd(a);
+  const __m128d tMin = _mm_set1_pd(rayT.min);
+  const __m128d tMax = _mm_set1_pd(rayT.max);
+  const __m128d inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+  const __m128d zero = _mm_setzero_pd();
+
+  for (int i = 0; i < width; i += 2) {
+    __m128d ocx = _mm_sub_pd(_mm_loadu_pd(cx + i), ox);
+    __m128d ocy = _mm_sub_pd(_mm_loadu_pd(cy + i), oy);
+    __m128d ocz = _mm_sub_pd(_mm_loadu_pd(cz + i), oz);
+
+    __m128d h = _mm_add_pd(
+        _mm_add_pd(_mm_mul_pd(dx, ocx), _mm_mul_pd(dy, ocy)),
+        _mm_mul_pd(dz, ocz));
+    __m128d c = _mm_sub_pd(
+        _mm_add_pd(_mm_add_pd(_mm_mul_pd(ocx, ocx), _mm_mul_pd(ocy, ocy)),
+                   _mm_mul_pd(ocz, ocz)),
+        _mm_loadu_pd(radiusSquared + i));
+    __m128d disc = _mm_sub_pd(_mm_mul_pd(h, h), _mm_mul_pd(va, c));
+
+    __m128d valid = _mm_cmpge_pd(disc, zero);
+    __m128d sqrtd = _mm_sqrt_pd(_mm_max_pd(disc, zero));
+    __m128d t0 = _mm_div_pd(_mm_sub_pd(h, sqrtd), va);
+    __m128d t1 = _mm_div_pd(_mm_add_pd(h, sqrtd), va);
+
+    __m128d ok0 = _mm_and_pd(_mm_cmpgt_pd(t0, tMin), _mm_cmplt_pd(t0, tMax));
+    __m128d ok1 = _mm_and_pd(_mm_cmpgt_pd(t1, tMin), _mm_cmplt_pd(t1, tMax));
+
+    // SSE2 has no blend, so select with and/andnot/or
+    __m128d t = _mm_or_pd(_mm_and_pd(ok0, t0), _mm_andnot_pd(ok0, t1));
+    __m128d ok = _mm_and_pd(valid, _mm_or_pd(ok0, ok1));
+    _mm_store_pd(tHit + i,
+                 _mm_or_pd(_mm_and_pd(ok, t), _mm_andnot_pd(ok, inf)));
+  }
+#else
+  sphereLanesScalar(cx, cy, cz, radiusSquared, width, r, rayT, tHit);
+#endif
+}
+
+// single precision fits twice the lanes in a register
+inline void sphereLanes(const float *cx, const float *cy, const float *cz,
+                        const float *radiusSquared, int width,
+                        const RayT<float> &r, const IntervalT<float> &rayT,
+                        float *tHit) {
+  // the scalar kernel works these out for itself
+#if defined(SPHERE_SET_AVX2) || defined(SPHERE_SET_SSE2)
+  const Vec3T<float> &o = r.origin();
+  const Vec3T<float> &d = r.direction();
+  float a = d.lengthSquared();
+#endif
+
+#if defined(SPHERE_SET_AVX2)
+  const __m256 ox = _mm256_set1_ps(o.x()), oy = _mm256_set1_ps(o.y()),
+               oz = _mm256_set1_ps(o.z());
+  const __m256 dx = _mm256_set1_ps(d.x()), dy = _mm256_set1_ps(d.y()),
+               dz = _mm256_set1_ps(d.z());
+  const __m256 va = _mm256_set1_ps(a);
+  const __m256 tMin = _mm256_set1_ps(rayT.min);
+  const __m256 tMax = _mm256_set1_ps(rayT.max);
+  const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+  const __m256 zero = _mm256_setzero_ps();
+
+  for (int i = 0; i < width; i += 8) {
+    __m256 ocx = _mm256_sub_ps(_mm256_loadu_ps(cx + i), ox);
+    __m256 ocy = _mm256_sub_ps(_mm256_loadu_ps(cy + i), oy);
+    __m256 ocz = _mm256_sub_ps(_mm256_loadu_ps(cz + i), oz);
+
+    __m256 h = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(dx, ocx), _mm256_mul_ps(dy, ocy)),
+        _mm256_mul_ps(dz, ocz));
+    __m256 c = _mm256_sub_ps(
+        _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)),
+            _mm256_mul_ps(ocz, ocz)),
+        _mm256_loadu_ps(radiusSquared + i));
+    __m256 disc = _mm256_sub_ps(_mm256_mul_ps(h, h), _mm256_mul_ps(va, c));
+
+    __m256 valid = _mm256_cmp_ps(disc, zero, _CMP_GE_OQ);
+    __m256 sqrtd = _mm256_sqrt_ps(_mm256_max_ps(disc, zero));
+    __m256 t0 = _mm256_div_ps(_mm256_sub_ps(h, sqrtd), va);
+    __m256 t1 = _mm256_div_ps(_mm256_add_ps(h, sqrtd), va);
+
+    __m256 ok0 = _mm256_and_ps(_mm256_cmp_ps(t0, tMin, _CMP_GT_OQ),
+                               _mm256_cmp_ps(t0, tMax, _CMP_LT_OQ));
+    __m256 ok1 = _mm256_and_ps(_mm256_cmp_ps(t1, tMin, _CMP_GT_OQ),
+                               _mm256_cmp_ps(t1, tMax, _CMP_LT_OQ));
+
+    __m256 t = _mm256_blendv_ps(t1, t0, ok0);
+    __m256 ok = _mm256_and_ps(valid, _mm256_or_ps(ok0, ok1));
+    _mm256_store_ps(tHit + i, _mm256_blendv_ps(inf, t, ok));
+  }
+#elif defined(SPHERE_SET_SSE2)
+  const __m128 ox = _mm_set1_ps(o.x()), oy = _mm_set1_ps(o.y()),
+               oz = _mm_set1_ps(o.z());
+  const __m128 dx = _mm_set1_ps(d.x()), dy = _mm_set1_ps(d.y()),
+               dz = _mm_set1_ps(d.z());
+  const __m128 va = _mm_set1_ps(a);
+  const __m128 tMin = _mm_set1_ps(rayT.min);
+  const __m128 tMax = _mm_set1_ps(rayT.max);
+  const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+  const __m128 zero = _mm_setzero_ps();
+
+  for (int i = 0; i < width; i += 4) {
+    __m128 ocx = _mm_sub_ps(_mm_loadu_ps(cx + i), ox);
+    __m128 ocy = _mm_sub_ps(_mm_loadu_ps(cy + i), oy);
+    __m128 ocz = _mm_sub_ps(_mm_loadu_ps(cz + i), oz);
+
+    __m128 h = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, ocx), _mm_mul_ps(dy, ocy)),
+                          _mm_mul_ps(dz, ocz));
+    __m128 c = _mm_sub_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)),
+                   _mm_mul_ps(ocz, ocz)),
+        _mm_loadu_ps(radiusSquared + i));
+    __m128 disc = _mm_sub_ps(_mm_mul_ps(h, h), _mm_mul_ps(va, c));
+
+    __m128 valid = _mm_cmpge_ps(disc, zero);
+    __m128 sqrtd = _mm_sqrt_ps(_mm_max_ps(disc, zero));
+    __m128 t0 = _mm_div_ps(_mm_sub_ps(h, sqrtd), va);
+    __m128 t1 = _mm_div_ps(_mm_add_ps(h, sqrtd), va);
+
+    __m128 ok0 = _mm_and_ps(_mm_cmpgt_ps(t0, tMin), _mm_cmplt_ps(t0, tMax));
+    __m128 ok1 = _mm_and_ps(_mm_cmpgt_ps(t1, tMin), _mm_cmplt_ps(t1, tMax));
+
+    __m128 t = _mm_or_ps(_mm_and_ps(ok0, t0), _mm_andnot_ps(ok0, t1));
+    __m128 ok = _mm_and_ps(valid, _mm_or_ps(ok0, ok1));
+    _mm_store_ps(tHit + i,
+                 _mm_or_ps(_mm_and_ps(ok, t), _mm_andnot_ps(ok, inf)));
+  }
+#else
+  sphereLanesScalar(cx, cy, cz, radiusSquared, width, r, rayT, tHit);
+#endif
+}
+
+// up to PACKET_WIDTH spheres in structure-of-arrays form, so one ray can be
+// tested against all of them with a handful of vector instructions. unused
+// lanes hold NaN centres, which fail every (ordered) comparison in the kernel.
+// the packet stores and intersects in T; rays and hits stay in Real
+template <typename T> class SpherePacketT final : public Hittable {
+public:
+  static const int PACKET_WIDTH = 8;
+
+  SpherePacketT() {
+    for (int i = 0; i < PACKET_WIDTH; ++i) {
+      cx[i] = cy[i] = cz[i] = std::numeric_limits<T>::quiet_NaN();
+      radius[i] = radiusSquared[i] = 0;
+      mats[i] = nullptr;
+    }
+  }
+
+  void add(const Point3 &centre, Real r, const Material *m) {
+    cx[count] = T(centre.x());
+    cy[count] = T(centre.y());
+    cz[count] = T(centre.z());
+    radius[count] = T(r);
+    radiusSquared[count] = T(r) * T(r);
+    mats[count] = m;
+    ++count;
+
+    auto rvec = Vec3(r, r, r);
+    bbox = AABB(bbox, AABB(centre - rvec, centre + rvec));
+  }
+
+  int size() const { return count; }
+
+  // sphere i, as add() stored it
+  void sphere(int i, Point3 &centre, Real &r, const Material *&m) const {
+    centre = Point3(cx[i], cy[i], cz[i]);
+    r = radius[i];
+    m = mats[i];
+  }
+
+  bool hit(const Ray &r, Interval rayT, HitRecord &rec) const override {
+    RT_STAT(hitCalls, 1);
+    RT_STAT(primitiveTests, count);
+    alignas(32) T tHit[PACKET_WIDTH];
+    sphereLanes(cx, cy, cz, radiusSquared, PACKET_WIDTH,
+                RayT<T>(Vec3T<T>(r.origin()), Vec3T<T>(r.direction())),
+                IntervalT<T>(T(rayT.min), T(rayT.max)), tHit);
+
+    // closest lane wins, infinity means that lane missed
+    int lane = -1;
+    T closest = std::numeric_limits<T>::infinity();
+    for (int i = 0; i < PACKET_WIDTH; ++i) {
+      if (tHit[i] < closest) {
+        closest = tHit[i];
+        lane = i;
+      }
+    }
+    if (lane < 0)
+      return false;
+    RT_STAT(primitiveHits, 1);
+
+    Point3 centre(cx[lane], cy[lane], cz[lane]);
+    rec.t = closest;
+    rec.p = r.at(rec.t);
+    Vec3 outwardNormal = (rec.p - centre) / Real(radius[lane]);
+    rec.setFaceNormal(r, outwardNormal);
+    rec.mat = mats[lane];
+    return true;
+  }
+
+  bool occluded(const Ray &r, Interval rayT) const override {
+    RT_STAT(hitCalls, 1);
+    RT_STAT(primitiveTests, count);
+    alignas(32) T tHit[PACKET_WIDTH];
+    sphereLanes(cx, cy, cz, radiusSquared, PACKET_WIDTH,
+                RayT<T>(Vec3T<T>(r.origin()), Vec3T<T>(r.direction())),
+                IntervalT<T>(T(rayT.min), T(rayT.max)), tHit);
+    for (int i = 0; i < PACKET_WIDTH; ++i)
+      if (tHit[i] < std::numeric_limits<T>::infinity())
+        return true;
+    return false;
+  }
+
+  AABB boundingBox() const override { return bbox; }
+
+private:
+  // packets come from make_shared, which (before C++17) only promises 16-byte
+  // alignment, so the kernels use unaligned loads
+  T cx[PACKET_WIDTH];
+  T cy[PACKET_WIDTH];
+  T cz[PACKET_WIDTH];
+  T radiusSquared[PACKET_WIDTH];
+  T radius[PACKET_WIDTH];
+  const Material *mats[PACKET_WIDTH];
+  int count = 0;
+  AABB bbox;
+};
+
+using SpherePacket = SpherePacketT<Real>;
+
+// a large collection of spheres stored as SpherePackets. build() groups
+// nearby spheres into packets by recursive median splits, then puts a
+// LinearBvh over the packets, so every BVH leaf ends in a vectorized test.
+// T is the precision the packets are stored and intersected in. with Devirt
+// the BVH knows its leaves are packets and inlines their test into the walk;
+// without, it calls them as any Hittable
+template <typename T, bool Devirt = DEVIRTUALIZE>
+class SphereSetT final : public Hittable {
+public:
+  void add(const Point3 &centre, Real radius, const Material *mat) {
+    pending.push_back(PendingSphere{centre, radius, mat});
+  }
+
+  size_t size() const { return sphereCount + pending.size(); }
+
+  // must be called after the last add(), and before the set is added to a
+  // HittableList or BVH (they read the bounding box when objects are added).
+  // spheres added after a build join the built ones at the next. a big set
+  // is built on threads threads (0 = one per hardware thread), with the
+  // same result as on one
+  void build(int threads = 0) {
+    const size_t width = SpherePacketT<T>::PACKET_WIDTH;
+    if (sphereCount > 0) {
+      std::vector<PendingSphere> all(sphereCount);
+      size_t n = 0;
+      for (const auto &packet : packets)
+        for (int i = 0; i < packet.size(); ++i, ++n)
+          packet.sphere(i, all[n].centre, all[n].radius, all[n].mat);
+      all.insert(all.end(), pending.begin(), pending.end());
+      pending.swap(all);
+    }
+    size_t count = pending.size();
+    threads = count < PARALLEL_BUILD_MIN ? 1 : resolveThreadCount(threads);
+    // every range split is at a multiple of the width, so the packet of the
+    // range starting at sphere i is packets[i / width] whichever order the
+    // ranges are filled in
+    packets.clear();
+    packets.resize((count + width - 1) / width);
+    std::vector<std::pair<size_t, size_t>> tasks;
+    size_t taskSize = threads > 1 ? std::max(count / (8 * size_t(threads)),
+                                             size_t(PARALLEL_BUILD_MIN / 4))
+                                  : count;
+    if (count > 0)
+      buildPackets(0, count, taskSize, &tasks);
+    parallelFor(int(tasks.size()), threads, [&](int t, int) {
+      buildPackets(tasks[t].first, tasks[t].second, count, nullptr);
+    });
+
+    // the packets sit in one array and the BVH points straight into it
+    std::vector<const Leaf *> raw(packets.size());
+    for (size_t i = 0; i < packets.size(); ++i)
+      raw[i] = &packets[i];
+    bvh.reset(new LinearBvhT<Leaf>(raw, 4, threads));
+
+    sphereCount = pending.size();
+    std::vector<PendingSphere>().swap(pending);
+  }
+
+  bool hit(const Ray &r, Interval rayT, HitRecord &rec) const override {
+    return bvh && bvh->hit(r, rayT, rec);
+  }
+
+  bool occluded(const Ray &r, Interval rayT) const override {
+    return bvh && bvh->occluded(r, rayT);
+  }
+
+  void hitPacket(RayPacket &packet, uint64_t mask) const override {
+    if (bvh)
+      bvh->hitPacket(packet, mask);
+  }
+
+  AABB boundingBox() const override {
+    return bvh ? bvh->boundingBox() : AABB();
+  }
+
+  // bytes held by the packets and their BVH once built
+  size_t memoryBytes() const {
+    return packets.capacity() * sizeof(SpherePacketT<T>) +
+           (bvh ? bvh->memoryBytes() : 0);
+  }
+
+  // the BVH over the packets, see LinearBvhT
+  size_t nodeCount() const { return bvh ? bvh->nodeCount() : 0; }
+  double sahCost() const { return bvh ? bvh->sahCost() : 0; }
+
+private:
+  using Leaf =
+      typename std::conditional<Devirt, SpherePacketT<T>, Hittable>::type;
+
+  struct PendingSphere {
+    Point3 centre;
+    Real radius;
+    const Material *mat;
+  };
+
+  std::vector<PendingSphere> pending;
+  size_t sphereCount = 0;
+  // moving the set keeps the packet array (and so the BVH's pointers) in place
+  std::vector<SpherePacketT<T>> packets;
+  std::unique_ptr<LinearBvhT<Leaf>> bvh;
+
+  // below this many spheres build() stays on one thread
+  static constexpr size_t PARALLEL_BUILD_MIN = 1 << 16;
+
+  // groups pending[start, end) into packets. with tasks, ranges of taskSize
+  // or fewer spheres are left there to be grouped later instead
+  void buildPackets(size_t start, size_t end, size_t taskSize,
+                    std::vector<std::pair<size_t, size_t>> *tasks) {
+    if (tasks && end - start <= taskSize) {
+      tasks->push_back(std::make_pair(start, end));
+      return;
+    }
+    if (end - start <= size_t(SpherePacketT<T>::PACKET_WIDTH)) {
+      SpherePacketT<T> &packet =
+          packets[start / SpherePacketT<T>::PACKET_WIDTH];
+      for (size_t i = start; i < end; ++i)
+        packet.add(pending[i].centre, pending[i].radius, pending[i].mat);
+      return;
+    }
+
+    AABB centroidBounds;
+    for (size_t i = start; i < end; ++i)
+      centroidBounds =
+          AABB(centroidBounds, AABB(pending[i].centre, pending[i].centre));
+    int axis = centroidBounds.longestAxis();
+
+    // split on a multiple of the packet width so packets come out full
+    size_t packetsInRange =
+        (end - start + SpherePacketT<T>::PACKET_WIDTH - 1) /
+        SpherePacketT<T>::PACKET_WIDTH;
+    size_t mid = start + (packetsInRange / 2) * SpherePacketT<T>::PACKET_WIDTH;
+
+    std::nth_element(pending.begin() + start, pending.begin() + mid,
+                     pending.begin() + end,
+                     [axis](const PendingSphere &a, const PendingSphere &b) {
+                       return a.centre[axis] < b.centre[axis];
+                     });
+    buildPackets(start, mid, taskSize, tasks);
+    buildPackets(mid, end, taskSize, tasks);
+  }
+};
+
+using SphereSet = SphereSetT<Real>;
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+// ray, intersection and path counts for a render. the counters are only
+// compiled in when RT_STATS is defined (the RT_STATS CMake option, always on
+// for the bench target); otherwise RT_STAT expands to nothing and the hot
+// paths are exactly as before
+#ifdef RT_STATS
+const bool STATS_ENABLED = true;
+#else
+const bool STATS_ENABLED = false;
+#endif
+
+// which material's scatter() ran
+enum ScatterKind {
+  SCATTER_LAMBERTIAN,
+  SCATTER_METAL,
+  SCATTER_DIELECTRIC,
+  SCATTER_KINDS
+};
+
+struct RenderStats {
+  uint64_t primaryRays = 0;    // camera rays
+  uint64_t secondaryRays = 0;  // rays spawned by Material::scatter
+  uint64_t shadowRays = 0;     // occlusion tests towards sampled lights
+  uint64_t hitCalls = 0;       // Hittable::hit calls, at every level
+  uint64_t primitiveTests = 0; // ray-primitive tests (a SIMD packet counts
+                               // each sphere in it)
+  uint64_t primitiveHits = 0;  // primitive hit() calls that found a hit
+  uint64_t nodeVisits = 0;     // BVH nodes whose bounds were tested
+  uint64_t scatters[SCATTER_KINDS] = {}; // scatter() calls by material
+
+  // how each path ended
+  uint64_t escapedPaths = 0;  // missed everything and picked up the sky
+  uint64_t absorbedPaths = 0; // scatter() returned false
+  uint64_t maxDepthPaths = 0; // still bouncing at MAX_DEPTH
+  uint64_t roulettePaths = 0; // ended by Russian roulette
+
+  // filled in by Camera::render whether or not RT_STATS is defined
+  double renderSeconds = 0; // tracing, all tiles
+  double outputSeconds = 0; // encoding and writing the image
+  double denoiseSeconds = 0; // filtering the image (Camera::DENOISE)
+
+  RenderStats &operator+=(const RenderStats &other) {
+    primaryRays += other.primaryRays;
+    secondaryRays += other.secondaryRays;
+    shadowRays += other.shadowRays;
+    hitCalls += other.hitCalls;
+    primitiveTests += other.primitiveTests;
+    primitiveHits += other.primitiveHits;
+    nodeVisits += other.nodeVisits;
+    for (int k = 0; k < SCATTER_KINDS; ++k)
+      scatters[k] += other.scatters[k];
+    escapedPaths += other.escapedPaths;
+    absorbedPaths += other.absorbedPaths;
+    maxDepthPaths += other.maxDepthPaths;
+    roulettePaths += other.roulettePaths;
+    return *this;
+  }
+
+  uint64_t rays() const {
+    return primaryRays + secondaryRays + shadowRays;
+  }
+
+  // intersection work, the measure behind the per-pixel cost map
+  uint64_t work() const { return primitiveTests + nodeVisits; }
+
+  void print(std::ostream &out) const {
+    double perRay = rays() ? 1.0 / double(rays()) : 0.0;
+    double perPath = primaryRays ? 100.0 / double(primaryRays) : 0.0;
+    out << std::fixed << std::setprecision(2);
+    out << "Rays: " << primaryRays << " primary, " << secondaryRays
+        << " secondary, " << shadowRays << " shadow ("
+        << (primaryRays ? double(rays()) / primaryRays : 0) << " per path)\n";
+    out << "Per ray: " << hitCalls * perRay << " hit calls, "
+        << primitiveTests * perRay << " primitive tests ("
+        << primitiveHits * perRay << " hits), " << nodeVisits * perRay
+        << " BVH nodes\n";
+    out << "Scatters: " << scatters[SCATTER_LAMBERTIAN] << " lambertian, "
+        << scatters[SCATTER_METAL] << " metal, "
+        << scatters[SCATTER_DIELECTRIC] << " dielectric\n";
+    out << "Paths: " << escapedPaths * perPath << "% escaped, "
+        << absorbedPaths * perPath << "% absorbed, "
+        << maxDepthPaths * perPath << "% at max depth, "
+        << roulettePaths * perPath << "% by roulette\n";
+    out << std::defaultfloat;
+  }
+};
+
+// counters for the work done on this thread since the last reset. the camera
+// resets them before each tile and adds them to the render's total after it,
+// so no counter is ever shared between threads
+inline RenderStats &threadStats() {
+  static thread_local RenderStats stats;
+  return stats;
+}
+
+#ifdef RT_STATS
+#define RT_STAT(counter, n) (threadStats().counter += uint64_t(n))
+#else
+#define RT_STAT(counter, n) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef TRANSFORM_HPP
+#define TRANSFORM_HPP
+
+#include "rtweekend.hpp"
+
+// affine transform as a 3x4 row-major matrix: a linear part (columns 0-2)
+// followed by a translation (column 3). the implied bottom row is 0 0 0 1
+class Affine {
+public:
+  Real m[3][4];
+
+  Affine() : Affine(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0) {}
+
+  Affine(Real m00, Real m01, Real m02, Real m03, Real m10, Real m11,
+         Real m12, Real m13, Real m20, Real m21, Real m22, Real m23)
+      : m{{m00, m01, m02, m03}, {m10, m11, m12, m13}, {m20, m21, m22, m23}} {
+  }
+
+  static Affine translate(const Vec3 &offset) {
+    return Affine(1, 0, 0, offset.x(), 0, 1, 0, offset.y(), 0, 0, 1,
+                  offset.z());
+  }
+
+  static Affine scale(const Vec3 &s) {
+    return Affine(s.x(), 0, 0, 0, 0, s.y(), 0, 0, 0, 0, s.z(), 0);
+  }
+
+  // right-handed rotation about axis (needn't be unit length)
+  static Affine rotate(const Vec3 &axis, double degrees) {
+    Vec3 a = unitVector(axis);
+    Real c = Real(std::cos(degreesToRadians(degrees)));
+    Real s = Real(std::sin(degreesToRadians(degrees)));
+    Real t = 1 - c;
+    return Affine(t * a.x() * a.x() + c, t * a.x() * a.y() - s * a.z(),
+                  t * a.x() * a.z() + s * a.y(), 0,
+                  t * a.x() * a.y() + s * a.z(), t * a.y() * a.y() + c,
+                  t * a.y() * a.z() - s * a.x(), 0,
+                  t * a.x() * a.z() - s * a.y(),
+                  t * a.y() * a.z() + s * a.x(), t * a.z() * a.z() + c, 0);
+  }
+
+  // entry-wise blend, (1 - t) a + t b. not a rigid motion in general, but
+  // every point it maps lies on the segment between a's and b's images of it
+  static Affine lerp(const Affine &a, const Affine &b, Real t) {
+    Affine r;
+    for (int i = 0; i < 3; ++i)
+      for (int j = 0; j < 4; ++j)
+        r.m[i][j] = a.m[i][j] + t * (b.m[i][j] - a.m[i][j]);
+    return r;
+  }
+
+  bool operator==(const Affine &b) const {
+    for (int i = 0; i < 3; ++i)
+      for (int j = 0; j < 4; ++j)
+        if (m[i][j] != b.m[i][j])
+          return false;
+    return true;
+  }
+
+  // this transform applied after b
+  Affine operator*(const Affine &b) const {
+    Affine r;
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 4; ++j) {
+        r.m[i][j] = m[i][0] * b.m[0][j] + m[i][1] * b.m[1][j] +
+                    m[i][2] * b.m[2][j] + (j == 3 ? m[i][3] : 0);
+      }
+    }
+    return r;
+  }
+
+  Point3 point(const Point3 &p) const {
+    return Point3(m[0][0] * p.x() + m[0][1] * p.y() + m[0][2] * p.z() + m[0][3],
+                  m[1][0] * p.x() + m[1][1] * p.y() + m[1][2] * p.z() + m[1][3],
+                  m[2][0] * p.x() + m[2][1] * p.y() + m[2][2] * p.z() +
+                      m[2][3]);
+  }
+
+  Vec3 vector(const Vec3 &v) const {
+    return Vec3(m[0][0] * v.x() + m[0][1] * v.y() + m[0][2] * v.z(),
+                m[1][0] * v.x() + m[1][1] * v.y() + m[1][2] * v.z(),
+                m[2][0] * v.x() + m[2][1] * v.y() + m[2][2] * v.z());
+  }
+
+  // the transpose of the linear part applied to v. normals go from object to
+  // world space through the transpose of the world-to-object transform
+  Vec3 transposedVector(const Vec3 &v) const {
+    return Vec3(m[0][0] * v.x() + m[1][0] * v.y() + m[2][0] * v.z(),
+                m[0][1] * v.x() + m[1][1] * v.y() + m[2][1] * v.z(),
+                m[0][2] * v.x() + m[1][2] * v.y() + m[2][2] * v.z());
+  }
+
+  Real determinant() const {
+    return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+           m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+           m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+  }
+
+  // the caller makes sure the transform isn't singular (determinant() != 0)
+  Affine inverse() const {
+    Real invDet = 1 / determinant();
+    Affine r;
+    r.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * invDet;
+    r.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * invDet;
+    r.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * invDet;
+    r.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * invDet;
+    r.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * invDet;
+    r.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * invDet;
+    r.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * invDet;
+    r.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * invDet;
+    r.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * invDet;
+    // the translation undoes the original one in the inverted frame
+    for (int i = 0; i < 3; ++i)
+      r.m[i][3] = -(r.m[i][0] * m[0][3] + r.m[i][1] * m[1][3] +
+                    r.m[i][2] * m[2][3]);
+    return r;
+  }
+};
+
+#endif
@@ -3,119 +3,158 @@
 
 #include <ostream>
 
-class Vec3 {
+// RT_VEC3_ALIGN4 pads vectors to four lanes and aligns them, so a Vec3T fills
+// exactly one SSE register (float) or half an AVX register (double) and loads
+// never straddle two. alignment is capped at 16 bytes since containers and
+// make_shared only promise that much before C++17
+#ifdef RT_VEC3_ALIGN4
+#define VEC3_LANES 4
+#define VEC3_ALIGNAS alignas(16)
+#else
+#define VEC3_LANES 3
+#define VEC3_ALIGNAS
+#endif
+
+// 3-component vector over scalar type T. the renderer uses Vec3 (T = Real,
+// see rtweekend.hpp); the other precision is still available for comparisons.
+// arithmetic operators are friends defined in the class, so they aren't
+// templates and a double literal can scale a float vector
+template <typename T> class VEC3_ALIGNAS Vec3T {
 public:
-  double e[3];
+  using Scalar = T;
 
-  Vec3() : e{0, 0, 0} {}
-  Vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+  T e[VEC3_LANES];
 
-  double x() const { return e[0]; }
-  double y() const { return e[1]; }
-  double z() const { return e[2]; }
+  Vec3T() : e{0, 0, 0} {}
+  Vec3T(T e0, T e1, T e2) : e{e0, e1, e2} {}
 
-  Vec3 operator-() const { return Vec3(-e[0], -e[1], -e[2]); }
-  double operator[](int i) const { return e[i]; }
-  double &operator[](int i) { return e[i]; }
+  // conversion between precisions has to be asked for
+  template <typename U>
+  explicit Vec3T(const Vec3T<U> &v) : e{T(v.e[0]), T(v.e[1]), T(v.e[2])} {}
 
-  Vec3 &operator+=(const Vec3 &v) {
+  T x() const { return e[0]; }
+  T y() const { return e[1]; }
+  T z() const { return e[2]; }
+
+  Vec3T operator-() const { return Vec3T(-e[0], -e[1], -e[2]); }
+  T operator[](int i) const { return e[i]; }
+  T &operator[](int i) { return e[i]; }
+
+  Vec3T &operator+=(const Vec3T &v) {
     e[0] += v.e[0];
     e[1] += v.e[1];
     e[2] += v.e[2];
     return *this;
   }
 
-  Vec3 &operator*=(double t) {
+  Vec3T &operator*=(T t) {
     e[0] *= t;
     e[1] *= t;
     e[2] *= t;
     return *this;
   }
 
-  Vec3 &operator/=(double t) { return *this *= 1 / t; }
+  Vec3T &operator/=(T t) { return *this *= 1 / t; }
 
-  double lengthSquared() const {
-    return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
-  }
+  T lengthSquared() const { return e[0] * e[0] + e[1] * e[1] + e[2] * e[2]; }
 
   bool nearZero() const {
     auto s = 1e-8;
     return (fabs(e[0] < s)) && (fabs(e[1] < s)) && (fabs(e[2]) < s);
   }
 
-  double length() const { return sqrt(lengthSquared()); }
+  T length() const { return sqrt(lengthSquared()); }
+
+  static Vec3T random() {
+    return Vec3T(randomDouble(), randomDouble(), randomDouble());
+  }
+
+  static Vec3T random(double min, double max) {
+    return Vec3T(randomDouble(min, max), randomDouble(min, max),
+                 randomDouble(min, max));
+  }
 
-  static Vec3 random() {
-    return Vec3(randomDouble(), randomDouble(), randomDouble());
+  // vector utility functions
+  friend std::ostream &operator<<(std::ostream &out, const Vec3T &v) {
+    return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
   }
 
-  static Vec3 random(double min, double max) {
-    return Vec3(randomDouble(min, max), randomDouble(min, max),
-                randomDouble(min, max));
+  friend Vec3T operator+(const Vec3T &u, const Vec3T &v) {
+    return Vec3T(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
   }
+
+  friend Vec3T operator-(const Vec3T &u, const Vec3T &v) {
+    return Vec3T(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+  }
+
+  friend Vec3T operator*(const Vec3T &u, const Vec3T &v) {
+    return Vec3T(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+  }
+
+  friend Vec3T operator*(T t, const Vec3T &v) {
+    return Vec3T(t * v.e[0], t * v.e[1], t * v.e[2]);
+  }
+
+  friend Vec3T operator*(const Vec3T &v, T t) { return t * v; }
+
+  friend Vec3T operator/(const Vec3T &v, T t) { return (1 / t) * v; }
 };
 
+using Vec3 = Vec3T<Real>;
+
 // probably not the best for type-safety, but we will use it for geometric
 // clarity
 using Point3 = Vec3;
 
-// vector utility functions
-inline std::ostream &operator<<(std::ostream &out, const Vec3 &v) {
-  return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
+template <typename T> inline T dot(const Vec3T<T> &u, const Vec3T<T> &v) {
+  return u.e[0] * v.e[0] + u.e[1] * v.e[1] + u.e[2] * v.e[2];
 }
 
-inline Vec3 operator+(const Vec3 &u, const Vec3 &v) {
-  return Vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+template <typename T>
+inline Vec3T<T> cross(const Vec3T<T> &u, const Vec3T<T> &v) {
+  return Vec3T<T>(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+                  u.e[2] * v.e[0] - u.e[0] * v.e[2],
+                  u.e[0] * v.e[1] - u.e[1] * v.e[0]);
 }
 
-inline Vec3 operator-(const Vec3 &u, const Vec3 &v) {
-  return Vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+template <typename T> inline Vec3T<T> unitVector(const Vec3T<T> &v) {
+  return v / v.length();
 }
 
-inline Vec3 operator*(const Vec3 &u, const Vec3 &v) {
-  return Vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
-}
+// the samplers below map uniform numbers straight onto the target shape
+// instead of rejection sampling, so every call consumes a fixed number of
+// random values (which keeps counter-keyed random streams aligned)
 
-inline Vec3 operator*(double t, const Vec3 &v) {
-  return Vec3(t * v.e[0], t * v.e[1], t * v.e[2]);
+// uniform point in the unit disk from two uniforms in [0, 1)
+inline Vec3 mapToUnitDisk(double u1, double u2) {
+  auto r = sqrt(u1);
+  auto phi = 2 * pi * u2;
+  return Vec3(r * cos(phi), r * sin(phi), 0);
 }
 
-inline Vec3 operator*(const Vec3 &v, double t) { return t * v; }
-
-inline Vec3 operator/(const Vec3 &v, double t) { return (1 / t) * v; }
-
-inline double dot(const Vec3 &u, const Vec3 &v) {
-  return u.e[0] * v.e[0] + u.e[1] * v.e[1] + u.e[2] * v.e[2];
+// uniform direction on the unit sphere from two uniforms in [0, 1)
+inline Vec3 mapToUnitSphere(double u1, double u2) {
+  auto z = 1 - 2 * u1;
+  auto r = sqrt(fmax(0.0, 1 - z * z));
+  auto phi = 2 * pi * u2;
+  return Vec3(r * cos(phi), r * sin(phi), z);
 }
 
-inline Vec3 cross(const Vec3 &u, const Vec3 &v) {
-  return Vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
-              u.e[2] * v.e[0] - u.e[0] * v.e[2],
-              u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+inline Vec3 randomInUnitDisk() {
+  return mapToUnitDisk(randomDouble(), randomDouble());
 }
 
-inline Vec3 unitVector(const Vec3 &v) { return v / v.length(); }
-
-inline Vec3 randomInUnitDisk() {
-  while (true) {
-    auto p = Vec3(randomDouble(-1, 1), randomDouble(-1, 1), 0);
-    if (p.lengthSquared() < 1)
-      return p;
-  }
+// note that any random unit vector is on the unit sphere
+inline Vec3 randomUnitVector() {
+  return mapToUnitSphere(randomDouble(), randomDouble());
 }
 
 inline Vec3 randomInUnitSphere() {
-  while (true) {
-    auto p = Vec3::random(-1, 1); // sample a random point in the unit cube
-    if (p.lengthSquared() <
-        1) // it is IN the unit sphere but NOT necessarily on it
-      return p;
-  }
+  // scale a direction by cbrt(u) so points are uniform in volume, not
+  // bunched up near the centre
+  return std::cbrt(randomDouble()) * randomUnitVector();
 }
 
-// note that any random unit vector is on the unit sphere
-inline Vec3 randomUnitVector() { return unitVector(randomInUnitSphere()); }
-
 inline Vec3 randomOnHemisphere(const Vec3 &normal) {
   Vec3 onUnitSphere = randomUnitVector();
   if (dot(onUnitSphere, normal) > 0) {
@@ -125,20 +164,23 @@ inline Vec3 randomOnHemisphere(const Vec3 &normal) {
   }
 }
 
-inline Vec3 reflect(const Vec3 &v, const Vec3 &n) {
+template <typename T>
+inline Vec3T<T> reflect(const Vec3T<T> &v, const Vec3T<T> &n) {
   // note, v+2b is the reflected ray, where b is -proj_n(v)
   // b = -proj_n(v) = [dot(v,n)/dot(n,n)]n, and n is a unit vector
   return v - 2 * dot(v, n) * n;
 }
 
-inline Vec3 refract(const Vec3 &uv, const Vec3 &n, double etaiOverEtat) {
+template <typename T>
+inline Vec3T<T> refract(const Vec3T<T> &uv, const Vec3T<T> &n,
+                        typename Vec3T<T>::Scalar etaiOverEtat) {
   auto cosTheta = fmin(
       dot(-uv, n), 1.0); // derived from the fact that uv, n are unit
                          // vectors and dot(a,b)=|a||b|cos(theta), i.e |a||b|=1
-  Vec3 rOutPerp =
+  Vec3T<T> rOutPerp =
       etaiOverEtat *
       (uv + cosTheta * n); // etai is incoming eta (index of refraction)
-  Vec3 rOutParallel = -sqrt(fabs(1.0 - rOutPerp.lengthSquared())) * n;
+  Vec3T<T> rOutParallel = -sqrt(fabs(1.0 - rOutPerp.lengthSquared())) * n;
   // R_perp = etai/etat (R+cos(theta)N)
   // R_para = -sqrt(1-|R_perp|^2)N
   // the above come from Snell's law